@@ -0,0 +1,224 @@
+/*
+ * bench_decoder.cpp
+ *
+ *      Author: maheriya
+ * Description: Tensor decoder benchmark on synthetic outputs of about 25k anchors per frame:
+ *              YOLOv5 at 640x640 (25200 rows x 85, rows and channels first), SSD (25000 priors,
+ *              21 classes) and [N, 6]. Each is compared with a straightforward per-element
+ *              decode (activate every value, then test), as a scripting layer would do it.
+ *              Usage: bench-decoder [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "tensor_decoder.hpp"
+
+using namespace std;
+
+#define INPUT_SIZE 640
+#define CLASSES    80
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+static float sigmoid(float x) { return 1.0f / (1.0f + expf(-x)); }
+
+// Reference: every value activated, then thresholded (rows first YOLOv5)
+static size_t naiveYolo(const float* t, int rows, const vector<YoloLevel>& levels, float thr,
+                        const vector<string>& labels, vector<Detection>& out) {
+    int width = 5 + CLASSES;
+    vector<float> act(width);
+    int r = 0;
+    for (size_t l = 0; l < levels.size(); l++) {
+        int g = INPUT_SIZE / levels[l].stride;
+        for (size_t a = 0; a < levels[l].anchors.size(); a++) {
+            for (int gy = 0; gy < g; gy++) {
+                for (int gx = 0; gx < g; gx++, r++) {
+                    const float* p = t + (size_t)r * width;
+                    for (int k = 0; k < width; k++)
+                        act[k] = sigmoid(p[k]);
+                    int cls = 0;
+                    for (int k = 1; k < CLASSES; k++)
+                        if (act[5 + k] > act[5 + cls])
+                            cls = k;
+                    float score = act[4] * act[5 + cls];
+                    if (score < thr)
+                        continue;
+                    float s = (float)levels[l].stride;
+                    float cx = (2.0f * act[0] - 0.5f + gx) * s, cy = (2.0f * act[1] - 0.5f + gy) * s;
+                    float w = 4.0f * act[2] * act[2] * levels[l].anchors[a].x;
+                    float h = 4.0f * act[3] * act[3] * levels[l].anchors[a].y;
+                    Detection d = Detection();
+                    d.xmin = (cx - w / 2) / INPUT_SIZE; d.ymin = (cy - h / 2) / INPUT_SIZE;
+                    d.xmax = (cx + w / 2) / INPUT_SIZE; d.ymax = (cy + h / 2) / INPUT_SIZE;
+                    d.score = score;
+                    d.classId = cls;
+                    d.label = labels[cls];
+                    out.push_back(d);
+                }
+            }
+        }
+    }
+    (void)rows;
+    return out.size();
+}
+
+// Reference SSD: full softmax for every prior
+static size_t naiveSSD(const float* loc, const float* conf, const float* priors, int count, int classes,
+                       float thr, vector<Detection>& out) {
+    vector<float> e(classes);
+    for (int p = 0; p < count; p++) {
+        const float* c = conf + (size_t)p * classes;
+        float top = *max_element(c, c + classes), sum = 0.0f;
+        for (int k = 0; k < classes; k++)
+            sum += (e[k] = expf(c[k] - top));
+        int cls = 1;
+        for (int k = 2; k < classes; k++)
+            if (e[k] > e[cls])
+                cls = k;
+        float score = e[cls] / sum;
+        if (score < thr)
+            continue;
+        const float* l = loc + (size_t)p * 4;
+        const float* pr = priors + (size_t)p * 4;
+        float cx = pr[0] + l[0] * 0.1f * pr[2], cy = pr[1] + l[1] * 0.1f * pr[3];
+        float w = pr[2] * expf(l[2] * 0.2f), h = pr[3] * expf(l[3] * 0.2f);
+        Detection d = Detection();
+        d.xmin = cx - w / 2; d.ymin = cy - h / 2; d.xmax = cx + w / 2; d.ymax = cy + h / 2;
+        d.score = score;
+        d.classId = cls;
+        out.push_back(d);
+    }
+    return out.size();
+}
+
+template <typename F>
+static double bestOf(int frames, F f) {
+    double best = 1e9;
+    for (int i = 0; i < frames; i++) {
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        f();
+        best = min(best, msSince(t));
+    }
+    return best;
+}
+
+static void report(const char* name, double ms, size_t n, double refMs, size_t refN) {
+    printf("%-22s %7.3f ms, %5zu detections | per element: %8.3f ms, %5zu detections (%.1fx)%s\n",
+           name, ms, n, refMs, refN, refMs / ms, (n == refN) ? "" : " MISMATCH");
+}
+
+int main(int argc, char** argv) {
+    int frames = (argc > 1) ? atoi(argv[1]) : 20;
+    const float thr = 0.25f;
+    mt19937 rng(11);
+    normal_distribution<float> coord(0.0f, 1.0f), obj(-7.0f, 2.5f), cls(-6.0f, 2.0f);
+
+    vector<string> labels;
+    for (int c = 0; c < CLASSES; c++) {
+        char name[32];
+        sprintf(name, "object %d", c);
+        labels.push_back(name);
+    }
+
+    // YOLOv5s at 640: strides 8, 16, 32 with three anchors each = 25200 rows
+    const float anchors[3][6] = { { 10, 13, 16, 30, 33, 23 }, { 30, 61, 62, 45, 59, 119 },
+                                  { 116, 90, 156, 198, 373, 326 } };
+    const int strides[3] = { 8, 16, 32 };
+    vector<YoloLevel> levels(3);
+    for (int l = 0; l < 3; l++) {
+        levels[l].stride = strides[l];
+        for (int a = 0; a < 3; a++)
+            levels[l].anchors.push_back(glm::vec2(anchors[l][2 * a], anchors[l][2 * a + 1]));
+    }
+    TensorDecoder yolo;
+    yolo.setInputSize(INPUT_SIZE, INPUT_SIZE);
+    yolo.setScoreThreshold(thr);
+    yolo.setLabels(labels);
+    yolo.setYolo(levels, CLASSES);
+    int rows = yolo.anchors(), width = 5 + CLASSES;
+    vector<float> tensor((size_t)rows * width);
+    for (int r = 0; r < rows; r++) {
+        float* p = &tensor[(size_t)r * width];
+        for (int k = 0; k < 4; k++) p[k] = coord(rng);
+        p[4] = obj(rng);
+        for (int k = 0; k < CLASSES; k++) p[5 + k] = cls(rng);
+        p[5 + (r % CLASSES)] += 6.0f; // one likely class
+    }
+    printf("%d frames, threshold %.2f\n", frames, thr);
+
+    vector<Detection> dets, ref;
+    double ms = bestOf(frames, [&]() { dets.clear(); yolo.decode(&tensor[0], dets); });
+    double refMs = bestOf(frames, [&]() { ref.clear(); naiveYolo(&tensor[0], rows, levels, thr, labels, ref); });
+    char name[64];
+    sprintf(name, "YOLO %dx%d", rows, width);
+    report(name, ms, dets.size(), refMs, ref.size());
+
+    // Same tensor, channels first
+    vector<float> transposed(tensor.size());
+    for (int r = 0; r < rows; r++)
+        for (int k = 0; k < width; k++)
+            transposed[(size_t)k * rows + r] = tensor[(size_t)r * width + k];
+    TensorDecoder yoloT;
+    yoloT.setInputSize(INPUT_SIZE, INPUT_SIZE);
+    yoloT.setScoreThreshold(thr);
+    yoloT.setLabels(labels);
+    yoloT.setYolo(levels, CLASSES, true, YOLO_SIGMOID_WH, true);
+    vector<Detection> detsT;
+    ms = bestOf(frames, [&]() { detsT.clear(); yoloT.decode(&transposed[0], detsT); });
+    sprintf(name, "YOLO %dx%d", width, rows);
+    report(name, ms, detsT.size(), refMs, ref.size());
+
+    // SSD: 25000 priors, 21 classes (background first), softmax
+    const int priors = 25000, ssdClasses = 21;
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    vector<float> prior(priors * 4), loc(priors * 4), conf((size_t)priors * ssdClasses);
+    for (int p = 0; p < priors; p++) {
+        prior[4 * p] = unit(rng); prior[4 * p + 1] = unit(rng);
+        prior[4 * p + 2] = 0.05f + 0.3f * unit(rng); prior[4 * p + 3] = 0.05f + 0.3f * unit(rng);
+        for (int k = 0; k < 4; k++) loc[4 * p + k] = coord(rng);
+        float* c = &conf[(size_t)p * ssdClasses];
+        for (int k = 0; k < ssdClasses; k++) c[k] = cls(rng);
+        c[0] += 9.0f; // background usually wins
+    }
+    TensorDecoder ssd;
+    ssd.setScoreThreshold(thr);
+    ssd.setSSD(&prior[0], priors, ssdClasses);
+    ms = bestOf(frames, [&]() { dets.clear(); ssd.decode(&loc[0], &conf[0], dets); });
+    refMs = bestOf(frames, [&]() { ref.clear(); naiveSSD(&loc[0], &conf[0], &prior[0], priors, ssdClasses, thr, ref); });
+    sprintf(name, "SSD %dx%d", priors, ssdClasses);
+    report(name, ms, dets.size(), refMs, ref.size());
+
+    // [N, 6]
+    const int boxes = 25000;
+    vector<float> decoded(boxes * 6);
+    for (int b = 0; b < boxes; b++) {
+        float* p = &decoded[b * 6];
+        p[0] = unit(rng) * 600; p[1] = unit(rng) * 600; p[2] = p[0] + 40; p[3] = p[1] + 40;
+        p[4] = unit(rng) * unit(rng); p[5] = (float)(b % CLASSES);
+    }
+    TensorDecoder flat;
+    flat.setInputSize(INPUT_SIZE, INPUT_SIZE);
+    flat.setScoreThreshold(thr);
+    flat.setLabels(labels);
+    flat.setBoxes(false);
+    ms = bestOf(frames, [&]() { dets.clear(); flat.decode(&decoded[0], dets, boxes); });
+    printf("%-22s %7.3f ms, %5zu detections\n", "[N, 6] 25000", ms, dets.size());
+
+    // Bulk activations
+    vector<float> x(1 << 20), y(x.size());
+    for (size_t i = 0; i < x.size(); i++) x[i] = coord(rng) * 10.0f;
+    double maxErr = 0.0;
+    expArray(&x[0], &y[0], x.size());
+    for (size_t i = 0; i < x.size(); i++)
+        maxErr = max(maxErr, fabs((double)y[i] / exp((double)x[i]) - 1.0));
+    ms = bestOf(frames, [&]() { expArray(&x[0], &y[0], x.size()); });
+    refMs = bestOf(frames, [&]() { for (size_t i = 0; i < x.size(); i++) y[i] = expf(x[i]); });
+    printf("expArray 1M            %7.3f ms (expf loop %.3f ms), max relative error %.2g\n", ms, refMs, maxErr);
+    return 0;
+}
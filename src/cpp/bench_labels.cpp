@@ -0,0 +1,85 @@
+/*
+ * bench_labels.cpp
+ *
+ *      Author: maheriya
+ * Description: Label placement benchmark: growing numbers of tracked boxes in a 1080p window,
+ *              placed once from scratch and then again on the next (slightly moved) frame
+ *              Usage: bench-labels [max labels]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "label_placer.hpp"
+
+using namespace std;
+
+#define BENCH_RUNS 10
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+// Boxes of 20..120 pixels with labels of 5..16 characters (about 7 x 18 pixels each)
+static void makeLabels(int count, vector<LabelRequest>& labels) {
+    mt19937 rng(5);
+    uniform_real_distribution<float> x(0.0f, BENCH_WIDTH - 20.0f), y(0.0f, BENCH_HEIGHT - 20.0f);
+    uniform_real_distribution<float> size(20.0f, 120.0f), unit(0.0f, 1.0f);
+    uniform_int_distribution<int> chars(5, 16);
+    labels.resize(count);
+    for (int i = 0; i < count; i++) {
+        LabelRequest& l = labels[i];
+        l.boxMin = glm::vec2(x(rng), y(rng));
+        l.boxMax = l.boxMin + glm::vec2(size(rng), size(rng));
+        l.size = glm::vec2(7.0f * chars(rng), 18.0f);
+        l.score = unit(rng);
+        l.track = i + 1;
+    }
+}
+
+static void moveLabels(vector<LabelRequest>& labels) {
+    mt19937 rng(7);
+    uniform_real_distribution<float> step(-2.0f, 2.0f);
+    for (size_t i = 0; i < labels.size(); i++) {
+        glm::vec2 d(step(rng), step(rng));
+        labels[i].boxMin += d;
+        labels[i].boxMax += d;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxCount = (argc > 1) ? atoi(argv[1]) : 8000;
+    printf("Labels in a %dx%d window (best of %d)\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_RUNS);
+    for (int count = 250; count <= maxCount; count *= 2) {
+        vector<LabelRequest> labels, moved;
+        vector<LabelPlacement> out;
+        makeLabels(count, labels);
+        moved = labels;
+        moveLabels(moved);
+
+        LabelPlacer placer;
+        placer.setViewport(BENCH_WIDTH, BENCH_HEIGHT);
+        double first = 1e9, next = 1e9;
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            placer.reset();
+            chrono::steady_clock::time_point t = chrono::steady_clock::now();
+            placer.place(labels, out);
+            first = min(first, msSince(t));
+        }
+        LabelStats s = placer.stats();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            chrono::steady_clock::time_point t = chrono::steady_clock::now();
+            placer.place((r & 1) ? labels : moved, out);
+            next = min(next, msSince(t));
+        }
+        const LabelStats& sn = placer.stats();
+        printf("%6d labels: %7.3f ms (%.2f us/label), placed %zu, hidden %zu, %.1f tests/label, grid %dx%d; "
+               "next frame %7.3f ms, %zu kept their anchor\n", count, first, 1e3 * first / count, s.placed,
+               s.hidden, (double)s.tests / count, s.gridWidth, s.gridHeight, next, sn.kept);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * bench_nms.cpp
+ *
+ *      Author: maheriya
+ * Description: NMS benchmark: synthetic detector output (clusters of overlapping candidates per
+ *              object, plus clutter), suppressed by NMS and by cv::dnn::NMSBoxes
+ *              Usage: bench-nms [boxes] [classes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include "nms.hpp"
+
+using namespace std;
+
+#define BENCH_RUNS 10
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+// About 12 candidates per object, jittered around it, and 10% low-score clutter
+static void makeCandidates(int count, int classes, vector<Detection>& dets) {
+    mt19937 rng(3);
+    uniform_real_distribution<float> pos(0.0f, 0.95f), size(0.01f, 0.06f), unit(0.0f, 1.0f);
+    normal_distribution<float> jitter(0.0f, 0.15f);
+    dets.clear();
+    while ((int)dets.size() < count) {
+        Detection obj = Detection();
+        obj.xmin = pos(rng); obj.ymin = pos(rng);
+        float w = size(rng), h = size(rng);
+        obj.classId = (int)(unit(rng) * classes) % classes;
+        int cands = 8 + (int)(unit(rng) * 8);
+        for (int c = 0; c < cands && (int)dets.size() < count; c++) {
+            Detection d = obj;
+            d.xmin = obj.xmin + jitter(rng) * w;
+            d.ymin = obj.ymin + jitter(rng) * h;
+            d.xmax = d.xmin + w * (1.0f + jitter(rng) * 0.5f);
+            d.ymax = d.ymin + h * (1.0f + jitter(rng) * 0.5f);
+            d.score = 0.3f + 0.7f * unit(rng);
+            if (unit(rng) < 0.1f) { // clutter
+                d.xmin = pos(rng); d.ymin = pos(rng);
+                d.xmax = d.xmin + size(rng); d.ymax = d.ymin + size(rng);
+                d.score = 0.3f * unit(rng);
+                d.classId = (int)(unit(rng) * classes) % classes;
+            }
+            dets.push_back(d);
+        }
+    }
+}
+
+static double runNMS(NMS& nms, const vector<Detection>& input, size_t* kept) {
+    double best = 1e9;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        vector<Detection> dets = input;
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        *kept = nms.run(dets);
+        best = min(best, msSince(t));
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : 20000;
+    int classes = (argc > 2) ? atoi(argv[2]) : 80;
+    const float iouThr = 0.5f, scoreThr = 0.05f;
+#if defined(__AVX__)
+    const char* isa = "AVX";
+#elif defined(__SSE2__)
+    const char* isa = "SSE2";
+#else
+    const char* isa = "scalar";
+#endif
+
+    vector<Detection> input;
+    makeCandidates(count, classes, input);
+    printf("%d candidates, %d classes, IoU %.2f, score >= %.2f, IoU kernels: %s (best of %d)\n",
+           count, classes, iouThr, scoreThr, isa, BENCH_RUNS);
+
+    NMS nms;
+    nms.setIoUThreshold(iouThr);
+    nms.setScoreThreshold(scoreThr);
+    const char* names[] = { "hard, per class", "hard, agnostic", "soft linear, per class", "soft gaussian, per class" };
+    const int methods[] = { NMS_HARD, NMS_HARD, NMS_SOFT_LINEAR, NMS_SOFT_GAUSSIAN };
+    const bool agnostic[] = { false, true, false, false };
+    size_t keptAgnostic = 0, keptPerClass = 0;
+    for (int m = 0; m < 4; m++) {
+        nms.setMethod(methods[m]);
+        nms.setClassAgnostic(agnostic[m]);
+        size_t kept;
+        double ms = runNMS(nms, input, &kept);
+        const NMSStats& s = nms.stats();
+        printf("NMS %-26s %7.3f ms (sort %.3f, bin %.3f, suppress %.3f): kept %zu, %llu IoU tests, "
+               "grid %dx%d, %zu large\n", names[m], ms, s.sortMs, s.binMs, s.suppressMs, kept,
+               (unsigned long long)s.iouTests, s.gridWidth, s.gridHeight, s.largeBoxes);
+        if (m == 0)
+            keptPerClass = kept;
+        if (m == 1)
+            keptAgnostic = kept;
+    }
+
+    // OpenCV: class-agnostic (and per class, where NMSBoxesBatched exists)
+    vector<cv::Rect2d> rects;
+    vector<float> scores;
+    vector<int> classIds;
+    for (size_t i = 0; i < input.size(); i++) {
+        const Detection& d = input[i];
+        rects.push_back(cv::Rect2d(d.xmin, d.ymin, d.xmax - d.xmin, d.ymax - d.ymin));
+        scores.push_back(d.score);
+        classIds.push_back(d.classId);
+    }
+    vector<int> indices;
+    double best = 1e9;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        cv::dnn::NMSBoxes(rects, scores, scoreThr, iouThr, indices);
+        best = min(best, msSince(t));
+    }
+    printf("cv::dnn::NMSBoxes, agnostic      %7.3f ms: kept %zu%s\n", best, indices.size(),
+           indices.size() == keptAgnostic ? "" : " (differs)");
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+    best = 1e9;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        cv::dnn::NMSBoxesBatched(rects, scores, classIds, scoreThr, iouThr, indices);
+        best = min(best, msSince(t));
+    }
+    printf("cv::dnn::NMSBoxesBatched, per class %5.3f ms: kept %zu%s\n", best, indices.size(),
+           indices.size() == keptPerClass ? "" : " (differs)");
+#else
+    (void)keptPerClass;
+#endif
+    return 0;
+}
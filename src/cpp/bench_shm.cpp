@@ -0,0 +1,306 @@
+/*
+ * bench_shm.cpp
+ *
+ *      Author: maheriya
+ * Description: Frame ingest from another process: a forked producer hands 1080p BGR frames with
+ *              detections to this process through a shared memory ring, and through a pipe (the
+ *              serialized path) for comparison. The consumer copies every frame once, as the GL
+ *              upload would, and checks that what it got is the frame announced.
+ *              With -p, runs as a standalone producer of moving boxes for gl-render --shm NAME.
+ *              Usage: bench-shm [frames]
+ *                     bench-shm -p NAME [fps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "shm_ring.hpp"
+
+using namespace std;
+
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+#define BENCH_SLOTS  4
+#define BENCH_RING   "/glrender-bench-shm"
+
+static double nowMs(void) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Frame i: every byte is i & 0xff; i % 20 + 1 boxes, the first one tracked as i
+static void makeDetections(uint64_t i, vector<Detection>& dets) {
+    dets.resize(i % 20 + 1);
+    for (size_t k = 0; k < dets.size(); k++) {
+        Detection& d = dets[k];
+        d = Detection();
+        d.xmin = 0.04f * k;
+        d.ymin = 0.1f;
+        d.xmax = d.xmin + 0.03f;
+        d.ymax = 0.2f;
+        d.color = glm::vec3(1.0f, 0.5f, 0.0f);
+        d.label = "person";
+        d.score = 0.9f;
+        d.track = (k == 0) ? (int)i : (int)k;
+    }
+}
+
+static bool checkFrame(uint64_t i, const uint8_t* pixels, size_t bytes, const vector<Detection>& dets) {
+    uint8_t v = (uint8_t)i;
+    return pixels[0] == v && pixels[bytes / 2] == v && pixels[bytes - 1] == v && dets.size() == i % 20 + 1 &&
+           dets[0].track == (int)i && dets[0].label == "person";
+}
+
+struct PipeFrame {
+    uint64_t frameId;
+    double   sentMs;
+    uint32_t count;
+};
+
+struct Result {
+    uint64_t frames;
+    uint64_t corrupt;
+    double   ms;
+    double   latencyMs; // mean, publish to consumer copy done
+};
+
+// Producer: 'frames' frames as fast as the pipe takes them (each a header, the boxes and the pixels)
+static void pipeProducer(int fd, uint64_t frames) {
+    size_t bytes = (size_t)BENCH_WIDTH * BENCH_HEIGHT * 3;
+    vector<uint8_t> pixels(bytes);
+    vector<Detection> dets;
+    vector<ShmBox> boxes;
+    for (uint64_t i = 0; i < frames; i++) {
+        memset(&pixels[0], (int)(i & 0xff), bytes); // "render"
+        makeDetections(i, dets);
+        boxes.assign(dets.size(), ShmBox());
+        for (size_t k = 0; k < dets.size(); k++) {
+            boxes[k].track = dets[k].track;
+            strncpy(boxes[k].label, dets[k].label.c_str(), SHM_LABEL_CHARS - 1);
+        }
+        PipeFrame h = { i, nowMs(), (uint32_t)boxes.size() };
+        if (write(fd, &h, sizeof(h)) != sizeof(h) ||
+            write(fd, &boxes[0], boxes.size() * sizeof(ShmBox)) != (ssize_t)(boxes.size() * sizeof(ShmBox)))
+            break;
+        for (size_t off = 0; off < bytes; ) {
+            ssize_t n = write(fd, &pixels[off], bytes - off);
+            if (n <= 0)
+                return;
+            off += n;
+        }
+    }
+}
+
+static bool readAll(int fd, void* dst, size_t bytes) {
+    for (size_t off = 0; off < bytes; ) {
+        ssize_t n = read(fd, (uint8_t*)dst + off, bytes - off);
+        if (n <= 0)
+            return false;
+        off += n;
+    }
+    return true;
+}
+
+static Result pipeConsumer(int fd) {
+    size_t bytes = (size_t)BENCH_WIDTH * BENCH_HEIGHT * 3;
+    vector<uint8_t> received(bytes), uploaded(bytes);
+    vector<ShmBox> boxes;
+    vector<Detection> dets;
+    Result r = Result();
+    double t0 = nowMs();
+    PipeFrame h;
+    while (readAll(fd, &h, sizeof(h))) {
+        boxes.resize(h.count);
+        if (!readAll(fd, &boxes[0], h.count * sizeof(ShmBox)) || !readAll(fd, &received[0], bytes))
+            break;
+        dets.resize(h.count);
+        for (size_t k = 0; k < dets.size(); k++) {
+            dets[k].track = boxes[k].track;
+            dets[k].label = boxes[k].label;
+        }
+        memcpy(&uploaded[0], &received[0], bytes); // the GL upload
+        r.latencyMs += nowMs() - h.sentMs;
+        if (!checkFrame(h.frameId, &uploaded[0], bytes, dets))
+            r.corrupt++;
+        r.frames++;
+    }
+    r.ms = nowMs() - t0;
+    r.latencyMs /= max(r.frames, (uint64_t)1);
+    return r;
+}
+
+// Producer: renders straight into the ring's slots, 'intervalMs' apart (0: flat out). A byte on
+// 'ready' tells the consumer the ring is there.
+static void shmProducer(int ready, uint64_t frames, double intervalMs) {
+    ShmRingWriter ring;
+    char ok = ring.create(BENCH_RING, BENCH_SLOTS, BENCH_WIDTH, BENCH_HEIGHT);
+    if (write(ready, &ok, 1) != 1 || !ok)
+        return;
+    vector<Detection> dets;
+    double next = nowMs();
+    for (uint64_t i = 0; i < frames; i++) {
+        size_t step;
+        uint8_t* pixels = ring.beginFrame(SHM_FORMAT_BGR, BENCH_WIDTH, BENCH_HEIGHT, &step);
+        memset(pixels, (int)(i & 0xff), step * BENCH_HEIGHT);
+        makeDetections(i, dets);
+        ring.endFrame(i, nowMs(), dets);
+        if (intervalMs > 0.0) {
+            next += intervalMs;
+            double wait = next - nowMs();
+            if (wait > 0.0)
+                usleep((useconds_t)(wait * 1000.0));
+        }
+    }
+    usleep(100000); // let the consumer see the last frame before the ring is closed
+}
+
+static Result shmConsumer(int ready, uint64_t frames, ShmStats* stats) {
+    ShmRingReader ring;
+    Result r = Result();
+    char ok = 0;
+    if (read(ready, &ok, 1) != 1 || !ok || !ring.open(BENCH_RING))
+        return r;
+    size_t bytes = (size_t)BENCH_WIDTH * BENCH_HEIGHT * 3;
+    vector<uint8_t> uploaded(bytes);
+    ShmFrame f;
+    double t0 = nowMs();
+    for (;;) {
+        // Read before acquire(): once everything is published, this acquire() sees the last frame
+        bool done = ring.published() >= frames;
+        if (!ring.acquire(f)) {
+            if (done)
+                break;
+            usleep(100);
+            continue;
+        }
+        memcpy(&uploaded[0], f.data, bytes); // the GL upload, straight from the shared pages
+        double copied = nowMs();
+        if (ring.release(f)) {
+            r.latencyMs += copied - f.timestamp;
+            if (!checkFrame(f.frameId, &uploaded[0], bytes, f.dets))
+                r.corrupt++;
+            r.frames++;
+        }
+    }
+    r.ms = nowMs() - t0;
+    r.latencyMs /= max(r.frames, (uint64_t)1);
+    *stats = ring.stats();
+    return r;
+}
+
+static void report(const char* what, uint64_t frames, const Result& r) {
+    double mb = (double)BENCH_WIDTH * BENCH_HEIGHT * 3 * r.frames / 1e6;
+    printf("%-24s %6" PRIu64 " of %" PRIu64 " frames in %7.1f ms: %6.1f frames/s, %6.0f MB/s, latency %.2f ms, "
+           "%" PRIu64 " corrupt\n", what, r.frames, frames, r.ms, 1e3 * r.frames / r.ms, 1e3 * mb / r.ms,
+           r.latencyMs, r.corrupt);
+}
+
+static volatile sig_atomic_t sStop = 0;
+
+static void onSignal(int) {
+    sStop = 1;
+}
+
+// Standalone producer: a moving gradient with three boxes circling, and their detections
+static int produce(const char* name, double fps) {
+    const int width = 1280, height = 720;
+    ShmRingWriter ring;
+    if (!ring.create(name, BENCH_SLOTS, width, height))
+        return 1;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("Producing %.0f frames/s to %s (Ctrl-C to stop)\n", fps, name);
+    vector<Detection> dets(3);
+    double start = nowMs(), next = start;
+    for (uint64_t i = 0; !sStop; i++) {
+        double t = (nowMs() - start) / 1e3;
+        size_t step;
+        uint8_t* pixels = ring.beginFrame(SHM_FORMAT_BGR, width, height, &step);
+        cv::Mat frame(height, width, CV_8UC3, pixels, step); // drawn in place
+        for (int y = 0; y < height; y++) {
+            uint8_t* row = frame.ptr(y);
+            for (int x = 0; x < width; x++) {
+                row[3 * x] = (uint8_t)(x / 5 + i);
+                row[3 * x + 1] = (uint8_t)(y / 3);
+                row[3 * x + 2] = 64;
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            Detection& d = dets[k];
+            float cx = 0.5f + 0.3f * (float)cos(t * (0.6 + 0.2 * k) + k * 2.1);
+            float cy = 0.5f + 0.25f * (float)sin(t * (0.5 + 0.15 * k) + k * 2.1);
+            d = Detection();
+            d.xmin = cx - 0.07f;
+            d.ymin = cy - 0.1f;
+            d.xmax = cx + 0.07f;
+            d.ymax = cy + 0.1f;
+            d.color = glm::vec3(k == 0, k == 1, k == 2);
+            d.label = (k == 1) ? "car" : "person";
+            d.score = 0.6f + 0.1f * k;
+            d.track = k + 1;
+            d.classId = (k == 1);
+            cv::circle(frame, cv::Point((int)(cx * width), (int)(cy * height)), 30, cv::Scalar(255, 255, 255), -1);
+        }
+        ring.endFrame(i, t, dets);
+        next += 1e3 / fps;
+        double wait = next - nowMs();
+        if (wait > 0.0)
+            usleep((useconds_t)(wait * 1000.0));
+    }
+    printf("Published %" PRIu64 " frames\n", ring.published());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && strcmp(argv[1], "-p") == 0)
+        return produce(argv[2], (argc > 3) ? atof(argv[3]) : 30.0);
+    uint64_t frames = (argc > 1) ? strtoull(argv[1], NULL, 10) : 600;
+    printf("%dx%d BGR frames from a second process (%.1f MB each)\n", BENCH_WIDTH, BENCH_HEIGHT,
+           BENCH_WIDTH * BENCH_HEIGHT * 3 / 1e6);
+
+    int fds[2];
+    if (pipe(fds) != 0)
+        return 1;
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        pipeProducer(fds[1], frames);
+        close(fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+    Result pr = pipeConsumer(fds[0]);
+    close(fds[0]);
+    waitpid(child, NULL, 0);
+    report("pipe (serialized)", frames, pr);
+
+    // Paced like a camera, then flat out (the producer laps the consumer: frames are skipped)
+    const double intervals[] = { 1e3 / 60.0, 0.0 };
+    for (double interval: intervals) {
+        if (pipe(fds) != 0)
+            return 1;
+        child = fork();
+        if (child == 0) {
+            close(fds[0]);
+            shmProducer(fds[1], frames, interval);
+            _exit(0);
+        }
+        close(fds[1]);
+        ShmStats s = ShmStats();
+        Result sr = shmConsumer(fds[0], frames, &s);
+        close(fds[0]);
+        waitpid(child, NULL, 0);
+        char what[64];
+        snprintf(what, sizeof(what), "shared memory, %s", (interval > 0.0) ? "60 fps" : "flat out");
+        report(what, frames, sr);
+        printf("%24s skipped %" PRIu64 ", stale slots %" PRIu64 ", overruns %" PRIu64 ", idle polls %" PRIu64 "\n",
+               "", s.skipped, s.stale, s.overruns, s.idle);
+    }
+    return 0;
+}
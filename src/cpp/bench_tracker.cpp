@@ -0,0 +1,138 @@
+/*
+ * bench_tracker.cpp
+ *
+ *      Author: maheriya
+ * Description: IoU tracker benchmark: N tracks x N detections (default 1000), detections are
+ *              the previous frame's boxes moved and jittered, plus a few clutter boxes
+ *              Usage: bench-tracker [boxes] [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "iou_tracker.hpp"
+
+using namespace std;
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+// Boxes scattered over [0, 1], sized like typical detections on a crowded frame
+static void makeFrame(mt19937& rng, vector<Detection>& base, int n) {
+    uniform_real_distribution<float> pos(0.0f, 0.97f), size(0.01f, 0.04f);
+    base.resize(n);
+    for (int i = 0; i < n; i++) {
+        Detection& d = base[i];
+        d.xmin = pos(rng); d.ymin = pos(rng);
+        d.xmax = d.xmin + size(rng); d.ymax = d.ymin + size(rng);
+        d.score = 1.0f; d.track = 0; d.timestamp = 0.0;
+    }
+}
+
+static void jitter(mt19937& rng, vector<Detection>& boxes) {
+    normal_distribution<float> j(0.0f, 0.0004f);
+    for (size_t i = 0; i < boxes.size(); i++) {
+        Detection& d = boxes[i];
+        float dx = j(rng), dy = j(rng);
+        d.xmin += dx + j(rng) * 0.5f; d.xmax += dx + j(rng) * 0.5f;
+        d.ymin += dy + j(rng) * 0.5f; d.ymax += dy + j(rng) * 0.5f;
+        d.track = 0;
+    }
+    shuffle(boxes.begin(), boxes.end(), rng); // detector order is unrelated to track order
+}
+
+static void runTracker(const char* name, int method, const vector<Detection>& first, int frames) {
+    mt19937 rng(7);
+    IoUTracker tracker;
+    tracker.setAssignment(method);
+    vector<Detection> boxes = first;
+    tracker.update(boxes); // creates the tracks
+
+    double total = 0.0, worst = 0.0, iou = 0.0, assign = 0.0;
+    for (int f = 0; f < frames; f++) {
+        jitter(rng, boxes);
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        tracker.update(boxes);
+        double ms = msSince(t);
+        total += ms;
+        worst = max(worst, ms);
+        iou += tracker.stats().iouMs;
+        assign += tracker.stats().assignMs;
+    }
+    const TrackerStats& s = tracker.stats();
+    printf("%-10s update %.3f ms avg, %.3f ms worst (IoU %.3f, assign %.3f); tracks %zu, "
+           "created %llu, dropped %llu, groups %zu (largest %zu), fallbacks %llu\n",
+           name, total / frames, worst, iou / frames, assign / frames, tracker.tracks(),
+           (unsigned long long)s.created, (unsigned long long)s.dropped, s.groups, s.largestGroup,
+           (unsigned long long)s.greedyFallbacks);
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : 1000;
+    int frames = (argc > 2) ? atoi(argv[2]) : 200;
+#if defined(__AVX__)
+    const char* isa = "AVX";
+#elif defined(__SSE2__)
+    const char* isa = "SSE2";
+#else
+    const char* isa = "scalar";
+#endif
+    printf("%d tracks x %d detections, %d frames, IoU kernels: %s\n", n, n, frames, isa);
+
+    mt19937 rng(1);
+    vector<Detection> first;
+    makeFrame(rng, first, n);
+
+    // Raw kernel throughput: the full matrix, and the thresholded candidate pass
+    BoxSoA a, b;
+    a.resize(n);
+    b.resize(n);
+    vector<Detection> moved = first;
+    jitter(rng, moved);
+    for (int i = 0; i < n; i++) {
+        a.set(i, first[i].xmin, first[i].ymin, first[i].xmax, first[i].ymax);
+        b.set(i, moved[i].xmin, moved[i].ymin, moved[i].xmax, moved[i].ymax);
+    }
+    vector<float> matrix(a.n * b.padded());
+    vector<IoUCandidate> cands;
+    double matrixMs = 1e9, candMs = 1e9;
+    for (int r = 0; r < 20; r++) {
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        iouMatrix(a, b, &matrix[0]);
+        matrixMs = min(matrixMs, msSince(t));
+        cands.clear();
+        t = chrono::steady_clock::now();
+        iouCandidates(a, b, 0.3f, cands);
+        candMs = min(candMs, msSince(t));
+    }
+    printf("iouMatrix     %.3f ms (%.0f M pairs/s)\n", matrixMs, (double)n * n / matrixMs / 1000.0);
+    printf("iouCandidates %.3f ms, %zu pairs >= 0.3\n", candMs, cands.size());
+
+    // Sweep variant: b sorted by x1
+    vector<Detection> sorted = moved;
+    sort(sorted.begin(), sorted.end(),
+         [](const Detection& p, const Detection& q) { return p.xmin < q.xmin; });
+    float maxWidth = 0.0f;
+    for (int i = 0; i < n; i++) {
+        b.set(i, sorted[i].xmin, sorted[i].ymin, sorted[i].xmax, sorted[i].ymax);
+        maxWidth = max(maxWidth, sorted[i].xmax - sorted[i].xmin);
+    }
+    vector<IoUCandidate> swept;
+    vector<size_t> scratch;
+    double sweepMs = 1e9;
+    for (int r = 0; r < 20; r++) {
+        swept.clear();
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        iouCandidatesSorted(a, b, maxWidth, 0.3f, swept, scratch);
+        sweepMs = min(sweepMs, msSince(t));
+    }
+    printf("iouCandidatesSorted %.3f ms, %zu pairs >= 0.3%s\n", sweepMs, swept.size(),
+           swept.size() == cands.size() ? "" : " (MISMATCH)");
+
+    runTracker("greedy", TRACKER_GREEDY, first, frames);
+    runTracker("hungarian", TRACKER_HUNGARIAN, first, frames);
+    return 0;
+}
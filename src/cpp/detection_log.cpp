@@ -0,0 +1,477 @@
+/*
+ * detection_log.cpp
+ *
+ *      Author: maheriya
+ * Description: Append-only detection log: writer, memory-mapped reader and replay driver
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "detection_log.hpp"
+
+using namespace std;
+
+static uint32_t packColor(const glm::vec3& c) {
+    uint32_t r = (uint32_t)(min(max(c.x, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(min(max(c.y, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(min(max(c.z, 0.0f), 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (255u << 24);
+}
+
+static glm::vec3 unpackColor(uint32_t c) {
+    return glm::vec3((c & 0xff) / 255.0f, ((c >> 8) & 0xff) / 255.0f, ((c >> 16) & 0xff) / 255.0f);
+}
+
+static void initHeader(DLogFileHeader* h, const char* magic) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, magic, sizeof(h->magic));
+    h->version = DLOG_VERSION;
+    h->headerSize = sizeof(DLogFileHeader);
+    h->recordSize = sizeof(DLogRecord);
+    h->boxSize = sizeof(DLogBox);
+}
+
+static bool checkHeader(const DLogFileHeader* h, const char* magic) {
+    return memcmp(h->magic, magic, sizeof(h->magic)) == 0 && h->version == DLOG_VERSION &&
+           h->headerSize == sizeof(DLogFileHeader) && h->recordSize == sizeof(DLogRecord) &&
+           h->boxSize == sizeof(DLogBox);
+}
+
+static string indexPath(const char* path) {
+    return string(path) + ".idx";
+}
+
+//-------------------------------------------------------------------------------------
+// Writer
+//-------------------------------------------------------------------------------------
+DetectionLogWriter::DetectionLogWriter(void) :
+    mLog(NULL),
+    mIndex(NULL),
+    mOffset(0),
+    mFrames(0) { }
+
+DetectionLogWriter::~DetectionLogWriter(void) {
+    close();
+}
+
+bool DetectionLogWriter::open(const char* path) {
+    close();
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_size > 0) {
+        // Append: continue after the last complete record, with the same label IDs
+        DetectionLog existing;
+        if (!existing.open(path)) {
+            printf("DetectionLogWriter: %s is not a detection log\n", path);
+            return false;
+        }
+        mOffset = existing.validEnd();
+        mFrames = existing.frames();
+        for (size_t i = 0; i < existing.labels().size(); i++)
+            mLabelIds[existing.labels()[i]] = (uint32_t)i;
+        if (!existing.saveIndex()) {
+            printf("DetectionLogWriter: could not write %s\n", indexPath(path).c_str());
+            return false;
+        }
+        existing.close();
+        if (truncate(path, (off_t)mOffset) != 0) {
+            printf("DetectionLogWriter: could not truncate %s to its last complete record\n", path);
+            return false;
+        }
+        mLog = fopen(path, "ab");
+        mIndex = fopen(indexPath(path).c_str(), "ab");
+    } else {
+        mLog = fopen(path, "wb");
+        mIndex = fopen(indexPath(path).c_str(), "wb");
+        DLogFileHeader h;
+        initHeader(&h, DLOG_MAGIC);
+        if (mLog != NULL)
+            fwrite(&h, sizeof(h), 1, mLog);
+        initHeader(&h, DLOG_INDEX_MAGIC);
+        if (mIndex != NULL)
+            fwrite(&h, sizeof(h), 1, mIndex);
+        mOffset = sizeof(h);
+        mFrames = 0;
+    }
+    if (mLog == NULL || mIndex == NULL) {
+        printf("DetectionLogWriter: could not open %s for writing\n", path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void DetectionLogWriter::close(void) {
+    if (mLog != NULL)
+        fclose(mLog);
+    if (mIndex != NULL)
+        fclose(mIndex);
+    mLog = NULL;
+    mIndex = NULL;
+    mLabelIds.clear();
+}
+
+void DetectionLogWriter::flush(void) {
+    if (mLog != NULL)
+        fflush(mLog);
+    if (mIndex != NULL)
+        fflush(mIndex);
+}
+
+bool DetectionLogWriter::writeIndex(const DLogIndexEntry& entry) {
+    return fwrite(&entry, sizeof(entry), 1, mIndex) == 1;
+}
+
+bool DetectionLogWriter::writeLabel(const string& label, uint32_t id) {
+    static const char pad[8] = { 0 };
+    DLogRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = DLOG_LABEL;
+    rec.count = (uint32_t)label.size();
+    rec.size = (uint32_t)(sizeof(rec) + (label.size() + 7) / 8 * 8);
+    rec.frameId = id;
+    DLogIndexEntry entry = { 0.0, mOffset, id, DLOG_LABEL, (uint32_t)mFrames };
+    if (fwrite(&rec, sizeof(rec), 1, mLog) != 1 ||
+        fwrite(label.data(), 1, label.size(), mLog) != label.size() ||
+        fwrite(pad, 1, rec.size - sizeof(rec) - label.size(), mLog) != rec.size - sizeof(rec) - label.size() ||
+        !writeIndex(entry))
+        return false;
+    mOffset += rec.size;
+    return true;
+}
+
+bool DetectionLogWriter::write(uint64_t frameId, double timestamp, const vector<Detection>& dets) {
+    if (mLog == NULL)
+        return false;
+    mBoxes.resize(dets.size());
+    for (size_t i = 0; i < dets.size(); i++) {
+        const Detection& d = dets[i];
+        map<string, uint32_t>::iterator it = mLabelIds.find(d.label);
+        uint32_t label;
+        if (it == mLabelIds.end()) {
+            label = (uint32_t)mLabelIds.size();
+            if (!writeLabel(d.label, label))
+                return false;
+            mLabelIds[d.label] = label;
+        } else {
+            label = it->second;
+        }
+        DLogBox& b = mBoxes[i];
+        b.xmin = d.xmin; b.ymin = d.ymin; b.xmax = d.xmax; b.ymax = d.ymax;
+        b.score = d.score;
+        b.classId = d.classId;
+        b.track = d.track;
+        b.label = label;
+        b.color = packColor(d.color);
+        b.reserved = 0;
+    }
+
+    DLogRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = DLOG_FRAME;
+    rec.size = (uint32_t)(sizeof(rec) + dets.size() * sizeof(DLogBox));
+    rec.frameId = frameId;
+    rec.timestamp = timestamp;
+    rec.count = (uint32_t)dets.size();
+    if ((mFrames % DLOG_INDEX_INTERVAL) == 0) {
+        DLogIndexEntry entry = { timestamp, mOffset, frameId, DLOG_FRAME, (uint32_t)mFrames };
+        if (!writeIndex(entry))
+            return false;
+    }
+    if (fwrite(&rec, sizeof(rec), 1, mLog) != 1 ||
+        (dets.size() > 0 && fwrite(&mBoxes[0], sizeof(DLogBox), dets.size(), mLog) != dets.size()))
+        return false;
+    mOffset += rec.size;
+    mFrames++;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------
+// Reader
+//-------------------------------------------------------------------------------------
+DetectionLog::DetectionLog(void) :
+    mFd(-1),
+    mData(NULL),
+    mSize(0),
+    mEnd(0),
+    mFrames(0),
+    mStartTime(0.0),
+    mEndTime(0.0) { }
+
+DetectionLog::~DetectionLog(void) {
+    close();
+}
+
+void DetectionLog::close(void) {
+    if (mData != NULL)
+        munmap(mData, mSize);
+    if (mFd >= 0)
+        ::close(mFd);
+    mData = NULL;
+    mFd = -1;
+    mSize = mEnd = mFrames = 0;
+    mIndex.clear();
+    mLabelEntries.clear();
+    mLabels.clear();
+}
+
+bool DetectionLog::map(void) {
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || (uint64_t)st.st_size < sizeof(DLogFileHeader))
+        return false;
+    if (mData != NULL)
+        munmap(mData, mSize);
+    mSize = st.st_size;
+    mData = (uint8_t*)mmap(NULL, mSize, PROT_READ, MAP_SHARED, mFd, 0);
+    if (mData == MAP_FAILED) {
+        mData = NULL;
+        return false;
+    }
+    madvise(mData, mSize, MADV_SEQUENTIAL);
+    return true;
+}
+
+// A complete, well-formed record at 'offset', or NULL
+const DLogRecord* DetectionLog::record(uint64_t offset) const {
+    if (offset < sizeof(DLogFileHeader) || offset + sizeof(DLogRecord) > mSize || (offset & 7) != 0)
+        return NULL;
+    const DLogRecord* rec = (const DLogRecord*)(mData + offset);
+    if (rec->size < sizeof(DLogRecord) || (rec->size & 7) != 0 || offset + rec->size > mSize)
+        return NULL;
+    if (rec->type == DLOG_FRAME)
+        return (rec->size == sizeof(DLogRecord) + (uint64_t)rec->count * sizeof(DLogBox)) ? rec : NULL;
+    if (rec->type == DLOG_LABEL)
+        return (rec->count <= rec->size - sizeof(DLogRecord)) ? rec : NULL;
+    return NULL;
+}
+
+void DetectionLog::addLabel(const DLogRecord* rec) {
+    if (rec->frameId != mLabels.size())
+        return; // IDs are handed out in order; anything else is a duplicate
+    mLabels.push_back(string((const char*)(rec + 1), rec->count));
+}
+
+bool DetectionLog::open(const char* path) {
+    close();
+    mFd = ::open(path, O_RDONLY);
+    if (mFd < 0) {
+        printf("DetectionLog: could not open %s\n", path);
+        return false;
+    }
+    if (!map() || !checkHeader((const DLogFileHeader*)mData, DLOG_MAGIC)) {
+        printf("DetectionLog: %s is not a detection log\n", path);
+        close();
+        return false;
+    }
+    mIndexPath = indexPath(path);
+
+    // Index entries that point at valid records; the rest of the log is scanned below
+    FILE* fp = fopen(mIndexPath.c_str(), "rb");
+    if (fp != NULL) {
+        DLogFileHeader h;
+        DLogIndexEntry e;
+        if (fread(&h, sizeof(h), 1, fp) == 1 && checkHeader(&h, DLOG_INDEX_MAGIC)) {
+            while (fread(&e, sizeof(e), 1, fp) == 1) {
+                const DLogRecord* rec = record(e.offset);
+                if (rec == NULL || rec->type != e.type)
+                    break;
+                if (e.type == DLOG_LABEL) {
+                    addLabel(rec);
+                    mLabelEntries.push_back(e);
+                } else {
+                    if (!mIndex.empty() && e.offset <= mIndex.back().offset)
+                        break;
+                    mIndex.push_back(e);
+                }
+            }
+        }
+        fclose(fp);
+    }
+    if (mIndex.empty())
+        scan(sizeof(DLogFileHeader), 0);
+    else
+        scan(mIndex.back().offset, mIndex.back().ordinal);
+
+    const DLogRecord* f = frame(first());
+    mStartTime = (f != NULL) ? f->timestamp : 0.0;
+    return true;
+}
+
+bool DetectionLog::refresh(void) {
+    if (mFd < 0 || !map())
+        return false;
+    bool empty = (mFrames == 0);
+    if (mIndex.empty())
+        scan(sizeof(DLogFileHeader), 0);
+    else
+        scan(mIndex.back().offset, mIndex.back().ordinal);
+    if (empty && mFrames > 0)
+        mStartTime = frame(first())->timestamp;
+    return true;
+}
+
+void DetectionLog::scan(uint64_t offset, uint32_t ordinal) {
+    mEnd = offset;
+    for (const DLogRecord* rec = record(offset); rec != NULL; rec = record(offset)) {
+        if (rec->type == DLOG_LABEL) {
+            if (rec->frameId == mLabels.size()) {
+                DLogIndexEntry e = { 0.0, offset, rec->frameId, DLOG_LABEL, ordinal };
+                mLabelEntries.push_back(e);
+            }
+            addLabel(rec);
+        } else {
+            if ((ordinal % DLOG_INDEX_INTERVAL) == 0 && (mIndex.empty() || offset > mIndex.back().offset)) {
+                DLogIndexEntry e = { rec->timestamp, offset, rec->frameId, DLOG_FRAME, ordinal };
+                mIndex.push_back(e);
+            }
+            mEndTime = rec->timestamp;
+            ordinal++;
+        }
+        offset += rec->size;
+        mEnd = offset;
+    }
+    mFrames = ordinal;
+}
+
+bool DetectionLog::saveIndex(void) const {
+    FILE* fp = fopen(mIndexPath.c_str(), "wb");
+    if (fp == NULL)
+        return false;
+    DLogFileHeader h;
+    initHeader(&h, DLOG_INDEX_MAGIC);
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    // Both kinds, in log order
+    size_t f = 0, l = 0;
+    while (ok && (f < mIndex.size() || l < mLabelEntries.size())) {
+        bool label = (f == mIndex.size()) ||
+                     (l < mLabelEntries.size() && mLabelEntries[l].offset < mIndex[f].offset);
+        ok = fwrite(label ? &mLabelEntries[l++] : &mIndex[f++], sizeof(DLogIndexEntry), 1, fp) == 1;
+    }
+    return (fclose(fp) == 0) && ok;
+}
+
+uint64_t DetectionLog::first(void) const {
+    if (!mIndex.empty())
+        return mIndex[0].offset;
+    return 0;
+}
+
+const DLogRecord* DetectionLog::frame(uint64_t offset) const {
+    if (offset == 0 || offset >= mEnd)
+        return NULL;
+    const DLogRecord* rec = record(offset);
+    return (rec != NULL && rec->type == DLOG_FRAME) ? rec : NULL;
+}
+
+uint64_t DetectionLog::next(uint64_t offset) const {
+    const DLogRecord* rec = record(offset);
+    if (rec == NULL)
+        return 0;
+    for (offset += rec->size; offset < mEnd; offset += rec->size) {
+        rec = record(offset);
+        if (rec == NULL)
+            return 0;
+        if (rec->type == DLOG_FRAME)
+            return offset;
+    }
+    return 0;
+}
+
+uint64_t DetectionLog::seek(double t) const {
+    if (mIndex.empty())
+        return 0;
+    // Last indexed frame before t, then forward
+    vector<DLogIndexEntry>::const_iterator it = upper_bound(mIndex.begin(), mIndex.end(), t,
+        [](double v, const DLogIndexEntry& e) { return v <= e.timestamp; });
+    uint64_t offset = (it == mIndex.begin()) ? mIndex[0].offset : (it - 1)->offset;
+    for (const DLogRecord* rec = frame(offset); rec != NULL; rec = frame(offset)) {
+        if (rec->timestamp >= t)
+            return offset;
+        offset = next(offset);
+    }
+    return 0;
+}
+
+void DetectionLog::read(const DLogRecord* rec, vector<Detection>& out) const {
+    const DLogBox* box = (const DLogBox*)(rec + 1);
+    size_t base = out.size();
+    out.resize(base + rec->count);
+    for (uint32_t i = 0; i < rec->count; i++) {
+        const DLogBox& b = box[i];
+        Detection& d = out[base + i];
+        d.xmin = b.xmin; d.ymin = b.ymin; d.xmax = b.xmax; d.ymax = b.ymax;
+        d.color = unpackColor(b.color);
+        if (b.label < mLabels.size())
+            d.label = mLabels[b.label];
+        else
+            d.label.clear();
+        d.score = b.score;
+        d.track = b.track;
+        d.timestamp = rec->timestamp;
+        d.classId = b.classId;
+    }
+}
+
+//-------------------------------------------------------------------------------------
+// Replay
+//-------------------------------------------------------------------------------------
+DetectionReplay::DetectionReplay(DetectionLog& log) :
+    mLog(log),
+    mSpeed(1.0),
+    mRestamp(true),
+    mLogStart(0.0),
+    mWallStart(0.0),
+    mNext(0),
+    mLast(0),
+    mStarted(false),
+    mStats() { }
+
+void DetectionReplay::seek(double t, double now) {
+    mNext = mLog.seek(t);
+    mLast = 0;
+    mLogStart = t;
+    mWallStart = now;
+    mStarted = true;
+    mStats.seeks++;
+}
+
+double DetectionReplay::logTime(double now) const {
+    return mLogStart + (now - mWallStart) * mSpeed;
+}
+
+bool DetectionReplay::update(double now, vector<Detection>& out, uint64_t* frameId, double* timestamp) {
+    if (!mStarted)
+        seek(mLog.startTime(), now);
+    if (mNext == 0 && mLast != 0)
+        mNext = mLog.next(mLast); // a live log may have grown (DetectionLog::refresh)
+
+    // Newest frame that is due; older due frames are skipped
+    double t = logTime(now);
+    const DLogRecord* due = NULL;
+    for (const DLogRecord* rec = mLog.frame(mNext); rec != NULL && rec->timestamp <= t; rec = mLog.frame(mNext)) {
+        if (due != NULL)
+            mStats.skipped++;
+        due = rec;
+        mLast = mNext;
+        mNext = mLog.next(mNext);
+    }
+    if (due == NULL)
+        return false;
+
+    size_t base = out.size();
+    mLog.read(due, out);
+    if (mRestamp) {
+        double wall = mWallStart + (due->timestamp - mLogStart) / mSpeed;
+        for (size_t i = base; i < out.size(); i++)
+            out[i].timestamp = wall;
+    }
+    if (frameId != NULL)
+        *frameId = due->frameId;
+    if (timestamp != NULL)
+        *timestamp = due->timestamp;
+    mStats.frames++;
+    return true;
+}
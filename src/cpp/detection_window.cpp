@@ -7,12 +7,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
 #include "detection_window.hpp"
 #include <opencv2/opencv.hpp>
-#include <opencv2/core/opengl.hpp>
-
-#include <ft2build.h>
-#include FT_FREETYPE_H
 
 using namespace std;
 #define SHOW_IMAGE       1
@@ -24,7 +24,7 @@ using namespace std;
 
 
 inline int DetectionWindow::_checkError(char *file, int line) {
-    GLenum error_code = glGetError();
+    GLenum error_code = gltGetError();
     if (error_code != GL_NO_ERROR) {
         printf("OpenGL Error: %d (%s:%d)\n", error_code, file, line);
         return GL_FALSE;
@@ -32,46 +32,88 @@ inline int DetectionWindow::_checkError(char *file, int line) {
     return GL_TRUE;
 }
 
-// Callback for errors
-static void glfw_error_callback(int error, const char* desc) {
-    fprintf(stderr, "glfw_error_callback(): Error %d: %s\n", error, desc);
-}
-
 // Callback for keys (ESCAPE key will cause closing the window)
 static void glfw_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
+    // F12: screenshot (when the window has a capture encoder)
+    DetectionWindow* dw = (DetectionWindow*)glfwGetWindowUserPointer(window);
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS && dw != NULL) {
+        char path[64];
+        time_t now = time(NULL);
+        strftime(path, sizeof(path), "screenshot_%Y%m%d_%H%M%S.png", localtime(&now));
+        dw->captureFrame(path);
+    }
+
+}
 
+// Mouse: box picking (see DetectionWindow::setPickListener)
+static void glfw_cursor_pos_callback(GLFWwindow* window, double x, double y) {
+    DetectionWindow* dw = (DetectionWindow*)glfwGetWindowUserPointer(window);
+    if (dw != NULL)
+        dw->cursorMoved(x, y);
+}
+
+static void glfw_mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    DetectionWindow* dw = (DetectionWindow*)glfwGetWindowUserPointer(window);
+    if (dw != NULL && button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+        dw->clicked();
+}
+
+static void glfw_cursor_enter_callback(GLFWwindow* window, int entered) {
+    DetectionWindow* dw = (DetectionWindow*)glfwGetWindowUserPointer(window);
+    if (dw != NULL && !entered)
+        dw->cursorLeft();
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 static void glfw_fb_size_callback(GLFWwindow* window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // The viewport must match the new window dimensions; note that width and height will be
+    // significantly larger than specified on retina displays. Another window's context may be
+    // current here, so only record the size; display() applies it on this window's context.
+    DetectionWindow* dw = (DetectionWindow*)glfwGetWindowUserPointer(window);
+    if (dw != NULL)
+        dw->resized(width, height);
 }
 
-int DetectionWindow::initializeGLFW(void) {
-    if (glfwInit() == GL_FALSE)
-        return GL_FALSE;
-
-    glfwWindowHint(GLFW_SAMPLES, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // 4.2 works too
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, 1);
-    glfwSetErrorCallback(glfw_error_callback);
+// Milliseconds since t; t is moved to now (lap timer for the startup phases)
+static double lapMs(chrono::steady_clock::time_point& t) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(now - t).count();
+    t = now;
+    return ms;
+}
 
-    return GL_TRUE;
+void DetectionWindow::makeCurrent(void) {
+    if (mWindow != NULL)
+        glfwMakeContextCurrent(mWindow);
+    gltState = &mGLState;
+    gltTrace = &mTrace;
 }
 
 int DetectionWindow::createWindow(int width, int height, string winname) {
-    if (initializeGLFW() == GL_FALSE) {
-        printf("Failed to initialize GLFW\n");
+    memset(&mStartup, 0, sizeof(mStartup));
+    mStartTime = chrono::steady_clock::now();
+    mFirstFrameShown = false;
+
+    // The first window pays for GLFW, GLEW, shaders and fonts; later ones share them
+    mContext = RenderContext::acquire(&mStartup);
+    if (mContext == NULL) {
+        printf("Failed to create the shared render context\n");
         return GL_FALSE;
     }
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+
+    if (gltIsNoop()) {
+        // No-op GL backend: no window and no context. Only the render path runs (and is counted).
+        mWidth = mFbWidth = width;
+        mHeight = mFbHeight = height;
+        makeCurrent();
+        gltInvalidateState();
+        return initBuffers();
+    }
     GLFWmonitor *primary = glfwGetPrimaryMonitor();
     const GLFWvidmode *mode = glfwGetVideoMode(primary);
     mScreenWidth = mode->width;
@@ -80,40 +122,38 @@ int DetectionWindow::createWindow(int width, int height, string winname) {
     mWidth = (width <= mScreenWidth) ? width : mScreenWidth;
     mHeight = (height <= mScreenHeight) ? height : mScreenHeight;
 
-    mWindow = glfwCreateWindow(mWidth, mHeight, winname.c_str(), NULL, NULL);
+    mWindow = glfwCreateWindow(mWidth, mHeight, winname.c_str(), NULL, mContext->shareWindow());
     printf("Window size (created): %dx%d\n", mWidth, mHeight);
     if (mWindow == NULL) {
-        glfwTerminate();
+        mContext->release();
+        mContext = NULL;
         printf("Failed to create window");
         return GL_FALSE;
     }
 
-    glfwMakeContextCurrent(mWindow);
+    makeCurrent();
+    glfwSetWindowUserPointer(mWindow, this);
     glfwSetKeyCallback(mWindow, glfw_key_callback);
     glfwSetFramebufferSizeCallback(mWindow, glfw_fb_size_callback);
-
-
-    glewExperimental = GL_TRUE; // *Needed* for core profile
-    if (glewInit() != GLEW_OK) {
-        glfwTerminate();
-        printf("%s\n", "glewInit() failed");
-        return GL_FALSE;
-    }
+    glfwSetCursorPosCallback(mWindow, glfw_cursor_pos_callback);
+    glfwSetMouseButtonCallback(mWindow, glfw_mouse_button_callback);
+    glfwSetCursorEnterCallback(mWindow, glfw_cursor_enter_callback);
+    glfwGetFramebufferSize(mWindow, &mFbWidth, &mFbHeight);
+    // Only the first window waits for vsync; otherwise N windows would present at 1/N the rate
+    glfwSwapInterval(mContext->windows() > 1 ? 0 : 1);
 
     // Define the viewport dimensions
-    glViewport(0, 0, mWidth, mHeight);
+    gltViewport(0, 0, mFbWidth, mFbHeight);
 
-    // glewInit() may cause an OpenGL error; we just want to clear the error. Ignore error.
-    GLenum error_code = glGetError();
-    if ((error_code != GL_NO_ERROR) && (error_code != GL_INVALID_ENUM)) {
-        printf("OpenGL Error: %d (line %d)\n", error_code, __LINE__);
-    }
-    glDisable(GL_DEPTH_TEST); // Ignore z values enforce ordered drawing
-    glDepthFunc(GL_NEVER);
+    // Objects are shared with the root context, but binding and fixed function state is not
+    gltInvalidateState(); // fresh context; nothing is known to be bound yet
+    gltDisable(GL_DEPTH_TEST); // Ignore z values enforce ordered drawing
+    gltDepthFunc(GL_NEVER);
     // Enable transparency (for box lines, text, e.g.)
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glClearColor(0.2f, 0.2f, 0.2f , 0.2f);
+    gltEnable(GL_BLEND);
+    gltBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gltClearColor(0.2f, 0.2f, 0.2f , 0.2f);
+    mStartup.window = lapMs(t);
 
     return initBuffers();
 }
@@ -124,42 +164,59 @@ void DetectionWindow::setTitle(char* title) {
 
 
 int DetectionWindow::initBuffers(void) {
-    if (mWindow == NULL) {
+    if (mWindow == NULL && !gltIsNoop()) {
         printf("Window is not created yet!\n");
         return GL_FALSE;
     }
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+
+    // VAOs are not shared between contexts; every window builds its own around the shared programs
+    mImageShaderProgram = mContext->imageProgram();
+    mBBoxShaderProgram = mContext->bboxProgram();
+    mTextShaderProgram = mContext->textProgram();
+
+    GLint ret = GL_TRUE;
 #if SHOW_IMAGE
-    if (initImageBuffers() == GL_FALSE) {
-        glfwTerminate();
-        return GL_FALSE;
-    }
+    if (initImageBuffers() == GL_FALSE)
+        ret = GL_FALSE;
 #endif
 
 #if SHOW_BBOX
-    if (initBBoxBuffers()  == GL_FALSE) {
-        glfwTerminate();
-        return GL_FALSE;
-    }
+    if (initBBoxBuffers()  == GL_FALSE)
+        ret = GL_FALSE;
 #endif
 
 #if SHOW_TEXT
-    if (initTextBuffers()  == GL_FALSE) {
-        glfwTerminate();
+    if (initTextBuffers()  == GL_FALSE)
+        ret = GL_FALSE;
+#endif
+    if (ret == GL_FALSE) {
+        cleanup();
         return GL_FALSE;
     }
-#endif
 
+    mStartup.buffers = lapMs(t);
+    mStartup.total = chrono::duration<double, milli>(t - mStartTime).count();
+
+    printStartupTimings();
     return GL_TRUE;
 }
 
+void DetectionWindow::printStartupTimings(void) {
+    printf("Startup (ms): glfw %.1f, glew %.1f, shaders %.1f + %.1f wait, "
+           "fonts %.1f raster (%.1f wait) + %.1f upload, window %.1f, buffers %.1f; total %.1f "
+           "(%d window(s) sharing the context)\n",
+           mStartup.glfwInit, mStartup.glew, mStartup.shaderIssue, mStartup.shaderWait,
+           mStartup.fontRaster, mStartup.fontWait, mStartup.glyphUpload, mStartup.window,
+           mStartup.buffers, mStartup.total, mContext->windows());
+}
+
 int DetectionWindow::initImageBuffers(void) {
+    mImageUniFormat = gltGetUniformLocation(mImageShaderProgram, "format");
+    mImageUniYUVMatrix = gltGetUniformLocation(mImageShaderProgram, "yuvMatrix");
+    mImageUniYUVOffset = gltGetUniformLocation(mImageShaderProgram, "yuvOffset");
+
     mImageVAO = createVertexArray();
-    GLint ret = createImageShaders(&mImageShaderProgram);
-    if (ret == GL_FALSE) {
-        cleanup();
-        printf("Image shader compilation failed\n");
-        return GL_FALSE;
-    }
 
     // Canvas for image (triangles strip to make a quad)
     const GLshort mVertices[] = {
@@ -172,10 +229,10 @@ int DetectionWindow::initImageBuffers(void) {
 
 
     mImageVertexBuffer = createVertexBuffer(mVertices, sizeof(mVertices));
-    glBindBuffer(GL_ARRAY_BUFFER, mImageVertexBuffer);
-    glEnableVertexAttribArray(0);
+    gltBindBuffer(GL_ARRAY_BUFFER, mImageVertexBuffer);
+    gltEnableVertexAttribArray(0);
     //                 index​, size​,     type​, normalized​, stride​, *offset​
-    glVertexAttribPointer(0,     4, GL_SHORT,   GL_FALSE,      0,    NULL);
+    gltVertexAttribPointer(0,     4, GL_SHORT,   GL_FALSE,      0,    NULL);
 
     // cleanup
     unBindBuffers();
@@ -184,21 +241,20 @@ int DetectionWindow::initImageBuffers(void) {
 }
 
 int DetectionWindow::initBBoxBuffers(void) {
-
-    GLint ret = createBBoxShaders(&mBBoxShaderProgram);
-    if (ret == GL_FALSE) {
-        cleanup();
-        printf("BBox shader compilation failed\n");
-        return GL_FALSE;
-    }
     // Get a handle for BBox color uniform
-    mBBoxUniColor = glGetUniformLocation(mBBoxShaderProgram, "BBCOLOR");
-    glLineWidth(mLineWidth);
+    mBBoxUniColor = gltGetUniformLocation(mBBoxShaderProgram, "BBCOLOR");
+    gltLineWidth(mLineWidth);
 
     mBBoxVAO = createVertexArray();
     mBBoxVertexBuffer = createVertexBuffer(NULL, sizeof(GLfloat) * NUM_BOX_VERTICES * 2, false);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    gltEnableVertexAttribArray(0);
+    gltVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+    // Trails: same layout, sized on first use (see showBBox)
+    mTrailVAO = createVertexArray();
+    mTrailVertexBuffer = createVertexBuffer(NULL, 0, false);
+    gltEnableVertexAttribArray(0);
+    gltVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
 
     // cleanup
     unBindBuffers();
@@ -207,34 +263,17 @@ int DetectionWindow::initBBoxBuffers(void) {
 }
 
 int DetectionWindow::initTextBuffers(void) {
-    // Initialize Shader
-    GLint ret = createTextShaders(&mTextShaderProgram);
-    if (ret == GL_FALSE) {
-        cleanup();
-        printf("Text shader compilation failed\n");
-        return GL_FALSE;
-    }
-
-
     // Initialize uniforms' IDs
-    mTextUniTexSampler = glGetUniformLocation(mTextShaderProgram, "texSampler");
-    mTextUniTextColor = glGetUniformLocation(mTextShaderProgram, "textColor");
+    mTextUniTexSampler = gltGetUniformLocation(mTextShaderProgram, "texSampler");
+    mTextUniTextColor = gltGetUniformLocation(mTextShaderProgram, "textColor");
 
-    // Orthographic projection (for text). Set up to allow specifying coordinates in screen pixels units
-    glm::mat4 projection = glm::ortho(0.0f, (float)mWidth, 0.0f, (float)mHeight);
-    //glm::mat4 projection = glm::ortho(0.0f, 1.0f, 0.0f, 1.0f); // 0..1 x, 1..0 y. OpenCV convention
-    GLuint textUniProjection = glGetUniformLocation(mTextShaderProgram, "projection");
-
-    glUseProgram(mTextShaderProgram);
-    glUniformMatrix4fv(textUniProjection, 1, GL_FALSE, glm::value_ptr(projection));
-
-    if (loadFonts() == GL_FALSE)
-        return GL_FALSE;
+    // The projection depends on the window size and the program is shared; set in showText()
+    mTextUniProjection = gltGetUniformLocation(mTextShaderProgram, "projection");
 
     mTextVAO = createVertexArray();
     mTextVertexBuffer = createVertexBuffer(NULL, sizeof(GLfloat) * NUM_BOX_VERTICES * 4, false);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+    gltEnableVertexAttribArray(0);
+    gltVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, NULL);
 
     // cleanup
     unBindBuffers();
@@ -242,305 +281,1453 @@ int DetectionWindow::initTextBuffers(void) {
     return checkError();
 }
 
+// Common start of all display modes: clear, and place the tracked boxes for this frame
+void DetectionWindow::beginFrame(void) {
+    gltViewport(0, 0, mFbWidth, mFbHeight);
+    gltClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    mTracks.resolve(displayTime(), detections);
+}
+
+// Seconds on the clock detection timestamps use
+double DetectionWindow::displayTime(void) {
+    if (mWindow != NULL)
+        return glfwGetTime();
+    return chrono::duration<double>(chrono::steady_clock::now() - mStartTime).count();
+}
+
+void DetectionWindow::addDetection(Detection& det) {
+    addStreamDetection(0, det);
+}
+
+void DetectionWindow::addStreamDetection(int stream, const Detection& det) {
+    if (det.track <= 0) {
+        detections.push_back(det);
+        return;
+    }
+    // Tracked boxes are kept across frames and moved at display time (see beginFrame)
+    if (det.timestamp == 0.0) {
+        Detection stamped = det;
+        stamped.timestamp = displayTime();
+        mTracks.observe(stamped, stream);
+    } else {
+        mTracks.observe(det, stream);
+    }
+}
+
+void DetectionWindow::addTrail(const glm::vec2* points, int count, glm::vec3 color) {
+    if (count < 2)
+        return;
+    Trail trail = { (GLint)mTrailVertices.size(), (GLsizei)count, color };
+    mTrailVertices.insert(mTrailVertices.end(), points, points + count);
+    mTrails.push_back(trail);
+}
+
+#if WITH_CUDA
 int DetectionWindow::display(cv::cuda::GpuMat& img) {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    makeCurrent();
+    beginFrame();
+
+#if SHOW_IMAGE
+    showImage(img);
+#endif
+    return finishFrame();
+}
+#endif
+
+int DetectionWindow::display(const cv::Mat& img) {
+    makeCurrent();
+    beginFrame();
 
 #if SHOW_IMAGE
     showImage(img);
 #endif
+    return finishFrame();
+}
+
+int DetectionWindow::displayMosaic(void) {
+    makeCurrent();
+    beginFrame();
+
+#if SHOW_IMAGE
+    showMosaic();
+#endif
+    return finishFrame();
+}
+
+// Overlays, swap and per-frame bookkeeping common to all display modes
+int DetectionWindow::finishFrame(void) {
+    showHeatmap();
+    showOverlay();
+    applyLod();
+    updatePicking();
 #if SHOW_BBOX
     showBBox();
 #endif
 #if SHOW_TEXT
     showText();
 #endif
+    capture();
+    // Cursor events until the next frame pick from this one
+    mPickDets.swap(detections);
 
-    glfwSwapBuffers(mWindow);
-    glfwPollEvents();
+    if (mWindow != NULL) {
+        glfwSwapBuffers(mWindow);
+        glfwPollEvents();
+    }
+    if (!mFirstFrameShown) {
+        mFirstFrameShown = true;
+        mStartup.firstFrame = chrono::duration<double, milli>(chrono::steady_clock::now() - mStartTime).count();
+        printf("Time to first frame: %.1f ms\n", mStartup.firstFrame);
+    }
+    gltEndFrame();
     delDetections();
+    return GL_TRUE;
 }
 
 
-int DetectionWindow::showImage(cv::cuda::GpuMat& img) {
-    glBindVertexArray(mImageVAO);
-    glUseProgram(mImageShaderProgram);
-
-    glBindBuffer(GL_ARRAY_BUFFER, mImageVertexBuffer);
-    glEnableVertexAttribArray(0);
-    //                 index​, size​,     type​, normalized​, stride​, *offset​
-    glVertexAttribPointer(0,     4, GL_SHORT,   GL_FALSE,      0,    NULL);
+int DetectionWindow::captureFrame(const string& path) {
+    if (mEncoder == NULL || !mEncoder->running()) {
+        printf("No capture encoder; %s not written\n", path.c_str());
+        return GL_FALSE;
+    }
+    mCapturePath = path;
+    return GL_TRUE;
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mImageTexID);
-    cv::ogl::Texture2D tex(img);
-    tex.bind();
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+int DetectionWindow::startClip(const string& pattern, int frames) {
+    if (mEncoder == NULL || !mEncoder->running()) {
+        printf("No capture encoder; clip %s not written\n", pattern.c_str());
+        return GL_FALSE;
+    }
+    mClipPattern = pattern;
+    mClipFrames = (frames > 0) ? frames : -1;
+    mClipIndex = 0;
+    return GL_TRUE;
+}
 
-    // Cleanup
-    unBindBuffers();
+// Picks up finished readbacks, then reads back this frame if it was asked for. Runs before the
+// swap, on the back buffer holding the composited frame.
+void DetectionWindow::capture(void) {
+    if (mEncoder == NULL ||
+        (mReadbackCount == 0 && mCapturePath.empty() && mClipFrames == 0 && mRecorder == NULL))
+        return;
+    collectReadbacks(false);
+    if (mRecorder != NULL) {
+        double t = displayTime();
+        mRecorder->check(detections, t);
+        if (mRecorder->wantFrame(t))
+            readback(string(), mRecorder);
+    }
+    if (!mCapturePath.empty()) {
+        readback(mCapturePath);
+        mCapturePath.clear();
+    }
+    if (mClipFrames != 0) {
+        char path[1024];
+        snprintf(path, sizeof(path), mClipPattern.c_str(), mClipIndex++);
+        readback(path);
+        if (mClipFrames > 0)
+            mClipFrames--;
+    }
+}
 
-    return GL_TRUE;
+// Starts an asynchronous copy of the back buffer into the next free pixel buffer. BGRA is the
+// layout drivers copy out without conversion.
+void DetectionWindow::readback(const string& path, EventRecorder* recorder) {
+    mEncoder->countRequest();
+    if (mReadbackCount == CAPTURE_BUFFERS) {
+        mEncoder->countReadbackDrop();
+        return;
+    }
+    Readback& rb = mReadbacks[(mReadbackHead + mReadbackCount) % CAPTURE_BUFFERS];
+    GLsizeiptr size = (GLsizeiptr)mFbWidth * mFbHeight * 4;
+    // Pooled: after a resize the old size class goes back, for the next window of that size
+    if (rb.pbo.buf == 0 || rb.pbo.capacity < size || rb.pbo.capacity >= 2 * size) {
+        mContext->pool().release(rb.pbo);
+        rb.pbo = mContext->pool().acquireBuffer(size, GL_STREAM_READ);
+    }
+    rb.size = size;
+    gltBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo.buf);
+    gltReadPixels(0, 0, mFbWidth, mFbHeight, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+    gltBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rb.fence = gltFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    rb.width = mFbWidth;
+    rb.height = mFbHeight;
+    rb.path = path;
+    rb.recorder = recorder;
+    rb.timestamp = displayTime();
+    mReadbackCount++;
 }
 
-int DetectionWindow::showBBox(void) {
-    glBindVertexArray(mBBoxVAO);
-    glUseProgram(mBBoxShaderProgram);
+// Hands the finished readbacks (oldest first) to the encoder. Without 'wait', stops at the first
+// one the GPU has not finished, so the render loop never blocks on it.
+void DetectionWindow::collectReadbacks(bool wait) {
+    while (mReadbackCount > 0) {
+        Readback& rb = mReadbacks[mReadbackHead];
+        GLenum status = gltClientWaitSync(rb.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                          wait ? 1000000000 : 0);
+        if (status == GL_TIMEOUT_EXPIRED && !wait)
+            break;
+        gltDeleteSync(rb.fence);
+        rb.fence = NULL;
+        mReadbackHead = (mReadbackHead + 1) % CAPTURE_BUFFERS;
+        mReadbackCount--;
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            mEncoder->countReadbackDrop();
+            continue;
+        }
 
-    for (auto& det: detections) {
-        //glUniform3f(mBBoxUniColor, det.color.x, det.color.y, det.color.z);
-        glUniform3fv(mBBoxUniColor, 1, glm::value_ptr(det.color));
-        // Create 2D bounding box
-        const GLfloat bboxVertices[] = {
-                        det.xmin, det.ymin,
-                        det.xmax, det.ymin,
-                        det.xmax, det.ymax,
-                        det.xmin, det.ymax };
+        cv::Mat pixels = mEncoder->acquire(rb.width, rb.height);
+        if (pixels.empty())
+            continue; // encoder queue full (counted there)
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        gltBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo.buf);
+        const void* src = gltMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rb.size, GL_MAP_READ_BIT);
+        if (src != NULL) {
+            memcpy(pixels.data, src, rb.size);
+            gltUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        gltBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        mEncoder->countCopy(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+        if (src != NULL)
+            mEncoder->submit(pixels, rb.path, rb.recorder, rb.timestamp);
+        else
+            mEncoder->submit(pixels, string());
+    }
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, mBBoxVertexBuffer);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(bboxVertices), bboxVertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_LINE_LOOP, 0, 4);
+#if WITH_CUDA
+int DetectionWindow::showImage(cv::cuda::GpuMat& img) {
+    // Vertex buffer and attribute layout are captured in mImageVAO (see initImageBuffers)
+    gltBindVertexArray(mImageVAO);
+    gltUseProgram(mImageShaderProgram);
+    gltUniform1i(mImageUniFormat, IMAGE_FORMAT_BGR); // program is shared with other windows
+
+    gltActiveTexture(GL_TEXTURE0);
+    // cv::ogl::Texture2D talks to GL directly; account for its upload and bind here. It keeps its
+    // storage while the size and type stay the same.
+    if (!gltIsNoop()) {
+        mGpuTex.copyFrom(img);
+        mGpuTex.bind();
     }
+    gltCountUpload(img.rows * img.cols * img.elemSize());
+    GLT_COUNT(textureBinds, 1);
+    buildPyramid(GL_TEXTURE_2D, img.cols, img.rows, mFbWidth, mFbHeight, img.rows * img.cols * img.elemSize());
+    endPyramidTiming();
+    gltDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    showGallery(img.cols, img.rows, IMAGE_FORMAT_BGR);
+    // copyFrom() changed bindings behind the cache's back
+    gltInvalidateState();
 
-    // Cleanup
-    unBindBuffers();
+    return GL_TRUE;
+}
+#endif
 
+int DetectionWindow::showImage(const cv::Mat& img) {
+    if (uploadImage(img) == GL_FALSE)
+        return GL_FALSE;
+    drawImage(img.cols, img.rows, img.total() * img.elemSize());
     return GL_TRUE;
 }
 
-// Render text
-int DetectionWindow::showText(void) {
-    for (auto& det: detections) {
-        string label = det.label; // TODO: add det.score
-        renderTextTrueType(label, det.xmin, det.ymin, 0.35f, det.color);
+// Draws the host image texture (see uploadImage)
+void DetectionWindow::drawImage(int width, int height, size_t bytes) {
+    gltBindVertexArray(mImageVAO);
+    gltUseProgram(mImageShaderProgram);
+    gltUniform1i(mImageUniFormat, IMAGE_FORMAT_BGR);
+
+    gltActiveTexture(GL_TEXTURE0);
+    gltBindTexture(GL_TEXTURE_2D, mImageTex.tex);
+    buildPyramid(GL_TEXTURE_2D, width, height, mFbWidth, mFbHeight, bytes);
+    endPyramidTiming();
+    gltDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    showGallery(width, height, IMAGE_FORMAT_BGR);
+}
+
+// Uploads straight from the Mat's rows: the step becomes the unpack row length/alignment, so ROIs
+// and padded rows need no intermediate copy. Only a step that is not a whole number of pixels
+// (and not an alignment padding either) is repacked first.
+int DetectionWindow::uploadImage(const cv::Mat& img) {
+    int channels = img.channels();
+    if (img.depth() != CV_8U || (channels != 1 && channels != 3 && channels != 4)) {
+        printf("display: expected an 8-bit gray, BGR or BGRA image\n");
+        return GL_FALSE;
+    }
+    GLenum format = (channels == 1) ? GL_RED : (channels == 3) ? GL_BGR : GL_BGRA;
+    GLint internal = (channels == 1) ? GL_R8 : (channels == 3) ? GL_RGB8 : GL_RGBA8;
+
+    // A source switching between sizes gets its earlier textures back from the pool
+    if (mImageTex.tex == 0 || img.cols != mImageTex.width || img.rows != mImageTex.height ||
+        internal != mImageTex.format) {
+        GLObjectPool& pool = mContext->pool();
+        pool.release(mImageTex);
+        mImageTex = pool.acquireTexture(internal, img.cols, img.rows);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Gray shows as gray, not red
+        GLint gray = (channels == 1);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, gray ? GL_RED : GL_GREEN);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, gray ? GL_RED : GL_BLUE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, (channels == 4) ? GL_ALPHA : GL_ONE);
     }
 
-    // Cleanup
-    unBindBuffers();
+    gltBindTexture(GL_TEXTURE_2D, mImageTex.tex);
+    if (gltUnpackRows(img.step, img.cols, channels)) {
+        gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img.cols, img.rows, format, GL_UNSIGNED_BYTE, img.data);
+    } else {
+        cv::Mat packed = img.clone();
+        gltUnpackRows(packed.step, packed.cols, channels);
+        gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, packed.cols, packed.rows, format, GL_UNSIGNED_BYTE, packed.data);
+    }
+    gltUnpackDefaults();
 
     return GL_TRUE;
 }
 
-
-GLuint DetectionWindow::createVertexBuffer(const void *vertex_buffer, GLuint vbsize, bool dstatic) {
-    GLuint vbo = 0;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    if (dstatic)
-        glBufferData(GL_ARRAY_BUFFER, vbsize, vertex_buffer, GL_STATIC_DRAW);
-    else
-        glBufferData(GL_ARRAY_BUFFER, vbsize, vertex_buffer, GL_DYNAMIC_DRAW);
-    return vbo;
+void DetectionWindow::setColorSpace(int matrix, bool fullRange) {
+    mColorMatrix = matrix;
+    mColorFullRange = fullRange;
 }
 
-GLuint DetectionWindow::createVertexArray() {
-    GLuint VAID = 0;
-    glGenVertexArrays(1, &VAID);
-    glBindVertexArray(VAID);
-    return VAID;
-}
+#if WITH_CUDA
+int DetectionWindow::displayYUV(cv::cuda::GpuMat& frame, int format) {
+    makeCurrent();
+    if (frame.type() != CV_8UC1 || checkYUVFrame(frame.rows, frame.cols, format) == GL_FALSE)
+        return GL_FALSE;
+    // Device to device copy into the unpack buffer; the planes are then read from it by offset
+    if (!gltIsNoop()) {
+        mYUVPBO.copyFrom(frame, cv::ogl::Buffer::PIXEL_UNPACK_BUFFER);
+        mYUVPBO.bind(cv::ogl::Buffer::PIXEL_UNPACK_BUFFER);
+    }
+    uploadYUV(NULL, frame.cols); // the copy is tightly packed
+    if (!gltIsNoop())
+        cv::ogl::Buffer::unbind(cv::ogl::Buffer::PIXEL_UNPACK_BUFFER);
 
-void DetectionWindow::cleanup(void) {
+    beginFrame();
 #if SHOW_IMAGE
-    // Image
-    glDeleteVertexArrays(1, &mImageVAO);
-    glDeleteBuffers(1, &mImageVertexBuffer);
-    glDeleteTextures(1, &mImageTexID);
-    glDeleteProgram(mImageShaderProgram);
+    showYUV();
+#endif
+    return finishFrame();
+}
 #endif
 
-#if SHOW_BBOX
-    // BBox
-    glDeleteVertexArrays(1, &mBBoxVAO);
-    glDeleteBuffers(1, &mBBoxVertexBuffer);
-    glDeleteProgram(mBBoxShaderProgram);
+int DetectionWindow::displayYUV(const cv::Mat& frame, int format) {
+    makeCurrent();
+    if (frame.type() != CV_8UC1 || checkYUVFrame(frame.rows, frame.cols, format) == GL_FALSE)
+        return GL_FALSE;
+    if (uploadYUV(frame.data, frame.step) == GL_FALSE) {
+        cv::Mat packed = frame.clone();
+        uploadYUV(packed.data, packed.step);
+    }
+
+    beginFrame();
+#if SHOW_IMAGE
+    showYUV();
 #endif
+    return finishFrame();
+}
 
-#if SHOW_TEXT
-    // Text
-    glDeleteVertexArrays(1, &mTextVAO);
-    glDeleteBuffers(1, &mTextVertexBuffer);
-    glDeleteBuffers(1, &mTextUVBuffer);
-    glDeleteTextures(1, &mTextTextID);
-    glDeleteProgram(mTextShaderProgram);
+// The upload comes first, so the slot is only in use while the driver copies the pixels out of
+// it, not for the whole (vsync bound) frame. A frame whose slot the producer got to meanwhile is
+// still shown (it may be torn) and counted as an overrun.
+int DetectionWindow::displayShm(ShmRingReader& ring) {
+    if (!ring.acquire(mShmFrame))
+        return GL_FALSE;
+    makeCurrent();
+    cv::Mat frame = mShmFrame.mat(); // a header over the shared pages
+    bool yuv = (mShmFrame.format == SHM_FORMAT_NV12 || mShmFrame.format == SHM_FORMAT_I420);
+    int ret;
+    if (yuv) {
+        ret = checkYUVFrame(frame.rows, frame.cols,
+                            (mShmFrame.format == SHM_FORMAT_NV12) ? IMAGE_FORMAT_NV12 : IMAGE_FORMAT_I420);
+        if (ret != GL_FALSE)
+            ret = uploadYUV(frame.data, frame.step);
+    } else {
+        ret = uploadImage(frame);
+    }
+    ring.release(mShmFrame);
+    if (ret == GL_FALSE)
+        return GL_FALSE;
+
+    // The boxes belong to the pixels they came with: shown as they are, tracked or not, rather than
+    // through the track interpolator, which would draw them its delay behind the frame
+    detections.insert(detections.end(), mShmFrame.dets.begin(), mShmFrame.dets.end());
+    beginFrame();
+#if SHOW_IMAGE
+    if (yuv)
+        showYUV();
+    else
+        drawImage(frame.cols, frame.rows, frame.total() * frame.elemSize());
 #endif
+    return finishFrame();
+}
 
-    glfwDestroyWindow(mWindow);
-    glfwTerminate();
+// Validates a width x height*3/2 frame and (re)allocates the plane textures when its size or
+// format changes
+int DetectionWindow::checkYUVFrame(int rows, int cols, int format) {
+    if ((format != IMAGE_FORMAT_NV12 && format != IMAGE_FORMAT_I420) ||
+        (rows % 3) != 0 || (cols % 2) != 0) {
+        printf("displayYUV: expected an 8-bit NV12/I420 frame of even width x height*3/2 rows\n");
+        return GL_FALSE;
+    }
+    GLint width = cols;
+    GLint height = rows * 2 / 3;
+    if (width == mYUVWidth && height == mYUVHeight && format == mYUVFormat)
+        return GL_TRUE;
+
+    GLObjectPool& pool = mContext->pool();
+    for (int p = 0; p < 3; p++)
+        pool.release(mYUVTex[p]);
+    int planes = (format == IMAGE_FORMAT_NV12) ? 2 : 3;
+    for (int p = 0; p < planes; p++) {
+        bool uv = (p == 1 && format == IMAGE_FORMAT_NV12);
+        mYUVTex[p] = pool.acquireTexture(uv ? GL_RG8 : GL_R8, p ? width / 2 : width, p ? height / 2 : height);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    mYUVFormat = format;
+    mYUVWidth = width;
+    mYUVHeight = height;
+    printf("YUV input: %s %dx%d\n", (format == IMAGE_FORMAT_NV12) ? "NV12" : "I420", width, height);
+    return checkError();
 }
 
-int DetectionWindow::createImageShaders(GLuint* shader_program_id) {
-    const GLchar* vs_source = R"(#version 330
+// Uploads the planes of a frame with Y rows 'step' bytes apart. NV12 chroma rows share the step;
+// I420 chroma rows are step/2 apart. 'planes' is a host pointer, or NULL for a frame in the bound
+// pixel unpack buffer (the plane pointers are then offsets into it).
+// Returns GL_FALSE, uploading nothing, if the step cannot be expressed as an unpack layout.
+int DetectionWindow::uploadYUV(const GLubyte* planes, size_t step) {
+    GLint w = mYUVWidth;
+    GLint h = mYUVHeight;
+    size_t ySize = step * h;
+    size_t cStep = (mYUVFormat == IMAGE_FORMAT_NV12) ? step : step / 2;
+    GLsizei cBytes = (mYUVFormat == IMAGE_FORMAT_NV12) ? 2 : 1; // UV pairs or single U/V samples
+    if ((mYUVFormat == IMAGE_FORMAT_I420 && (step % 2) != 0) || !gltUnpackRows(cStep, w / 2, cBytes)) {
+        gltUnpackDefaults();
+        return GL_FALSE;
+    }
 
-layout(location = 0) in vec4 vertex;
+    if (mYUVFormat == IMAGE_FORMAT_NV12) {
+        gltBindTexture(GL_TEXTURE_2D, mYUVTex[1].tex);
+        gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w / 2, h / 2, GL_RG, GL_UNSIGNED_BYTE, planes + ySize);
+    } else {
+        gltBindTexture(GL_TEXTURE_2D, mYUVTex[1].tex);
+        gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w / 2, h / 2, GL_RED, GL_UNSIGNED_BYTE, planes + ySize);
+        gltBindTexture(GL_TEXTURE_2D, mYUVTex[2].tex);
+        gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w / 2, h / 2, GL_RED, GL_UNSIGNED_BYTE, planes + ySize + cStep * h / 2);
+    }
+    // A Y row length is always expressible (1 byte pixels)
+    gltUnpackRows(step, w, 1);
+    gltBindTexture(GL_TEXTURE_2D, mYUVTex[0].tex);
+    gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RED, GL_UNSIGNED_BYTE, planes);
+    gltUnpackDefaults();
+    return GL_TRUE;
+}
 
-out vec2 texUV;
+// YUV to RGB for the selected matrix and range: rgb = m * (yuv - offset), with m column major
+static void yuvToRgb(int matrix, bool fullRange, GLfloat m[9], GLfloat offset[3]) {
+    GLfloat kr = (matrix == COLOR_MATRIX_BT709) ? 0.2126f : 0.299f;
+    GLfloat kb = (matrix == COLOR_MATRIX_BT709) ? 0.0722f : 0.114f;
+    GLfloat kg = 1.0f - kr - kb;
+    // Limited range: Y in 16..235, chroma in 16..240 (of 255)
+    GLfloat sy = fullRange ? 1.0f : 255.0f / 219.0f;
+    GLfloat sc = fullRange ? 1.0f : 255.0f / 224.0f;
+
+    offset[0] = fullRange ? 0.0f : 16.0f / 255.0f;
+    offset[1] = 128.0f / 255.0f;
+    offset[2] = 128.0f / 255.0f;
+    // Y column
+    m[0] = sy; m[1] = sy; m[2] = sy;
+    // U (Cb) column
+    m[3] = 0.0f; m[4] = -sc * 2.0f * kb * (1.0f - kb) / kg; m[5] = sc * 2.0f * (1.0f - kb);
+    // V (Cr) column
+    m[6] = sc * 2.0f * (1.0f - kr); m[7] = -sc * 2.0f * kr * (1.0f - kr) / kg; m[8] = 0.0f;
+}
 
-void main() {
-  gl_Position = vec4(vertex.xy, 0.0f, 1.0f);
-  texUV = vertex.zw;
+// Format uniforms of a program using the image fragment shader (the program must be in use)
+void DetectionWindow::setImageFormat(GLint uniFormat, GLint uniMatrix, GLint uniOffset, GLint format) {
+    gltUniform1i(uniFormat, format);
+    if (format == IMAGE_FORMAT_BGR)
+        return;
+    GLfloat m[9], offset[3];
+    yuvToRgb(mColorMatrix, mColorFullRange, m, offset);
+    gltUniformMatrix3fv(uniMatrix, 1, GL_FALSE, m);
+    gltUniform3fv(uniOffset, 1, offset);
 }
-)";
-    const GLchar* fs_source = R"(#version 440
 
-out vec4 frag_color;
-in vec2 texUV;
+int DetectionWindow::showYUV(void) {
+    gltBindVertexArray(mImageVAO);
+    gltUseProgram(mImageShaderProgram);
+    setImageFormat(mImageUniFormat, mImageUniYUVMatrix, mImageUniYUVOffset, mYUVFormat);
+
+    int planes = (mYUVFormat == IMAGE_FORMAT_NV12) ? 2 : 3;
+    for (int p = 0; p < planes; p++) {
+        gltActiveTexture(GL_TEXTURE0 + p);
+        gltBindTexture(GL_TEXTURE_2D, mYUVTex[p].tex);
+        // Chroma planes are half size, and so is their on-screen footprint
+        GLint sw = p ? mYUVWidth / 2 : mYUVWidth;
+        GLint sh = p ? mYUVHeight / 2 : mYUVHeight;
+        GLint bytes = (p == 1 && mYUVFormat == IMAGE_FORMAT_NV12) ? 2 : 1;
+        buildPyramid(GL_TEXTURE_2D, sw, sh, p ? (mFbWidth + 1) / 2 : mFbWidth, p ? (mFbHeight + 1) / 2 : mFbHeight,
+                     (GLsizeiptr)sw * sh * bytes);
+    }
+    endPyramidTiming();
+    gltActiveTexture(GL_TEXTURE0);
+    gltDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    showGallery(mYUVWidth, mYUVHeight, mYUVFormat);
 
-uniform sampler2D texture;
-void main() {
-  frag_color = texture2D(texture, texUV);
+    return GL_TRUE;
 }
-)";
-    GLint compile_ok = GL_FALSE;
-
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vs_source, NULL);
-    glCompileShader(vs);
 
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &compile_ok);
-    if (compile_ok == GL_FALSE) {
-        glDeleteShader(vs);
-        return GL_FALSE;
+// Picks the smallest level that still covers the on-screen size (one level per halving) and, if
+// that is not level 0, (re)generates the mip chain down to it for the texture bound to 'target'
+// on the active unit. GL_TEXTURE_MAX_LEVEL stops generation and sampling at that level, so the
+// sampler reads it instead of the full resolution. 'bytes' is the size of level 0 (all layers).
+// 'builtLevel' is the deepest level still valid from an earlier build of an unchanged texture;
+// generation is skipped if that is deep enough. Returns the level.
+GLint DetectionWindow::buildPyramid(GLenum target, GLint srcWidth, GLint srcHeight, GLint dstWidth,
+                                    GLint dstHeight, GLsizeiptr bytes, GLint builtLevel) {
+    GLint level = 0;
+    if (mDownscale && dstWidth > 0 && dstHeight > 0)
+        while ((srcWidth >> (level + 1)) >= dstWidth && (srcHeight >> (level + 1)) >= dstHeight)
+            level++;
+
+    gltTexParameteri(target, GL_TEXTURE_MAX_LEVEL, level);
+    gltTexParameteri(target, GL_TEXTURE_MIN_FILTER, level ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    mDownscaleStats.level = level;
+    if (level == 0)
+        return 0;
+    mDownscaleStats.bytesSaved += bytes - (bytes >> (2 * level));
+    if (level <= builtLevel)
+        return level;
+
+    // One query spans all builds of a frame; skip timing while the previous result is in flight
+    if (mDownscaleQuery == 0)
+        gltGenQueries(1, &mDownscaleQuery);
+    if (mDownscalePending) {
+        GLint available = 0;
+        gltGetQueryObjectiv(mDownscaleQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 ns = 0;
+            gltGetQueryObjectui64v(mDownscaleQuery, GL_QUERY_RESULT, &ns);
+            mDownscaleStats.gpuNs += ns;
+            mDownscaleStats.timed++;
+            mDownscalePending = false;
+        }
     }
+    if (!mDownscalePending && !mDownscaleTiming) {
+        gltBeginQuery(GL_TIME_ELAPSED, mDownscaleQuery);
+        mDownscaleTiming = true;
+    }
+    gltGenerateMipmap(target);
 
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fs_source, NULL);
-    glCompileShader(fs);
+    for (GLint l = 1; l <= level; l++) // level l-1 read, level l written
+        mDownscaleStats.bytesBuilt += (bytes >> (2 * (l - 1))) + (bytes >> (2 * l));
+    mDownscaleStats.builds++;
+    return level;
+}
 
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &compile_ok);
-    if (compile_ok == GL_FALSE) {
-        glDeleteShader(fs);
+void DetectionWindow::endPyramidTiming(void) {
+    if (!mDownscaleTiming)
+        return;
+    gltEndQuery(GL_TIME_ELAPSED);
+    mDownscaleTiming = false;
+    mDownscalePending = true;
+}
+
+int DetectionWindow::setGallery(int thumbs, float size) {
+    if (thumbs < 0 || thumbs > MAX_GALLERY_THUMBS) {
+        printf("Gallery supports 0..%d thumbnails\n", MAX_GALLERY_THUMBS);
         return GL_FALSE;
     }
+    if (thumbs > 0 && mGalleryShaderProgram == 0) {
+        makeCurrent();
+        mGalleryShaderProgram = mContext->galleryProgram();
+        if (mGalleryShaderProgram == 0)
+            return GL_FALSE;
+        mGalleryUniCells = gltGetUniformLocation(mGalleryShaderProgram, "cells");
+        mGalleryUniCrops = gltGetUniformLocation(mGalleryShaderProgram, "crops");
+        mGalleryUniFormat = gltGetUniformLocation(mGalleryShaderProgram, "format");
+        mGalleryUniYUVMatrix = gltGetUniformLocation(mGalleryShaderProgram, "yuvMatrix");
+        mGalleryUniYUVOffset = gltGetUniformLocation(mGalleryShaderProgram, "yuvOffset");
+    }
+    mGalleryThumbs = thumbs;
+    mGallerySize = size;
+    return GL_TRUE;
+}
+
+// Draws the thumbnails from the frame texture(s) the image pass left bound (units 0..2), so no
+// pixel is uploaded twice. Called right after the image draw, before the overlays.
+int DetectionWindow::showGallery(GLint srcWidth, GLint srcHeight, GLint format) {
+    if (mGalleryThumbs == 0 || detections.empty() || mMosaicStreams > 0)
+        return GL_TRUE;
+
+    // Highest scores first
+    vector<int> order(detections.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (int)i;
+    int count = min((int)order.size(), (int)mGalleryThumbs);
+    partial_sort(order.begin(), order.begin() + count, order.end(),
+                 [this](int a, int b) { return detections[a].score > detections[b].score; });
+
+    // Stack from the top right corner, as many as fit
+    GLfloat side = mGallerySize * mFbHeight; // pixels
+    GLfloat gap = 4.0f;
+    GLfloat cells[MAX_GALLERY_THUMBS][4]; // [0..1] window coords, y down
+    GLfloat crops[MAX_GALLERY_THUMBS][4];
+    GLfloat ndc[MAX_GALLERY_THUMBS][4];
+    GLfloat y = gap;
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const Detection& det = detections[order[i]];
+        // Crop with a 10% margin around the box, clamped to the frame
+        GLfloat mx = 0.1f * (det.xmax - det.xmin), my = 0.1f * (det.ymax - det.ymin);
+        GLfloat u0 = max(0.0f, det.xmin - mx), u1 = min(1.0f, det.xmax + mx);
+        GLfloat v0 = max(0.0f, det.ymin - my), v1 = min(1.0f, det.ymax + my);
+        GLfloat cw = (u1 - u0) * srcWidth, ch = (v1 - v0) * srcHeight;
+        if (cw <= 0.0f || ch <= 0.0f)
+            continue;
+        GLfloat tw = (cw >= ch) ? side : side * cw / ch;
+        GLfloat th = (cw >= ch) ? side * ch / cw : side;
+        if (y + th > mFbHeight)
+            break;
+        GLfloat x = mFbWidth - gap - tw;
+        cells[n][0] = x / mFbWidth;        cells[n][1] = y / mFbHeight;
+        cells[n][2] = (x + tw) / mFbWidth; cells[n][3] = (y + th) / mFbHeight;
+        ndc[n][0] = cells[n][0] * 2.0f - 1.0f; ndc[n][1] = 1.0f - cells[n][3] * 2.0f;
+        ndc[n][2] = cells[n][2] * 2.0f - 1.0f; ndc[n][3] = 1.0f - cells[n][1] * 2.0f;
+        crops[n][0] = u0; crops[n][1] = v0; crops[n][2] = u1; crops[n][3] = v1;
+        order[n] = order[i];
+        y += th + gap;
+        n++;
+    }
+    if (n == 0)
+        return GL_TRUE;
 
-    *shader_program_id = glCreateProgram();
-    glAttachShader(*shader_program_id, fs);
-    glAttachShader(*shader_program_id, vs);
-    glLinkProgram(*shader_program_id);
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    gltBindVertexArray(mImageVAO);
+    gltUseProgram(mGalleryShaderProgram);
+    setImageFormat(mGalleryUniFormat, mGalleryUniYUVMatrix, mGalleryUniYUVOffset, format);
+    gltUniform4fv(mGalleryUniCells, n, &ndc[0][0]);
+    gltUniform4fv(mGalleryUniCrops, n, &crops[0][0]);
+    gltDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
 
+#if SHOW_BBOX
+    // Frame each thumbnail in its detection's color
+    gltBindVertexArray(mBBoxVAO);
+    gltUseProgram(mBBoxShaderProgram);
+    gltBindBuffer(GL_ARRAY_BUFFER, mBBoxVertexBuffer);
+    for (int i = 0; i < n; i++) {
+        const GLfloat* c = cells[i];
+        const GLfloat frameVertices[] = { c[0], c[1], c[2], c[1], c[2], c[3], c[0], c[3] };
+        gltUniform3fv(mBBoxUniColor, 1, glm::value_ptr(detections[order[i]].color));
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(frameVertices), frameVertices);
+        gltDrawArrays(GL_LINE_LOOP, 0, 4);
+    }
+#endif
     return GL_TRUE;
 }
 
-int DetectionWindow::createBBoxShaders(GLuint* shader_program_id) {
-    // This shader takes xmin,ymin,xmax,ymax format box input, and converts into OpenGL convention
-    const GLchar* vs_source = R"(#version 330 core
+int DetectionWindow::setHeatmap(int width, int height, double halfLife, float fullScale, float opacity) {
+    if (mContext == NULL) {
+        printf("Window is not created yet!\n");
+        return GL_FALSE;
+    }
+    makeCurrent();
+    if (width <= 0 || height <= 0) {
+        deleteHeatmap();
+        return GL_TRUE;
+    }
+    mHeatHalfLife = (halfLife > 0.0) ? halfLife : 600.0;
+    mHeatFullScale = (fullScale > 0.0f) ? fullScale : 60.0f;
+    mHeatOpacity = opacity;
+    if (width == mHeatWidth && height == mHeatHeight)
+        return GL_TRUE;
+    deleteHeatmap();
+
+    mHeatSplatProgram = mContext->heatSplatProgram();
+    mHeatProgram = mContext->heatmapProgram();
+    if (mHeatSplatProgram == 0 || mHeatProgram == 0)
+        return GL_FALSE;
+    mHeatUniDecayPass = gltGetUniformLocation(mHeatSplatProgram, "decayPass");
+    mHeatUniWeight = gltGetUniformLocation(mHeatSplatProgram, "weight");
+    mHeatUniScale = gltGetUniformLocation(mHeatProgram, "scale");
+    mHeatUniOpacity = gltGetUniformLocation(mHeatProgram, "opacity");
+
+    gltActiveTexture(GL_TEXTURE0);
+    mHeatTex = mContext->pool().acquireTexture(GL_R32F, width, height);
+    gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    mHeatFBO = GLFramebuffer::create();
+    gltBindFramebuffer(GL_FRAMEBUFFER, mHeatFBO);
+    gltFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mHeatTex.tex, 0);
+    GLenum status = gltCheckFramebufferStatus(GL_FRAMEBUFFER);
+    gltBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Heatmap render target is not supported (status 0x%x)\n", status);
+        deleteHeatmap();
+        return GL_FALSE;
+    }
+    mHeatWidth = width;
+    mHeatHeight = height;
+    clearHeatmap();
+
+    const GLfloat quad[] = { 0, 0,  1, 0,  0, 1,  1, 1 };
+    mHeatVAO = createVertexArray();
+    mHeatQuadBuffer = createVertexBuffer(quad, sizeof(quad));
+    gltBindBuffer(GL_ARRAY_BUFFER, mHeatQuadBuffer);
+    gltEnableVertexAttribArray(0);
+    gltVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    mHeatBoxBuffer = GLBuffer::create();
+    gltBindBuffer(GL_ARRAY_BUFFER, mHeatBoxBuffer);
+    mHeatBoxBufferSize = 64 * sizeof(glm::vec4);
+    gltBufferData(GL_ARRAY_BUFFER, mHeatBoxBufferSize, NULL, GL_STREAM_DRAW);
+    gltEnableVertexAttribArray(1);
+    gltVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+    gltVertexAttribDivisor(1, 1);
+    unBindBuffers();
+    return checkError();
+}
 
-layout(location = 0) in vec3 vertexPosition;
+void DetectionWindow::clearHeatmap(void) {
+    if (mHeatFBO == 0)
+        return;
+    makeCurrent();
+    const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    gltBindFramebuffer(GL_FRAMEBUFFER, mHeatFBO);
+    gltClearBufferfv(GL_COLOR, 0, zero);
+    gltBindFramebuffer(GL_FRAMEBUFFER, 0);
+    mHeatLastTime = -1.0;
+}
 
-void main() {
-  vec3 position;
-  position = vertexPosition * 2 - 1.0f;
-  position.y *= -1.0f;
-  gl_Position = vec4(position, 1.0f);
+void DetectionWindow::deleteHeatmap(void) {
+    mHeatFBO.reset();
+    if (mContext != NULL)
+        mContext->pool().release(mHeatTex);
+    mHeatVAO.reset();
+    mHeatQuadBuffer.reset();
+    mHeatBoxBuffer.reset();
+    mHeatBoxBufferSize = 0;
+    mHeatWidth = mHeatHeight = 0;
 }
-)";
 
-    const GLchar* fs_source = R"(#version 440 core
+// Decays and splats the frame's boxes into the heat target (one target bind, two draws, both
+// done by blending: dst * decay, then dst + splat), then draws it through the colormap
+int DetectionWindow::showHeatmap(void) {
+    if (mHeatWidth == 0)
+        return GL_TRUE;
+    double now = displayTime();
+    GLfloat dt = (mHeatLastTime >= 0.0) ? (GLfloat)min(max(now - mHeatLastTime, 0.0), 0.5) : 0.0f;
+    mHeatLastTime = now;
+
+    mHeatBoxes.clear();
+    for (auto& det: detections)
+        mHeatBoxes.push_back(glm::vec4(det.xmin, det.ymin, det.xmax, det.ymax));
+
+    gltBindFramebuffer(GL_FRAMEBUFFER, mHeatFBO);
+    gltViewport(0, 0, mHeatWidth, mHeatHeight);
+    gltUseProgram(mHeatSplatProgram);
+    gltBindVertexArray(mHeatVAO);
+    gltBlendFunc(GL_ZERO, GL_CONSTANT_ALPHA);
+    gltBlendColor(0.0f, 0.0f, 0.0f, (GLfloat)pow(0.5, dt / mHeatHalfLife));
+    gltUniform1i(mHeatUniDecayPass, 1);
+    gltUniform1f(mHeatUniWeight, 0.0f);
+    gltDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
+    if (!mHeatBoxes.empty() && dt > 0.0f) {
+        GLsizeiptr bytes = mHeatBoxes.size() * sizeof(glm::vec4);
+        gltBindBuffer(GL_ARRAY_BUFFER, mHeatBoxBuffer);
+        if (bytes > mHeatBoxBufferSize) {
+            mHeatBoxBufferSize = bytes * 2;
+            gltBufferData(GL_ARRAY_BUFFER, mHeatBoxBufferSize, NULL, GL_STREAM_DRAW);
+        }
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &mHeatBoxes[0]);
+        gltBlendFunc(GL_ONE, GL_ONE);
+        gltUniform1i(mHeatUniDecayPass, 0);
+        gltUniform1f(mHeatUniWeight, dt);
+        gltDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)mHeatBoxes.size());
+    }
+    gltBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gltViewport(0, 0, mFbWidth, mFbHeight);
+    gltBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    gltUseProgram(mHeatProgram);
+    gltUniform1f(mHeatUniScale, 1.0f / mHeatFullScale);
+    gltUniform1f(mHeatUniOpacity, mHeatOpacity);
+    gltActiveTexture(GL_TEXTURE0);
+    gltBindTexture(GL_TEXTURE_2D, mHeatTex.tex);
+    gltDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    return GL_TRUE;
+}
 
-out vec4 frag_color;
+// Renders the layer into the overlay texture: image textures (again) if the layer changed, the
+// texture if the window size changed, then the triangles in order, one draw per batch
+int DetectionWindow::bakeOverlay(void) {
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    if (mOverlayProgram == 0) {
+        mOverlayProgram = mContext->overlayProgram();
+        if (mOverlayProgram == 0)
+            return GL_FALSE;
+        mOverlayUniTextured = gltGetUniformLocation(mOverlayProgram, "textured");
+        mOverlayVAO = createVertexArray();
+        mOverlayBuffer = GLBuffer::create();
+        gltBindBuffer(GL_ARRAY_BUFFER, mOverlayBuffer);
+        gltEnableVertexAttribArray(0);
+        gltVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, pos));
+        gltEnableVertexAttribArray(1);
+        gltVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, uv));
+        gltEnableVertexAttribArray(2);
+        gltVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, color));
+        mOverlayFBO = GLFramebuffer::create();
+    }
+    // Edits and resizes hand their old textures back to the pool; a logo keeping its size reuses
+    // its texture across edits
+    GLObjectPool& pool = mContext->pool();
+    gltActiveTexture(GL_TEXTURE0);
+    if (mOverlayImagesVersion != mOverlay.version()) {
+        for (size_t i = 0; i < mOverlayImageTex.size(); i++)
+            pool.release(mOverlayImageTex[i]);
+        const vector<OverlayImage>& images = mOverlay.images();
+        mOverlayImageTex.resize(images.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            const cv::Mat& bgra = images[i].bgra;
+            mOverlayImageTex[i] = pool.acquireTexture(GL_RGBA8, bgra.cols, bgra.rows);
+            gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            gltTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, bgra.cols, bgra.rows, GL_BGRA, GL_UNSIGNED_BYTE, bgra.data);
+        }
+        mOverlayImagesVersion = mOverlay.version();
+    }
+    if (mOverlayWidth != mFbWidth || mOverlayHeight != mFbHeight) {
+        pool.release(mOverlayTex);
+        mOverlayTex = pool.acquireTexture(GL_RGBA8, mFbWidth, mFbHeight);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gltBindFramebuffer(GL_FRAMEBUFFER, mOverlayFBO);
+        gltFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mOverlayTex.tex, 0);
+        GLenum status = gltCheckFramebufferStatus(GL_FRAMEBUFFER);
+        gltBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Overlay render target is not supported (status 0x%x)\n", status);
+            return GL_FALSE;
+        }
+        mOverlayWidth = mFbWidth;
+        mOverlayHeight = mFbHeight;
+    }
+
+    // The composite quad first (texture v runs up), then the layer
+    mOverlay.build(mFbWidth, mFbHeight, mOverlayVertices, mOverlayBatches);
+    const glm::vec4 white(1.0f);
+    const OverlayVertex quad[6] = {
+        { glm::vec2(0, 0), glm::vec2(0, 1), white }, { glm::vec2(1, 0), glm::vec2(1, 1), white },
+        { glm::vec2(0, 1), glm::vec2(0, 0), white }, { glm::vec2(0, 1), glm::vec2(0, 0), white },
+        { glm::vec2(1, 0), glm::vec2(1, 1), white }, { glm::vec2(1, 1), glm::vec2(1, 0), white } };
+    mOverlayVertices.insert(mOverlayVertices.begin(), quad, quad + 6);
+    GLsizeiptr bytes = mOverlayVertices.size() * sizeof(OverlayVertex);
+    gltBindBuffer(GL_ARRAY_BUFFER, mOverlayBuffer);
+    if (bytes > mOverlayBufferSize) {
+        mOverlayBufferSize = bytes;
+        gltBufferData(GL_ARRAY_BUFFER, bytes, &mOverlayVertices[0], GL_STATIC_DRAW);
+    } else {
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &mOverlayVertices[0]);
+    }
 
-uniform vec3 BBCOLOR;
-void main() {
-  frag_color = vec4(BBCOLOR, 0.8f);
+    // Premultiplied alpha in the texture, so it composites with one blend
+    const GLfloat clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    gltBindFramebuffer(GL_FRAMEBUFFER, mOverlayFBO);
+    gltViewport(0, 0, mFbWidth, mFbHeight);
+    gltClearBufferfv(GL_COLOR, 0, clear);
+    gltBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    gltUseProgram(mOverlayProgram);
+    gltBindVertexArray(mOverlayVAO);
+    for (size_t i = 0; i < mOverlayBatches.size(); i++) {
+        const OverlayBatch& b = mOverlayBatches[i];
+        gltUniform1i(mOverlayUniTextured, b.image >= 0);
+        if (b.image >= 0)
+            gltBindTexture(GL_TEXTURE_2D, mOverlayImageTex[b.image].tex);
+        gltDrawArrays(GL_TRIANGLES, 6 + b.first, b.count);
+    }
+    gltBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gltBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    mOverlayVersion = mOverlay.version();
+    mOverlayStats.bakes++;
+    mOverlayStats.triangles = (mOverlayVertices.size() - 6) / 3;
+    mOverlayStats.lastBakeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    return GL_TRUE;
 }
-)";
 
-    GLint compile_ok = GL_FALSE;
+int DetectionWindow::showOverlay(void) {
+    // Nothing to bake into while minimized (0x0 framebuffer); after a failed bake the layer is left
+    // as it is, only not shown
+    if (mOverlay.empty() || mOverlayFailed || mFbWidth <= 0 || mFbHeight <= 0)
+        return GL_TRUE;
+    if ((mOverlayVersion != mOverlay.version() || mOverlayWidth != mFbWidth || mOverlayHeight != mFbHeight) &&
+        bakeOverlay() == GL_FALSE) {
+        mOverlayFailed = true; // do not retry every frame
+        return GL_FALSE;
+    }
+    gltBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    gltUseProgram(mOverlayProgram);
+    gltBindVertexArray(mOverlayVAO);
+    gltUniform1i(mOverlayUniTextured, 1);
+    gltActiveTexture(GL_TEXTURE0);
+    gltBindTexture(GL_TEXTURE_2D, mOverlayTex.tex);
+    gltDrawArrays(GL_TRIANGLES, 0, 6);
+    gltBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    mOverlayStats.composites++;
+    return GL_TRUE;
+}
 
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vs_source, NULL);
-    glCompileShader(vs);
+void DetectionWindow::deleteOverlay(void) {
+    if (mContext != NULL) {
+        for (size_t i = 0; i < mOverlayImageTex.size(); i++)
+            mContext->pool().release(mOverlayImageTex[i]);
+        mContext->pool().release(mOverlayTex);
+    }
+    mOverlayImageTex.clear();
+    mOverlayFBO.reset();
+    mOverlayVAO.reset();
+    mOverlayBuffer.reset();
+    mOverlayProgram = 0;
+    mOverlayBufferSize = 0;
+    mOverlayVersion = mOverlayImagesVersion = 0;
+    mOverlayWidth = mOverlayHeight = 0;
+    mOverlayFailed = false;
+}
 
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &compile_ok);
-    if (compile_ok == GL_FALSE) {
-        glDeleteShader(vs);
+int DetectionWindow::setMosaic(int streams, int tileWidth, int tileHeight) {
+    if (streams <= 0 || streams > MAX_MOSAIC_STREAMS) {
+        printf("Mosaic supports 1..%d streams\n", MAX_MOSAIC_STREAMS);
         return GL_FALSE;
     }
+    makeCurrent();
+    mMosaicShaderProgram = mContext->mosaicProgram();
+    if (mMosaicShaderProgram == 0)
+        return GL_FALSE;
+    mMosaicUniGrid = gltGetUniformLocation(mMosaicShaderProgram, "grid");
+    mMosaicUniValid = gltGetUniformLocation(mMosaicShaderProgram, "validMask");
+
+    // Near-square grid, filled row by row
+    mMosaicStreams = streams;
+    mMosaicLevel = -1;
+    mMosaicCols = (GLint)ceil(sqrt((double)streams));
+    mMosaicRows = (streams + mMosaicCols - 1) / mMosaicCols;
+    mMosaicTileWidth = tileWidth;
+    mMosaicTileHeight = tileHeight;
+    mMosaicValidMask = 0;
+    mStreamTimestamps.assign(streams, 0.0);
+
+    mMosaicTexArray = GLTexture::create();
+    gltBindTexture(GL_TEXTURE_2D_ARRAY, mMosaicTexArray);
+    gltTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, tileWidth, tileHeight, streams, 0,
+                  GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    gltTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gltTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gltTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gltTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    printf("Mosaic: %d streams of %dx%d in a %dx%d grid\n", streams, tileWidth, tileHeight,
+           mMosaicCols, mMosaicRows);
 
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fs_source, NULL);
-    glCompileShader(fs);
+    return checkError();
+}
 
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &compile_ok);
-    if (compile_ok == GL_FALSE) {
-        glDeleteShader(fs);
+#if WITH_CUDA
+// Copies a device frame into the stream's layer through a pixel unpack buffer (no host round trip)
+int DetectionWindow::updateStream(int stream, cv::cuda::GpuMat& frame, double timestamp) {
+    if (stream < 0 || stream >= mMosaicStreams || frame.type() != CV_8UC3 ||
+        frame.cols != mMosaicTileWidth || frame.rows != mMosaicTileHeight) {
+        printf("updateStream: stream %d: expected a %dx%d BGR frame\n", stream, mMosaicTileWidth, mMosaicTileHeight);
         return GL_FALSE;
     }
+    makeCurrent();
+    gltBindTexture(GL_TEXTURE_2D_ARRAY, mMosaicTexArray);
+    if (!gltIsNoop()) {
+        mStreamPBO.copyFrom(frame, cv::ogl::Buffer::PIXEL_UNPACK_BUFFER);
+        mStreamPBO.bind(cv::ogl::Buffer::PIXEL_UNPACK_BUFFER);
+    }
+    gltUnpackRows(frame.cols * 3, frame.cols, 3); // PBO rows are tightly packed
+    gltTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, stream, frame.cols, frame.rows, 1,
+                     GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    gltUnpackDefaults();
+    if (!gltIsNoop())
+        cv::ogl::Buffer::unbind(cv::ogl::Buffer::PIXEL_UNPACK_BUFFER);
+
+    mStreamTimestamps[stream] = timestamp;
+    mMosaicValidMask |= (1u << stream);
+    mMosaicDirty = true;
+    return GL_TRUE;
+}
+#endif
 
-    *shader_program_id = glCreateProgram();
-    glAttachShader(*shader_program_id, fs);
-    glAttachShader(*shader_program_id, vs);
-    glLinkProgram(*shader_program_id);
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+int DetectionWindow::updateStream(int stream, const cv::Mat& frame, double timestamp) {
+    if (stream < 0 || stream >= mMosaicStreams || frame.type() != CV_8UC3 ||
+        frame.cols != mMosaicTileWidth || frame.rows != mMosaicTileHeight) {
+        printf("updateStream: stream %d: expected a %dx%d BGR frame\n", stream,
+               mMosaicTileWidth, mMosaicTileHeight);
+        return GL_FALSE;
+    }
+    makeCurrent();
+    gltBindTexture(GL_TEXTURE_2D_ARRAY, mMosaicTexArray);
+    // ROIs and padded rows are read in place (see uploadImage)
+    cv::Mat packed;
+    const cv::Mat* src = &frame;
+    if (!gltUnpackRows(frame.step, frame.cols, 3)) {
+        packed = frame.clone();
+        src = &packed;
+        gltUnpackRows(packed.step, packed.cols, 3);
+    }
+    gltTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, stream, src->cols, src->rows, 1,
+                     GL_BGR, GL_UNSIGNED_BYTE, src->data);
+    gltUnpackDefaults();
 
+    mStreamTimestamps[stream] = timestamp;
+    mMosaicValidMask |= (1u << stream);
+    mMosaicDirty = true;
     return GL_TRUE;
 }
 
-int DetectionWindow::createTextShaders(GLuint* shader_program_id) {
-    // Shaders for TrueType fonts rendering
-    const GLchar* vs_source = R"(#version 330 core
+double DetectionWindow::mosaicSkew(void) {
+    double tmin = 0.0, tmax = 0.0;
+    int valid = 0;
+    for (int i = 0; i < mMosaicStreams; i++) {
+        if ((mMosaicValidMask & (1u << i)) == 0)
+            continue;
+        double ts = mStreamTimestamps[i];
+        if (valid == 0 || ts < tmin) tmin = ts;
+        if (valid == 0 || ts > tmax) tmax = ts;
+        valid++;
+    }
+    return (valid > 1) ? (tmax - tmin) : 0.0;
+}
 
-layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
-out vec2 UV;
+void DetectionWindow::addDetection(int stream, Detection& det) {
+    if (stream < 0 || stream >= mMosaicStreams)
+        return;
+    // Map [0..1] frame coordinates into the stream's cell of the [0..1] window
+    GLfloat col = (GLfloat)(stream % mMosaicCols);
+    GLfloat row = (GLfloat)(stream / mMosaicCols);
+    Detection tile = det;
+    tile.xmin = (col + det.xmin) / mMosaicCols;
+    tile.xmax = (col + det.xmax) / mMosaicCols;
+    tile.ymin = (row + det.ymin) / mMosaicRows;
+    tile.ymax = (row + det.ymax) / mMosaicRows;
+    addStreamDetection(stream, tile);
+}
 
-uniform mat4 projection;
+// All tiles in one instanced draw of the image quad; the vertex shader places instance i in cell i
+int DetectionWindow::showMosaic(void) {
+    if (mMosaicStreams == 0)
+        return GL_FALSE;
+    gltBindVertexArray(mImageVAO);
+    gltUseProgram(mMosaicShaderProgram);
+    gltUniform2i(mMosaicUniGrid, mMosaicCols, mMosaicRows);
+    gltUniform1ui(mMosaicUniValid, mMosaicValidMask);
+
+    gltActiveTexture(GL_TEXTURE0);
+    gltBindTexture(GL_TEXTURE_2D_ARRAY, mMosaicTexArray);
+    // One pyramid for all layers; only rebuilt when a stream changed or the tiles got smaller
+    GLint built = mMosaicDirty ? -1 : mMosaicLevel;
+    GLint level = buildPyramid(GL_TEXTURE_2D_ARRAY, mMosaicTileWidth, mMosaicTileHeight,
+                               mFbWidth / mMosaicCols, mFbHeight / mMosaicRows,
+                               (GLsizeiptr)mMosaicTileWidth * mMosaicTileHeight * 3 * mMosaicStreams, built);
+    if (level > built)
+        mMosaicLevel = level;
+    mMosaicDirty = false;
+    endPyramidTiming();
+    gltDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, mMosaicStreams);
 
-void main() {
-    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    UV = vertex.zw;
+    return GL_TRUE;
 }
-)";
 
-    const GLchar* fs_source = R"(#version 440 core
+int DetectionWindow::showBBox(void) {
+    gltUseProgram(mBBoxShaderProgram);
+
+    if (!mTrails.empty()) {
+        // One upload for all trails; the buffer only grows
+        GLsizeiptr bytes = mTrailVertices.size() * sizeof(glm::vec2);
+        gltBindVertexArray(mTrailVAO);
+        gltBindBuffer(GL_ARRAY_BUFFER, mTrailVertexBuffer);
+        if (bytes > mTrailBufferSize) {
+            mTrailBufferSize = bytes * 2;
+            gltBufferData(GL_ARRAY_BUFFER, mTrailBufferSize, NULL, GL_DYNAMIC_DRAW);
+        }
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &mTrailVertices[0]);
+        for (size_t i = 0; i < mTrails.size(); i++) {
+            gltUniform3fv(mBBoxUniColor, 1, glm::value_ptr(mTrails[i].color));
+            gltDrawArrays(GL_LINE_STRIP, mTrails[i].first, mTrails[i].count);
+        }
+    }
 
-in vec2 UV;
-out vec4 color;
+    gltBindVertexArray(mBBoxVAO);
 
-uniform sampler2D texSampler;
-uniform vec3      textColor;
+    for (size_t i = 0; i < detections.size(); i++) {
+        if ((mLodFlags[i] & LOD_BOX) == 0)
+            continue;
+        const Detection& det = detections[i];
+        //gltUniform3f(mBBoxUniColor, det.color.x, det.color.y, det.color.z);
+        gltUniform3fv(mBBoxUniColor, 1, glm::value_ptr(det.color));
+        // Create 2D bounding box
+        const GLfloat bboxVertices[] = {
+                        det.xmin, det.ymin,
+                        det.xmax, det.ymin,
+                        det.xmax, det.ymax,
+                        det.xmin, det.ymax };
 
-void main()
-{    
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(texSampler, UV).r);
-    color = vec4(textColor, 0.8) * sampled;
+        gltBindBuffer(GL_ARRAY_BUFFER, mBBoxVertexBuffer);
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(bboxVertices), bboxVertices);
+        gltDrawArrays(GL_LINE_LOOP, 0, 4);
+    }
+
+    // Hovered box: one more outline 2 pixels out; selected box: two, 2 and 4 pixels out
+    for (int k = 0; k < 3; k++) {
+        int i = (k == 0) ? mHover : mSelect;
+        if (i < 0)
+            continue;
+        const Detection& det = detections[i];
+        GLfloat dx = 2.0f * (k == 2 ? 2 : 1) / mWidth;
+        GLfloat dy = 2.0f * (k == 2 ? 2 : 1) / mHeight;
+        glm::vec3 color = (k == 0) ? glm::mix(det.color, glm::vec3(1.0f), 0.5f) : glm::vec3(1.0f);
+        const GLfloat outline[] = {
+                        det.xmin - dx, det.ymin - dy,
+                        det.xmax + dx, det.ymin - dy,
+                        det.xmax + dx, det.ymax + dy,
+                        det.xmin - dx, det.ymax + dy };
+        gltUniform3fv(mBBoxUniColor, 1, glm::value_ptr(color));
+        gltBindBuffer(GL_ARRAY_BUFFER, mBBoxVertexBuffer);
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(outline), outline);
+        gltDrawArrays(GL_LINE_LOOP, 0, 4);
+    }
+
+    return GL_TRUE;
 }
-)";
 
-    GLint compile_ok = GL_FALSE;
+void DetectionWindow::setLod(int crowd, float minLabelSize, int clusterCell, int clusterMin, int maxLabels) {
+    mLodCrowd = crowd;
+    mLodMinLabel = minLabelSize;
+    mLodCell = clusterCell;
+    mLodClusterMin = clusterMin;
+    mLodMaxLabels = maxLabels;
+}
 
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vs_source, NULL);
-    glCompileShader(vs);
+// Decides per detection whether its box and label are drawn, and collects the count badges
+void DetectionWindow::applyLod(void) {
+    size_t n = detections.size();
+    mLodFlags.assign(n, LOD_BOX | LOD_LABEL);
+    mLodBadges.clear();
+    mLodStats.frames++;
+
+    if (mLodMinLabel > 0.0f) {
+        for (size_t i = 0; i < n; i++) {
+            const Detection& det = detections[i];
+            if ((det.xmax - det.xmin) * mWidth < mLodMinLabel || (det.ymax - det.ymin) * mHeight < mLodMinLabel) {
+                mLodFlags[i] &= ~LOD_LABEL;
+                mLodStats.labelsSmall++;
+            }
+        }
+    }
 
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &compile_ok);
-    if (compile_ok == GL_FALSE) {
-        glDeleteShader(vs);
-        return GL_FALSE;
+    // Box centers binned on the grid; full cells become badges
+    if (mLodCell > 0 && mLodClusterMin > 1 && mLodCrowd > 0 && (int)n >= mLodCrowd) {
+        mLodStats.crowdedFrames++;
+        int cols = max(1, (mWidth + mLodCell - 1) / mLodCell);
+        int rows = max(1, (mHeight + mLodCell - 1) / mLodCell);
+        mLodCellCount.assign(cols * rows, 0);
+        mLodCellBadge.assign(cols * rows, -1);
+        mLodCellOf.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            const Detection& det = detections[i];
+            int cx = min(max((int)(0.5f * (det.xmin + det.xmax) * mWidth) / mLodCell, 0), cols - 1);
+            int cy = min(max((int)(0.5f * (det.ymin + det.ymax) * mHeight) / mLodCell, 0), rows - 1);
+            mLodCellOf[i] = cy * cols + cx;
+            mLodCellCount[mLodCellOf[i]]++;
+        }
+        for (size_t i = 0; i < n; i++) {
+            int c = mLodCellOf[i];
+            if (mLodCellCount[c] < mLodClusterMin)
+                continue;
+            const Detection& det = detections[i];
+            mLodFlags[i] = 0;
+            mLodStats.boxesClustered++;
+            if (mLodCellBadge[c] < 0) {
+                LodBadge badge = { glm::vec2(0.0f), 0, det.color, det.score };
+                mLodCellBadge[c] = (int)mLodBadges.size();
+                mLodBadges.push_back(badge);
+            }
+            LodBadge& badge = mLodBadges[mLodCellBadge[c]];
+            badge.center += glm::vec2(0.5f * (det.xmin + det.xmax) * mWidth, 0.5f * (det.ymin + det.ymax) * mHeight);
+            badge.count++;
+            if (det.score > badge.score) {
+                badge.score = det.score;
+                badge.color = det.color;
+            }
+        }
+        for (auto& badge: mLodBadges)
+            badge.center /= (float)badge.count;
+        mLodStats.clusters += mLodBadges.size();
     }
 
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fs_source, NULL);
-    glCompileShader(fs);
+    // The best scoring labels only
+    if (mLodMaxLabels > 0) {
+        mLodOrder.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (mLodFlags[i] & LOD_LABEL)
+                mLodOrder.push_back(make_pair(-detections[i].score, (int)i));
+        }
+        if ((int)mLodOrder.size() > mLodMaxLabels) {
+            nth_element(mLodOrder.begin(), mLodOrder.begin() + mLodMaxLabels, mLodOrder.end());
+            for (size_t k = mLodMaxLabels; k < mLodOrder.size(); k++)
+                mLodFlags[mLodOrder[k].second] &= ~LOD_LABEL;
+            mLodStats.labelsCapped += mLodOrder.size() - mLodMaxLabels;
+        }
+    }
 
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &compile_ok);
-    if (compile_ok == GL_FALSE) {
-        glDeleteShader(fs);
-        return GL_FALSE;
+    for (size_t i = 0; i < n; i++) {
+        if (mLodFlags[i] & LOD_BOX)
+            mLodStats.boxesDrawn++;
+    }
+}
+
+// Indexes the boxes drawn this frame, if the cursor is in the window or something is selected,
+// and finds the hovered and selected ones again
+void DetectionWindow::updatePicking(void) {
+    mHover = mSelect = -1;
+    mPickBuilt = false;
+    if (!mCursorIn && !mSelecting) {
+        mPickIndex.clear();
+        return;
+    }
+    mPickIndex.build(detections, mLodFlags.empty() ? NULL : &mLodFlags[0], LOD_BOX);
+    mPickBuilt = true;
+    if (mCursorIn)
+        mHover = mPickIndex.pick(mCursor);
+    if (mSelecting && mSelectTrack > 0) {
+        for (size_t i = 0; i < detections.size(); i++) {
+            if (detections[i].track == mSelectTrack && (mLodFlags[i] & LOD_BOX)) {
+                mSelect = (int)i;
+                break;
+            }
+        }
+    } else if (mSelecting) {
+        mSelect = mPickIndex.pick(mSelectPoint);
+    }
+}
+
+void DetectionWindow::cursorMoved(double x, double y) {
+    int width = 0, height = 0;
+    if (mWindow != NULL)
+        glfwGetWindowSize(mWindow, &width, &height);
+    if (width <= 0 || height <= 0)
+        return;
+    mCursorIn = true;
+    mCursor = glm::vec2((float)(x / width), (float)(y / height));
+    if (!mPickBuilt) {
+        // The cursor just came in: index the frame on screen
+        mPickIndex.build(mPickDets, (!mLodFlags.empty() && mLodFlags.size() == mPickDets.size()) ? &mLodFlags[0] : NULL, LOD_BOX);
+        mPickBuilt = true;
+    }
+    int hover = mPickIndex.pick(mCursor);
+    if (hover == mHover)
+        return;
+    mHover = hover;
+    if (mPickListener != NULL)
+        mPickListener->hover(*this, (hover >= 0) ? &mPickDets[hover] : NULL);
+}
+
+void DetectionWindow::clicked(void) {
+    mSelect = mHover;
+    mSelecting = (mSelect >= 0);
+    mSelectPoint = mCursor;
+    mSelectTrack = (mSelect >= 0) ? mPickDets[mSelect].track : 0;
+    if (mPickListener != NULL)
+        mPickListener->select(*this, selected());
+}
+
+void DetectionWindow::cursorLeft(void) {
+    mCursorIn = false;
+    if (mHover < 0)
+        return;
+    mHover = -1;
+    if (mPickListener != NULL)
+        mPickListener->hover(*this, NULL);
+}
+
+// Render text
+int DetectionWindow::showText(void) {
+    if (detections.empty())
+        return GL_TRUE;
+    // Orthographic projection (for text). Set up to allow specifying coordinates in screen pixels units
+    glm::mat4 projection = glm::ortho(0.0f, (float)mWidth, 0.0f, (float)mHeight);
+    //glm::mat4 projection = glm::ortho(0.0f, 1.0f, 0.0f, 1.0f); // 0..1 x, 1..0 y. OpenCV convention
+    gltUseProgram(mTextShaderProgram);
+    gltUniformMatrix4fv(mTextUniProjection, 1, GL_FALSE, glm::value_ptr(projection));
+
+    const GLfloat scale = 0.35f;
+    GLfloat h = mContext->glyph('X').Size.y * 1.7f * scale;
+
+    // Count badges, centered on their clusters
+    for (auto& badge: mLodBadges) {
+        string count = to_string(badge.count);
+        GLfloat tw = 10.0f;
+        for (auto ch: count)
+            tw += (mContext->glyph(ch).Advance >> 6);
+        tw *= scale;
+        renderTextTrueType(count, (badge.center.x - 0.5f * tw) / mWidth, (badge.center.y + 0.5f * h) / mHeight,
+                           scale, badge.color);
+    }
+
+    // Details of the selected detection
+    if (mSelect >= 0) {
+        const Detection& det = detections[mSelect];
+        char info[160];
+        snprintf(info, sizeof(info), "%s  score %.2f  track %d  class %d", det.label.c_str(), det.score,
+                 det.track, det.classId);
+        renderTextTrueType(info, 4.0f / mWidth, (h + 4.0f) / mHeight, scale, det.color);
+    }
+
+    if (!mLabelPlacement) {
+        for (size_t i = 0; i < detections.size(); i++) {
+            if ((mLodFlags[i] & LOD_LABEL) == 0)
+                continue;
+            string label = detections[i].label; // TODO: add det.score
+            renderTextTrueType(label, detections[i].xmin, detections[i].ymin, scale, detections[i].color);
+        }
+        return GL_TRUE;
     }
 
-    *shader_program_id = glCreateProgram();
-    glAttachShader(*shader_program_id, fs);
-    glAttachShader(*shader_program_id, vs);
-    glLinkProgram(*shader_program_id);
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    // Label sizes as renderTextTrueType draws them, in window pixels
+    mLabelRequests.clear();
+    mLabelDets.clear();
+    for (size_t i = 0; i < detections.size(); i++) {
+        if ((mLodFlags[i] & LOD_LABEL) == 0)
+            continue;
+        const Detection& det = detections[i];
+        mLabelRequests.push_back(LabelRequest());
+        mLabelDets.push_back((int)i);
+        LabelRequest& req = mLabelRequests.back();
+        GLfloat tw = 10.0f;
+        for (auto ch: det.label)
+            tw += (mContext->glyph(ch).Advance >> 6);
+        req.boxMin = glm::vec2(det.xmin * mWidth, det.ymin * mHeight);
+        req.boxMax = glm::vec2(det.xmax * mWidth, det.ymax * mHeight);
+        req.size = glm::vec2(tw * scale, h);
+        req.score = det.score;
+        req.track = det.track;
+    }
+    mLabelPlacer.setViewport(mWidth, mHeight);
+    mLabelPlacer.place(mLabelRequests, mLabelPlacements);
+    const LabelStats& ls = mLabelPlacer.stats();
+    gltCountLabels(ls.placed, ls.hidden, ls.tests, ls.placeMs);
+
+    // renderTextTrueType takes the label's bottom left
+    for (size_t i = 0; i < mLabelPlacements.size(); i++) {
+        const LabelPlacement& p = mLabelPlacements[i];
+        if (p.anchor < 0)
+            continue;
+        const Detection& det = detections[mLabelDets[i]];
+        renderTextTrueType(det.label, p.pos.x / mWidth, (p.pos.y + h) / mHeight, scale, det.color);
+    }
 
     return GL_TRUE;
 }
 
+
+GLBuffer DetectionWindow::createVertexBuffer(const void *vertex_buffer, GLuint vbsize, bool dstatic) {
+    GLBuffer vbo = GLBuffer::create();
+    gltBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (dstatic)
+        gltBufferData(GL_ARRAY_BUFFER, vbsize, vertex_buffer, GL_STATIC_DRAW);
+    else
+        gltBufferData(GL_ARRAY_BUFFER, vbsize, vertex_buffer, GL_DYNAMIC_DRAW);
+    return vbo;
+}
+
+GLVertexArray DetectionWindow::createVertexArray() {
+    GLVertexArray vao = GLVertexArray::create();
+    gltBindVertexArray(vao);
+    return vao;
+}
+
+// Frees this window's objects only; programs and glyphs go with the last window (see RenderContext)
+void DetectionWindow::cleanup(void) {
+    if (mContext == NULL)
+        return;
+    makeCurrent();
+    // Textures the next window is likely to want again (same frame sizes) go back to the pool;
+    // the rest is deleted
+    GLObjectPool& pool = mContext->pool();
+
+    // Image
+    mImageVAO.reset();
+    mImageVertexBuffer.reset();
+    pool.release(mImageTex);
+#if WITH_CUDA
+    mGpuTex.release();
+#endif
+
+    // BBox
+    mBBoxVAO.reset();
+    mBBoxVertexBuffer.reset();
+    mTrailVAO.reset();
+    mTrailVertexBuffer.reset();
+
+    // Text
+    mTextVAO.reset();
+    mTextVertexBuffer.reset();
+
+    // Mosaic
+    mMosaicTexArray.reset();
+#if WITH_CUDA
+    mStreamPBO.release();
+#endif
+
+    // YUV input
+    for (int p = 0; p < 3; p++)
+        pool.release(mYUVTex[p]);
+    mYUVWidth = mYUVHeight = 0;
+#if WITH_CUDA
+    mYUVPBO.release();
+#endif
+
+    deleteHeatmap();
+    deleteOverlay();
+
+    // Capture: frames already read back still go to the encoder
+    if (mEncoder != NULL)
+        collectReadbacks(true);
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        if (mReadbacks[i].fence != NULL)
+            gltDeleteSync(mReadbacks[i].fence);
+        if (mContext != NULL)
+            mContext->pool().release(mReadbacks[i].pbo);
+        mReadbacks[i].pbo.buf.reset();
+        mReadbacks[i].size = 0;
+        mReadbacks[i].fence = NULL;
+    }
+    mReadbackCount = 0;
+    mClipFrames = 0;
+
+    if (mDownscaleQuery != 0)
+        gltDeleteQueries(1, &mDownscaleQuery);
+    mDownscaleQuery = 0;
+    mDownscalePending = false;
+
+    if (mWindow != NULL)
+        glfwDestroyWindow(mWindow);
+    mWindow = NULL;
+    // Until another window is made current, calls count as work outside any window
+    if (gltTrace == &mTrace)
+        gltTrace = &gltStats;
+    mContext->release();
+    mContext = NULL;
+}
+
 // render text
 // params
 // _x: bottom-left x position for text. [0..1] == [left..right]
@@ -551,11 +1738,11 @@ void DetectionWindow::renderTextTrueType(string text, GLfloat _x, GLfloat _y, GL
     // First render a solid box behind text
     GLfloat tw = 10.0f; // total text width
     for (auto ch: text)
-        tw += (mCharacters[ch].Advance >> 6);
+        tw += (mContext->glyph(ch).Advance >> 6);
     tw *= (scale/mWidth); // fraction of screen width
     GLfloat bx = _x;
     GLfloat by;
-    GLfloat h = (mCharacters['X'].Size.y *1.7f) * scale / mHeight;
+    GLfloat h = (mContext->glyph('X').Size.y *1.7f) * scale / mHeight;
     if (_y < 20.0f/mHeight) {
         h *= -1.0f;
         by = _y + 1.0f/mHeight;
@@ -570,14 +1757,12 @@ void DetectionWindow::renderTextTrueType(string text, GLfloat _x, GLfloat _y, GL
         bx + tw,   by
     };
     // We will use BBox shaders to draw a solid bg box for text
-    glBindVertexArray(mBBoxVAO);
-    glUseProgram(mBBoxShaderProgram);
-    glUniform3fv(mBBoxUniColor, 1, glm::value_ptr(color));
-    glBindBuffer(GL_ARRAY_BUFFER, mBBoxVertexBuffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(boxVertices), boxVertices);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, NUM_BOX_VERTICES);
-    glBindVertexArray(0);
+    gltBindVertexArray(mBBoxVAO);
+    gltUseProgram(mBBoxShaderProgram);
+    gltUniform3fv(mBBoxUniColor, 1, glm::value_ptr(color));
+    gltBindBuffer(GL_ARRAY_BUFFER, mBBoxVertexBuffer);
+    gltBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(boxVertices), boxVertices);
+    gltDrawArrays(GL_TRIANGLE_STRIP, 0, NUM_BOX_VERTICES);
 #endif
 #if 1
     // Convert to pixel units and add margins
@@ -589,13 +1774,13 @@ void DetectionWindow::renderTextTrueType(string text, GLfloat _x, GLfloat _y, GL
     GLfloat x = _x*mWidth + 1.0f;
 
     // Render text characters
-    glBindVertexArray(mTextVAO);
-    glUseProgram(mTextShaderProgram);
-    glActiveTexture(GL_TEXTURE0);
-    glUniform3f(mTextUniTextColor, 1.0f - color.x, 1.0f - color.y, 1.0f - color.z);
+    gltBindVertexArray(mTextVAO);
+    gltUseProgram(mTextShaderProgram);
+    gltActiveTexture(GL_TEXTURE0);
+    gltUniform3f(mTextUniTextColor, 1.0f - color.x, 1.0f - color.y, 1.0f - color.z);
     string::const_iterator c;
     for (auto c: text) {
-        Character ch = mCharacters[c];
+        const Character& ch = mContext->glyph(c);
 
         GLfloat xpos = x + ch.Bearing.x * scale;
         GLfloat ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
@@ -612,71 +1797,15 @@ void DetectionWindow::renderTextTrueType(string text, GLfloat _x, GLfloat _y, GL
             { xpos + w, ypos,       1.0, 1.0 },
         };
         // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+        gltBindTexture(GL_TEXTURE_2D, ch.TextureID);
         // Update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, mTextVertexBuffer);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gltBindBuffer(GL_ARRAY_BUFFER, mTextVertexBuffer);
+        gltBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
         // Render quad
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, NUM_BOX_VERTICES);
+        gltDrawArrays(GL_TRIANGLE_STRIP, 0, NUM_BOX_VERTICES);
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.Advance >> 6) * scale; // Bit-shift by 6 to get value in pixels (2^6 = 64)
     }
 #endif
 }
 
-int DetectionWindow::loadFonts(void) {
-    // Load TrueType fonts
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft)) {
-        cout << "ERROR::FREETYPE: Could not init FreeType Library" << endl;
-        return GL_FALSE;
-    }
-
-    FT_Face face;
-    if (FT_New_Face(ft, "/usr/share/fonts/truetype/ubuntu-font-family/Ubuntu-R.ttf", 0, &face)) {
-        cout << "ERROR::FREETYPE: Failed to load font" << endl;
-        return GL_FALSE;
-    }
-    FT_Set_Pixel_Sizes(face, 0, 48); // width decided by lib
-
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
-
-    for (GLubyte c = 0; c < 128; c++) {
-        // Load character glyph
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-            cout << "ERROR::FREETYTPE: Failed to load Glyph" << endl;
-            continue;
-        }
-        // Generate texture
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(GL_TEXTURE_2D,
-                     0,
-                     GL_RED,
-                     face->glyph->bitmap.width,
-                     face->glyph->bitmap.rows,
-                     0,
-                     GL_RED,
-                     GL_UNSIGNED_BYTE,
-                     face->glyph->bitmap.buffer
-        );
-        // Set texture options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // Now store character for later use
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            (GLuint)face->glyph->advance.x
-        };
-        mCharacters.insert(pair<GLchar, Character>(c, character));
-    }
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
-    return GL_TRUE;
-}
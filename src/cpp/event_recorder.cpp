@@ -0,0 +1,166 @@
+/*
+ * event_recorder.cpp
+ *
+ *      Author: maheriya
+ * Description: Pre-event ring of encoded frames, written out when a detection trigger fires
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "event_recorder.hpp"
+
+using namespace std;
+
+EventRecorder::EventRecorder(const string& name, const string& prefix) :
+    mName(name),
+    mPrefix(prefix),
+    mPre(5.0),
+    mPost(5.0),
+    mMemoryLimit(64 << 20),
+    mFrameInterval(0.0),
+    mLastWanted(-1e9),
+    mRingBytes(0),
+    mEventPending(false),
+    mEventStart(0.0),
+    mEventEnd(0.0),
+    mEventFile(NULL),
+    mWritten(0.0),
+    mStats() { }
+
+EventRecorder::~EventRecorder(void) {
+    finish();
+}
+
+void EventRecorder::setWindow(double pre, double post) {
+    lock_guard<mutex> lock(mLock);
+    mPre = max(pre, 0.0);
+    mPost = max(post, 0.0);
+}
+
+void EventRecorder::addTrigger(int classId, float minScore, const string& label) {
+    EventTrigger trigger = { classId, label, minScore };
+    mTriggers.push_back(trigger);
+}
+
+bool EventRecorder::wantFrame(double t) {
+    if (t - mLastWanted < mFrameInterval * 0.999)
+        return false;
+    mLastWanted = t;
+    return true;
+}
+
+bool EventRecorder::check(const vector<Detection>& dets, double t) {
+    bool match = false;
+    for (size_t i = 0; i < dets.size() && !match; i++) {
+        const Detection& d = dets[i];
+        for (size_t k = 0; k < mTriggers.size() && !match; k++) {
+            const EventTrigger& tr = mTriggers[k];
+            match = d.score >= tr.minScore && (tr.classId < 0 || d.classId == tr.classId) &&
+                    (tr.label.empty() || d.label == tr.label);
+        }
+    }
+    if (!match)
+        return false;
+
+    lock_guard<mutex> lock(mLock);
+    if (mEventFile == NULL && !mEventPending) {
+        mEventPending = true;
+        mEventStart = t;
+    }
+    mEventEnd = t + mPost;
+    return true;
+}
+
+void EventRecorder::put(vector<uchar>& jpeg, double timestamp) {
+    lock_guard<mutex> lock(mLock);
+    // Frames finish nearly in order: insert from the back
+    deque<Frame>::iterator it = mRing.end();
+    while (it != mRing.begin() && (it - 1)->timestamp > timestamp)
+        --it;
+    it = mRing.insert(it, Frame());
+    it->timestamp = timestamp;
+    it->jpeg.swap(jpeg);
+    mRingBytes += it->jpeg.size();
+    mStats.received++;
+    mStats.maxBytes = max(mStats.maxBytes, mRingBytes);
+    if (mEventFile != NULL && timestamp <= mWritten)
+        mStats.late++;
+
+    if (mEventPending)
+        openEvent();
+    if (mEventFile != NULL) {
+        writeEvent();
+        if (mRing.back().timestamp > mEventEnd)
+            closeEvent();
+    }
+    trim();
+}
+
+void EventRecorder::finish(void) {
+    lock_guard<mutex> lock(mLock);
+    if (mEventPending && !mRing.empty())
+        openEvent(); // triggered, and no frame came after: the pre-event frames only
+    mEventPending = false;
+    if (mEventFile != NULL) {
+        writeEvent();
+        closeEvent();
+    }
+}
+
+RecorderStats EventRecorder::stats(void) {
+    lock_guard<mutex> lock(mLock);
+    RecorderStats s = mStats;
+    s.frames = mRing.size();
+    s.bytes = mRingBytes;
+    return s;
+}
+
+void EventRecorder::openEvent(void) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s_%03" PRIu64 ".mjpeg", mPrefix.c_str(), mStats.events);
+    mEventFile = fopen(path, "wb");
+    if (mEventFile == NULL)
+        printf("EventRecorder %s: could not open %s\n", mName.c_str(), path);
+    else
+        printf("EventRecorder %s: event %" PRIu64 " -> %s\n", mName.c_str(), mStats.events, path);
+    mEventPending = false;
+    mWritten = mEventStart - mPre - 1e-9; // nothing written yet
+    mStats.events++;
+}
+
+// Ring frames after the last one written, up to the end of the event, in timestamp order
+void EventRecorder::writeEvent(void) {
+    for (size_t i = 0; i < mRing.size(); i++) {
+        const Frame& f = mRing[i];
+        if (f.timestamp <= mWritten)
+            continue;
+        if (f.timestamp > mEventEnd)
+            break;
+        if (fwrite(f.jpeg.data(), 1, f.jpeg.size(), mEventFile) == f.jpeg.size()) {
+            mStats.eventFrames++;
+            mStats.eventBytes += f.jpeg.size();
+        }
+        mWritten = f.timestamp;
+    }
+}
+
+void EventRecorder::closeEvent(void) {
+    fclose(mEventFile);
+    mEventFile = NULL;
+}
+
+// Drops what is older than the pre-event window (and already written, during an event), then the
+// oldest frames while over the byte limit
+void EventRecorder::trim(void) {
+    double keepFrom = mRing.back().timestamp - mPre;
+    while (!mRing.empty() && mRing.front().timestamp < keepFrom &&
+           (mEventFile == NULL || mRing.front().timestamp <= mWritten)) {
+        mRingBytes -= mRing.front().jpeg.size();
+        mRing.pop_front();
+    }
+    while (mRingBytes > mMemoryLimit && mRing.size() > 1) {
+        mRingBytes -= mRing.front().jpeg.size();
+        mRing.pop_front();
+        mStats.evicted++;
+    }
+}
@@ -0,0 +1,188 @@
+/*
+ * frame_encoder.cpp
+ *
+ *      Author: maheriya
+ * Description: Worker pool encoding captured frames to disk
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "frame_encoder.hpp"
+
+using namespace std;
+
+FrameEncoder::FrameEncoder(void) :
+    mQueueDepth(8),
+    mReserved(0),
+    mBusy(0),
+    mJpegQuality(90),
+    mStopping(false),
+    mStats() { }
+
+FrameEncoder::~FrameEncoder(void) {
+    stop();
+}
+
+bool FrameEncoder::start(int workers, int queueDepth, int jpegQuality) {
+    stop();
+    if (workers <= 0)
+        workers = max(1, (int)thread::hardware_concurrency() / 2);
+    mQueueDepth = (queueDepth > 0) ? queueDepth : 1;
+    mJpegQuality = jpegQuality;
+    mStopping = false;
+    for (int i = 0; i < workers; i++)
+        mWorkers.push_back(thread(&FrameEncoder::run, this));
+    return true;
+}
+
+void FrameEncoder::stop(void) {
+    if (mWorkers.empty())
+        return;
+    {
+        // No new reservations; buffers already acquired are still submitted (and written)
+        unique_lock<mutex> lock(mLock);
+        mStopping = true;
+        mIdle.wait(lock, [this] { return mReserved == 0; });
+    }
+    mWake.notify_all();
+    for (size_t i = 0; i < mWorkers.size(); i++)
+        mWorkers[i].join();
+    mWorkers.clear();
+    mFree.clear();
+}
+
+cv::Mat FrameEncoder::acquire(int width, int height) {
+    {
+        lock_guard<mutex> lock(mLock);
+        if (mWorkers.empty() || mStopping || mQueue.size() + mReserved >= mQueueDepth) {
+            mStats.queueDrops++;
+            return cv::Mat();
+        }
+        mReserved++;
+        for (size_t i = 0; i < mFree.size(); i++) {
+            if (mFree[i].cols == width && mFree[i].rows == height) {
+                cv::Mat m = mFree[i];
+                mFree[i] = mFree.back();
+                mFree.pop_back();
+                return m;
+            }
+        }
+    }
+    return cv::Mat(height, width, CV_8UC4);
+}
+
+void FrameEncoder::submit(cv::Mat& bgra, const string& path, EncodedFrameSink* sink, double timestamp) {
+    {
+        lock_guard<mutex> lock(mLock);
+        mReserved--;
+        if (path.empty() && sink == NULL) {
+            mFree.push_back(bgra);
+        } else {
+            Job job = { bgra, path, sink, timestamp };
+            mQueue.push_back(job);
+            mStats.maxQueued = max(mStats.maxQueued, mQueue.size());
+        }
+    }
+    mIdle.notify_all(); // stop() waits for the reservations
+    mWake.notify_one();
+}
+
+void FrameEncoder::countRequest(void) {
+    lock_guard<mutex> lock(mLock);
+    mStats.requested++;
+}
+
+void FrameEncoder::countReadbackDrop(void) {
+    lock_guard<mutex> lock(mLock);
+    mStats.readbackDrops++;
+}
+
+void FrameEncoder::countCopy(double ms) {
+    lock_guard<mutex> lock(mLock);
+    mStats.copyMs += ms;
+}
+
+void FrameEncoder::drain(void) {
+    unique_lock<mutex> lock(mLock);
+    while (!mWorkers.empty() && (!mQueue.empty() || mBusy > 0))
+        mIdle.wait(lock);
+}
+
+CaptureStats FrameEncoder::stats(void) {
+    lock_guard<mutex> lock(mLock);
+    CaptureStats s = mStats;
+    s.queued = mQueue.size();
+    return s;
+}
+
+void FrameEncoder::run(void) {
+    unique_lock<mutex> lock(mLock);
+    for (;;) {
+        while (mQueue.empty() && !(mStopping && mReserved == 0))
+            mWake.wait(lock);
+        if (mQueue.empty())
+            return; // stopping, and everything is written
+        Job job = mQueue.front();
+        mQueue.pop_front();
+        mBusy++;
+        lock.unlock();
+
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        size_t bytes = 0;
+        bool ok = encode(job, bytes);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+        lock.lock();
+        mBusy--;
+        if (ok) {
+            mStats.written++;
+            mStats.bytes += bytes;
+        } else {
+            mStats.failed++;
+        }
+        mStats.encodeMs += ms;
+        mStats.lastEncodeMs = ms;
+        mStats.maxEncodeMs = max(mStats.maxEncodeMs, ms);
+        mFree.push_back(job.bgra);
+        mIdle.notify_all();
+    }
+}
+
+// GL rows are bottom-up; the file gets them top-down, as BGR
+bool FrameEncoder::encode(Job& job, size_t& bytes) {
+    cv::Mat bgr;
+    cv::cvtColor(job.bgra, bgr, cv::COLOR_BGRA2BGR);
+    cv::flip(bgr, bgr, 0);
+
+    size_t dot = job.path.rfind('.');
+    string ext = (dot != string::npos) ? job.path.substr(dot) : string(".png");
+    if (job.sink != NULL)
+        ext = ".jpg";
+    vector<int> params;
+    if (ext == ".jpg" || ext == ".jpeg") {
+        params.push_back(cv::IMWRITE_JPEG_QUALITY);
+        params.push_back(mJpegQuality);
+    }
+    vector<uchar> buf;
+    try {
+        if (!cv::imencode(ext, bgr, buf, params))
+            return false;
+    } catch (const cv::Exception& e) {
+        printf("FrameEncoder: could not encode %s: %s\n", job.path.c_str(), e.what());
+        return false;
+    }
+    bytes = buf.size();
+    if (job.sink != NULL) {
+        job.sink->put(buf, job.timestamp);
+        return true;
+    }
+    FILE* fp = fopen(job.path.c_str(), "wb");
+    if (fp == NULL) {
+        printf("FrameEncoder: could not open %s for writing\n", job.path.c_str());
+        return false;
+    }
+    bool ok = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
@@ -0,0 +1,136 @@
+/*
+ * gl_object.cpp
+ *
+ *      Author: maheriya
+ * Description: Texture and buffer pool
+ */
+
+#include "gl_object.hpp"
+
+using namespace std;
+
+// Transfer format of NULL-data allocations: any legal one for the internal format will do
+static void textureTransfer(GLint format, GLenum* transfer, GLenum* type) {
+    *type = GL_UNSIGNED_BYTE;
+    switch (format) {
+    case GL_R8:    *transfer = GL_RED;  break;
+    case GL_RG8:   *transfer = GL_RG;   break;
+    case GL_RGB8:  *transfer = GL_RGB;  break;
+    case GL_R32F:  *transfer = GL_RED;  *type = GL_FLOAT; break;
+    case GL_R16F:  *transfer = GL_RED;  *type = GL_FLOAT; break;
+    case GL_RGBA16F:
+    case GL_RGBA32F: *transfer = GL_RGBA; *type = GL_FLOAT; break;
+    default:       *transfer = GL_RGBA; break;
+    }
+}
+
+GLsizeiptr gltTextureBytes(GLint format, GLsizei width, GLsizei height) {
+    GLsizeiptr texel;
+    switch (format) {
+    case GL_R8:      texel = 1; break;
+    case GL_RG8:     texel = 2; break;
+    case GL_R16F:    texel = 2; break;
+    case GL_RGB8:    texel = 3; break;
+    case GL_RGBA16F: texel = 8; break;
+    case GL_RGBA32F: texel = 16; break;
+    default:         texel = 4; break;
+    }
+    return texel * width * height;
+}
+
+GLObjectPool::GLObjectPool(size_t maxIdle) :
+    mMaxIdle(maxIdle),
+    mStats() { }
+
+PooledTexture GLObjectPool::acquireTexture(GLint format, GLsizei width, GLsizei height) {
+    mStats.acquires++;
+    PooledTexture t;
+    t.format = format;
+    t.width = width;
+    t.height = height;
+    // Most recently released first: its storage is the likeliest to still be resident
+    for (size_t i = mIdle.size(); i-- > 0; ) {
+        const Idle& idle = mIdle[i];
+        if (idle.texture && idle.format == format && idle.width == width && idle.height == height) {
+            t.tex.reset(idle.name);
+            drop(i, false);
+            mStats.hits++;
+            gltBindTexture(GL_TEXTURE_2D, t.tex);
+            return t;
+        }
+    }
+    t.tex = GLTexture::create();
+    GLenum transfer, type;
+    textureTransfer(format, &transfer, &type);
+    gltBindTexture(GL_TEXTURE_2D, t.tex);
+    gltTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, transfer, type, NULL);
+    return t;
+}
+
+PooledBuffer GLObjectPool::acquireBuffer(GLsizeiptr size, GLenum usage) {
+    mStats.acquires++;
+    GLsizeiptr capacity = 256;
+    while (capacity < size)
+        capacity *= 2;
+    PooledBuffer b;
+    b.capacity = capacity;
+    b.usage = usage;
+    for (size_t i = mIdle.size(); i-- > 0; ) {
+        const Idle& idle = mIdle[i];
+        if (!idle.texture && (GLenum)idle.format == usage && idle.bytes == capacity) {
+            b.buf.reset(idle.name);
+            drop(i, false);
+            mStats.hits++;
+            gltBindBuffer(GL_COPY_WRITE_BUFFER, b.buf);
+            return b;
+        }
+    }
+    b.buf = GLBuffer::create();
+    gltBindBuffer(GL_COPY_WRITE_BUFFER, b.buf);
+    gltBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, usage);
+    return b;
+}
+
+void GLObjectPool::release(PooledTexture& texture) {
+    if (texture.tex == 0)
+        return;
+    Idle idle = { texture.tex.release(), true, texture.format, texture.width, texture.height,
+                  gltTextureBytes(texture.format, texture.width, texture.height) };
+    add(idle);
+}
+
+void GLObjectPool::release(PooledBuffer& buffer) {
+    if (buffer.buf == 0)
+        return;
+    Idle idle = { buffer.buf.release(), false, (GLint)buffer.usage, 0, 0, buffer.capacity };
+    add(idle);
+}
+
+void GLObjectPool::add(const Idle& idle) {
+    mStats.released++;
+    mIdle.push_back(idle);
+    mStats.idle = mIdle.size();
+    mStats.idleBytes += idle.bytes;
+    while (mIdle.size() > mMaxIdle)
+        drop(0, true);
+}
+
+// Removes entry i; evicted entries are deleted, the others have been handed out
+void GLObjectPool::drop(size_t i, bool evicted) {
+    Idle idle = mIdle[i];
+    mIdle.erase(mIdle.begin() + i);
+    mStats.idle = mIdle.size();
+    mStats.idleBytes -= idle.bytes;
+    if (!evicted)
+        return;
+    mStats.evicted++;
+    if (idle.texture)
+        GLTexture(idle.name).reset();
+    else
+        GLBuffer(idle.name).reset();
+}
+
+void GLObjectPool::clear(void) {
+    while (!mIdle.empty())
+        drop(mIdle.size() - 1, true);
+}
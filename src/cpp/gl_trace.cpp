@@ -0,0 +1,127 @@
+/*
+ * gl_trace.cpp
+ *
+ *      Author: maheriya
+ * Description: Counters and backend selection for the GL interposition layer
+ */
+
+#include <string.h>
+#include "gl_trace.hpp"
+
+GLTraceStats   gltStats;
+GLTraceStats*  gltTrace = &gltStats;
+GLObjectCounts gltLive;
+GLTraceBackend gltBackend = GLT_BACKEND_GL;
+bool           gltStateCacheEnabled = true;
+
+static GLStateCache gltDefaultState = {
+    GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN,
+    { GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN,
+      GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN,
+      GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN,
+      GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN, GLT_STATE_UNKNOWN }
+};
+GLStateCache* gltState = &gltDefaultState;
+
+// Names handed out by the no-op backend. Never 0, as 0 means "no object" in GL.
+static GLuint gltNoopLastName = 0;
+
+void gltSetBackend(GLTraceBackend backend) {
+    gltBackend = backend;
+}
+
+// With the cache disabled, redundant calls are still counted but always issued
+void gltSetStateCache(bool enable) {
+    gltStateCacheEnabled = enable;
+}
+
+void gltInvalidateState(void) {
+    gltState->program     = GLT_STATE_UNKNOWN;
+    gltState->vao         = GLT_STATE_UNKNOWN;
+    gltState->arrayBuffer = GLT_STATE_UNKNOWN;
+    gltState->activeUnit  = GLT_STATE_UNKNOWN;
+    for (int u = 0; u < GLT_MAX_TEXTURE_UNITS; u++)
+        gltState->texture2D[u] = GLT_STATE_UNKNOWN;
+}
+
+void gltResetStats(void) {
+    memset(gltTrace, 0, sizeof(*gltTrace));
+}
+
+static void gltAccumulate(GLTraceCounters& dst, const GLTraceCounters& src) {
+    dst.drawCalls    += src.drawCalls;
+    dst.programBinds += src.programBinds;
+    dst.vaoBinds     += src.vaoBinds;
+    dst.textureBinds += src.textureBinds;
+    dst.bufferBinds  += src.bufferBinds;
+    dst.uploads      += src.uploads;
+    dst.uploadBytes  += src.uploadBytes;
+    dst.readbackBytes += src.readbackBytes;
+    dst.redundantCalls += src.redundantCalls;
+    dst.labelsPlaced += src.labelsPlaced;
+    dst.labelsHidden += src.labelsHidden;
+    dst.labelTests   += src.labelTests;
+    dst.labelMs      += src.labelMs;
+    dst.objectsCreated += src.objectsCreated;
+}
+
+void gltEndFrame(void) {
+    gltAccumulate(gltTrace->total, gltTrace->current);
+    gltTrace->last = gltTrace->current;
+    memset(&gltTrace->current, 0, sizeof(gltTrace->current));
+    gltTrace->frames++;
+}
+
+GLuint gltNoopGenName(void) {
+    return ++gltNoopLastName;
+}
+
+// Size of a tightly packed image of given format and type (unpack alignment ignored)
+GLsizeiptr gltImageBytes(GLenum format, GLenum type, GLsizei width, GLsizei height) {
+    GLsizeiptr components;
+    switch (format) {
+    case GL_RED:
+    case GL_GREEN:
+    case GL_BLUE:
+    case GL_ALPHA:
+    case GL_DEPTH_COMPONENT: components = 1; break;
+    case GL_RG:             components = 2; break;
+    case GL_RGB:
+    case GL_BGR:            components = 3; break;
+    default:                components = 4; break;
+    }
+
+    GLsizeiptr bytes;
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:           bytes = 1; break;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:     bytes = 2; break;
+    default:                bytes = 4; break;
+    }
+    return components * bytes * width * height;
+}
+
+bool gltUnpackRows(size_t step, GLsizei width, GLsizei pixelBytes) {
+    if (step < (size_t)width * pixelBytes)
+        return false;
+    // Widest alignment the step allows
+    for (GLint align = 8; align >= 1; align /= 2) {
+        if ((step % align) != 0)
+            continue;
+        // Rows of 'n' pixels padded to 'align' bytes; n == width needs no row length
+        size_t n = step / pixelBytes;
+        if ((n * pixelBytes + align - 1) / align * align != step)
+            continue;
+        gltPixelStorei(GL_UNPACK_ALIGNMENT, align);
+        gltPixelStorei(GL_UNPACK_ROW_LENGTH, (n == (size_t)width) ? 0 : (GLint)n);
+        return true;
+    }
+    return false;
+}
+
+void gltUnpackDefaults(void) {
+    gltPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gltPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
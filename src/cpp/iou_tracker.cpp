@@ -0,0 +1,406 @@
+/*
+ * iou_tracker.cpp
+ *
+ *      Author: maheriya
+ * Description: IoU tracker: SIMD overlap kernels, greedy and Hungarian matching, trails
+ */
+
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include "iou_tracker.hpp"
+#include "box_simd.hpp"
+
+using namespace std;
+
+#define BOX_PAD 8 // widest vector (AVX: 8 floats)
+
+void BoxSoA::resize(size_t count) {
+    n = count;
+    size_t padded = (count + BOX_PAD - 1) / BOX_PAD * BOX_PAD;
+    // Padding boxes are empty: zero area, zero overlap with anything
+    x1.assign(padded, 0.0f);
+    y1.assign(padded, 0.0f);
+    x2.assign(padded, 0.0f);
+    y2.assign(padded, 0.0f);
+    area.assign(padded, 0.0f);
+}
+
+//-------------------------------------------------------------------------------------
+// IoU kernels: one box of 'a' against BOX_LANES boxes of 'b' at a time
+//-------------------------------------------------------------------------------------
+#ifdef BOX_LANES
+// Box (ax1, ay1, ax2, ay2, aarea) against b[j .. j + BOX_LANES)
+static inline vfloat iouLanes(vfloat ax1, vfloat ay1, vfloat ax2, vfloat ay2, vfloat aarea,
+                              const BoxSoA& b, size_t j) {
+    vfloat inter = boxIntersection(ax1, ay1, ax2, ay2, &b.x1[j], &b.y1[j], &b.x2[j], &b.y2[j]);
+    vfloat uni = vsub(vadd(aarea, vload(&b.area[j])), inter);
+    return vdiv(inter, vmax(uni, vset1(FLT_MIN)));
+}
+#endif
+
+static inline float iouScalar(const BoxSoA& a, size_t i, const BoxSoA& b, size_t j) {
+    float w = min(a.x2[i], b.x2[j]) - max(a.x1[i], b.x1[j]);
+    float h = min(a.y2[i], b.y2[j]) - max(a.y1[i], b.y1[j]);
+    if (w <= 0.0f || h <= 0.0f)
+        return 0.0f;
+    float inter = w * h;
+    return inter / max(a.area[i] + b.area[j] - inter, FLT_MIN);
+}
+
+void iouMatrix(const BoxSoA& a, const BoxSoA& b, float* out) {
+    size_t cols = b.padded();
+    for (size_t i = 0; i < a.n; i++) {
+        float* row = out + i * cols;
+#ifdef BOX_LANES
+        vfloat ax1 = vset1(a.x1[i]), ay1 = vset1(a.y1[i]);
+        vfloat ax2 = vset1(a.x2[i]), ay2 = vset1(a.y2[i]), aarea = vset1(a.area[i]);
+        for (size_t j = 0; j < cols; j += BOX_LANES)
+            vstore(row + j, iouLanes(ax1, ay1, ax2, ay2, aarea, b, j));
+#else
+        for (size_t j = 0; j < cols; j++)
+            row[j] = iouScalar(a, i, b, j);
+#endif
+    }
+}
+
+// Row i of 'a' against the columns [begin[i], end[i]) of 'b' (all columns when begin is NULL)
+static void candidatesInRange(const BoxSoA& a, const BoxSoA& b, const size_t* begin, const size_t* end,
+                              float threshold, vector<IoUCandidate>& out) {
+    for (size_t i = 0; i < a.n; i++) {
+        size_t first = begin ? begin[i] : 0;
+        size_t last = begin ? end[i] : b.n;
+        if (first >= last)
+            continue;
+#ifdef BOX_LANES
+        vfloat ax1 = vset1(a.x1[i]), ay1 = vset1(a.y1[i]);
+        vfloat ax2 = vset1(a.x2[i]), ay2 = vset1(a.y2[i]), aarea = vset1(a.area[i]);
+        vfloat thr = vset1(threshold);
+        const vfloat zero = vset1(0.0f);
+        // Whole vectors: padding keeps the last one in bounds; lanes outside the range are
+        // still real (or empty padding) boxes, so their results are valid too
+        for (size_t j = first / BOX_LANES * BOX_LANES; j < last; j += BOX_LANES) {
+            // inter / union >= threshold  <=>  inter >= threshold * union: no division here
+            vfloat inter = boxIntersection(ax1, ay1, ax2, ay2, &b.x1[j], &b.y1[j], &b.x2[j], &b.y2[j]);
+            vfloat uni = vsub(vadd(aarea, vload(&b.area[j])), inter);
+            int mask = vgemask(inter, vmul(thr, uni)) & vgtmask(inter, zero);
+            if (mask == 0) // the common case: no overlap in this group of boxes
+                continue;
+            for (int k = 0; k < BOX_LANES; k++) {
+                if ((mask & (1 << k)) && j + k < b.n) {
+                    IoUCandidate c = { (int)i, (int)(j + k), iouScalar(a, i, b, j + k) };
+                    out.push_back(c);
+                }
+            }
+        }
+#else
+        for (size_t j = first; j < last; j++) {
+            float iou = iouScalar(a, i, b, j);
+            if (iou > 0.0f && iou >= threshold) {
+                IoUCandidate c = { (int)i, (int)j, iou };
+                out.push_back(c);
+            }
+        }
+#endif
+    }
+}
+
+void iouCandidates(const BoxSoA& a, const BoxSoA& b, float threshold, vector<IoUCandidate>& out) {
+    candidatesInRange(a, b, NULL, NULL, threshold, out);
+}
+
+void iouCandidatesSorted(const BoxSoA& a, const BoxSoA& b, float maxWidth, float threshold,
+                         vector<IoUCandidate>& out, vector<size_t>& scratch) {
+    // b[j] can only overlap a[i] if a.x1 - maxWidth < b.x1 < a.x2
+    scratch.resize(2 * a.n);
+    size_t* begin = &scratch[0];
+    size_t* end = begin + a.n;
+    vector<float>::const_iterator x1 = b.x1.begin(), x1End = b.x1.begin() + b.n;
+    for (size_t i = 0; i < a.n; i++) {
+        begin[i] = upper_bound(x1, x1End, a.x1[i] - maxWidth) - x1;
+        end[i] = lower_bound(x1, x1End, a.x2[i]) - x1;
+    }
+    candidatesInRange(a, b, begin, end, threshold, out);
+}
+
+//-------------------------------------------------------------------------------------
+// Tracker
+//-------------------------------------------------------------------------------------
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+IoUTracker::IoUTracker(void) :
+    mNextId(1),
+    mMethod(TRACKER_GREEDY),
+    mThreshold(0.3f),
+    mMaxAge(5),
+    mStats() { }
+
+void IoUTracker::clear(void) {
+    mTracks.clear();
+}
+
+void IoUTracker::pushTrail(Track& tr) {
+    glm::vec2 c(0.5f * (tr.xmin + tr.xmax), 0.5f * (tr.ymin + tr.ymax));
+    if (tr.trailCount < TRACK_TRAIL_LENGTH) {
+        tr.trail[(tr.trailHead + tr.trailCount) % TRACK_TRAIL_LENGTH] = c;
+        tr.trailCount++;
+    } else {
+        tr.trail[tr.trailHead] = c; // overwrite the oldest
+        tr.trailHead = (tr.trailHead + 1) % TRACK_TRAIL_LENGTH;
+    }
+}
+
+int IoUTracker::trail(int track, glm::vec2* points, int maxPoints) const {
+    for (size_t t = 0; t < mTracks.size(); t++) {
+        const Track& tr = mTracks[t];
+        if (tr.id != track)
+            continue;
+        int n = min(tr.trailCount, maxPoints);
+        int skip = tr.trailCount - n; // keep the newest
+        for (int i = 0; i < n; i++)
+            points[i] = tr.trail[(tr.trailHead + skip + i) % TRACK_TRAIL_LENGTH];
+        return n;
+    }
+    return 0;
+}
+
+void IoUTracker::update(vector<Detection>& dets) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    size_t nt = mTracks.size();
+    size_t nd = dets.size();
+
+    mTrackBoxes.resize(nt);
+    for (size_t i = 0; i < nt; i++)
+        mTrackBoxes.set(i, mTracks[i].xmin, mTracks[i].ymin, mTracks[i].xmax, mTracks[i].ymax);
+    // Detections sorted by left edge, so each track only tests the ones that can reach it
+    mDetOrder.resize(nd);
+    for (size_t j = 0; j < nd; j++)
+        mDetOrder[j] = (int)j;
+    sort(mDetOrder.begin(), mDetOrder.end(),
+         [&dets](int p, int q) { return dets[p].xmin < dets[q].xmin; });
+    mDetBoxes.resize(nd);
+    float maxWidth = 0.0f;
+    for (size_t j = 0; j < nd; j++) {
+        const Detection& d = dets[mDetOrder[j]];
+        mDetBoxes.set(j, d.xmin, d.ymin, d.xmax, d.ymax);
+        maxWidth = max(maxWidth, d.xmax - d.xmin);
+    }
+
+    mCandidates.clear();
+    iouCandidatesSorted(mTrackBoxes, mDetBoxes, maxWidth, mThreshold, mCandidates, mRanges);
+    for (size_t k = 0; k < mCandidates.size(); k++)
+        mCandidates[k].col = mDetOrder[mCandidates[k].col];
+    mStats.candidates = mCandidates.size();
+    mStats.iouMs = msSince(t);
+    t = chrono::steady_clock::now();
+
+    mTrackMatch.assign(nt, -1);
+    mDetMatch.assign(nd, -1);
+    mStats.groups = 0;
+    mStats.largestGroup = 0;
+    if (mMethod == TRACKER_HUNGARIAN)
+        matchHungarian();
+    else
+        matchGreedy(mCandidates);
+    mStats.assignMs = msSince(t);
+
+    // Matched tracks follow their detection; unmatched ones age and eventually go
+    size_t kept = 0;
+    for (size_t i = 0; i < nt; i++) {
+        Track& tr = mTracks[i];
+        int j = mTrackMatch[i];
+        if (j >= 0) {
+            Detection& d = dets[j];
+            tr.xmin = d.xmin; tr.ymin = d.ymin; tr.xmax = d.xmax; tr.ymax = d.ymax;
+            tr.age = 0;
+            pushTrail(tr);
+            d.track = tr.id;
+        } else if (++tr.age > mMaxAge) {
+            mStats.dropped++;
+            continue;
+        }
+        if (kept != i)
+            mTracks[kept] = tr;
+        kept++;
+    }
+    mTracks.resize(kept);
+
+    // Unmatched detections start tracks
+    for (size_t j = 0; j < nd; j++) {
+        if (mDetMatch[j] >= 0)
+            continue;
+        Detection& d = dets[j];
+        Track tr;
+        tr.id = mNextId++;
+        tr.age = 0;
+        tr.xmin = d.xmin; tr.ymin = d.ymin; tr.xmax = d.xmax; tr.ymax = d.ymax;
+        tr.trailHead = 0;
+        tr.trailCount = 0;
+        pushTrail(tr);
+        mTracks.push_back(tr);
+        d.track = tr.id;
+        mStats.created++;
+    }
+}
+
+// Best overlap first; each track and detection is used once
+void IoUTracker::matchGreedy(vector<IoUCandidate>& cands) {
+    sort(cands.begin(), cands.end(),
+         [](const IoUCandidate& a, const IoUCandidate& b) { return a.iou > b.iou; });
+    for (size_t k = 0; k < cands.size(); k++) {
+        const IoUCandidate& c = cands[k];
+        if (mTrackMatch[c.row] < 0 && mDetMatch[c.col] < 0) {
+            mTrackMatch[c.row] = c.col;
+            mDetMatch[c.col] = c.row;
+        }
+    }
+}
+
+static int findRoot(vector<int>& parent, int x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]]; // path halving
+        x = parent[x];
+    }
+    return x;
+}
+
+// Tracks and detections not linked by any candidate cannot affect each other's matching, so the
+// assignment problem splits into independent groups (connected components), each solved exactly.
+// In practice the groups are a handful of boxes, so 1000 x 1000 costs far less than one O(n^3).
+void IoUTracker::matchHungarian(void) {
+    int nt = (int)mTrackMatch.size();
+    int nd = (int)mDetMatch.size();
+    if ((int)mTrackLocal.size() < nt) mTrackLocal.resize(nt, -1);
+    if ((int)mDetLocal.size() < nd) mDetLocal.resize(nd, -1);
+    vector<int> parent(nt + nd);
+    for (int k = 0; k < nt + nd; k++)
+        parent[k] = k;
+    for (size_t k = 0; k < mCandidates.size(); k++) {
+        int a = findRoot(parent, mCandidates[k].row);
+        int b = findRoot(parent, nt + mCandidates[k].col);
+        if (a != b)
+            parent[a] = b;
+    }
+
+    // Bucket rows, columns and edges by group
+    vector<int> group(nt + nd, -1); // indexed by root
+    vector<char> seen(nt + nd, 0);
+    vector< vector<int> > rows, cols;
+    vector< vector<IoUCandidate> > edges;
+    for (size_t k = 0; k < mCandidates.size(); k++) {
+        const IoUCandidate& c = mCandidates[k];
+        int root = findRoot(parent, c.row);
+        if (group[root] < 0) {
+            group[root] = (int)rows.size();
+            rows.push_back(vector<int>());
+            cols.push_back(vector<int>());
+            edges.push_back(vector<IoUCandidate>());
+        }
+        int g = group[root];
+        if (!seen[c.row]) {
+            seen[c.row] = 1;
+            rows[g].push_back(c.row);
+        }
+        if (!seen[nt + c.col]) {
+            seen[nt + c.col] = 1;
+            cols[g].push_back(c.col);
+        }
+        edges[g].push_back(c);
+    }
+
+    mStats.groups = rows.size();
+    for (size_t g = 0; g < rows.size(); g++) {
+        size_t size = max(rows[g].size(), cols[g].size());
+        mStats.largestGroup = max(mStats.largestGroup, size);
+        if (rows[g].size() == 1 || cols[g].size() == 1) {
+            matchGreedy(edges[g]); // a star: the best edge is optimal
+        } else if (size > TRACKER_MAX_GROUP) {
+            mStats.greedyFallbacks++;
+            matchGreedy(edges[g]);
+        } else {
+            solveGroup(rows[g], cols[g], edges[g]);
+        }
+    }
+}
+
+// Hungarian algorithm (shortest augmenting paths with potentials) on one group. Cost is 1 - IoU;
+// pairs without a candidate cost 1 (no overlap) and are not kept as matches.
+void IoUTracker::solveGroup(const vector<int>& rows, const vector<int>& cols, const vector<IoUCandidate>& edges) {
+    // Rows of the cost matrix are the smaller side
+    bool transposed = rows.size() > cols.size();
+    const vector<int>& r = transposed ? cols : rows;
+    const vector<int>& c = transposed ? rows : cols;
+    int n = (int)r.size();
+    int m = (int)c.size();
+
+    // Local indices of the global track/detection numbers, through the scratch lookups (only the
+    // group's own entries are written, and put back to -1 afterwards)
+    vector<double> cost((size_t)n * m, 1.0);
+    {
+        vector<int>& rowIdx = transposed ? mDetLocal : mTrackLocal;
+        vector<int>& colIdx = transposed ? mTrackLocal : mDetLocal;
+        for (int i = 0; i < n; i++) rowIdx[r[i]] = i;
+        for (int j = 0; j < m; j++) colIdx[c[j]] = j;
+        for (size_t k = 0; k < edges.size(); k++) {
+            int i = transposed ? rowIdx[edges[k].col] : rowIdx[edges[k].row];
+            int j = transposed ? colIdx[edges[k].row] : colIdx[edges[k].col];
+            cost[(size_t)i * m + j] = 1.0 - edges[k].iou;
+        }
+        for (int i = 0; i < n; i++) rowIdx[r[i]] = -1;
+        for (int j = 0; j < m; j++) colIdx[c[j]] = -1;
+    }
+
+    // 1-based arrays: p[j] is the row assigned to column j
+    vector<double> u(n + 1, 0.0), v(m + 1, 0.0), minv(m + 1);
+    vector<int> p(m + 1, 0), way(m + 1, 0);
+    vector<char> used(m + 1);
+    for (int i = 1; i <= n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        fill(minv.begin(), minv.end(), DBL_MAX);
+        fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            int i0 = p[j0], j1 = 0;
+            double delta = DBL_MAX;
+            for (int j = 1; j <= m; j++) {
+                if (used[j])
+                    continue;
+                double cur = cost[(size_t)(i0 - 1) * m + (j - 1)] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= m; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (int j = 1; j <= m; j++) {
+        if (p[j] == 0 || cost[(size_t)(p[j] - 1) * m + (j - 1)] >= 1.0)
+            continue; // unassigned, or assigned to a pair that does not overlap enough
+        int track = transposed ? c[j - 1] : r[p[j] - 1];
+        int det = transposed ? r[p[j] - 1] : c[j - 1];
+        mTrackMatch[track] = det;
+        mDetMatch[det] = track;
+    }
+}
@@ -0,0 +1,169 @@
+/*
+ * label_placer.cpp
+ *
+ *      Author: maheriya
+ * Description: Greedy label placement against a uniform grid of the labels placed so far
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "label_placer.hpp"
+
+using namespace std;
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+LabelPlacer::LabelPlacer(void) :
+    mWidth(1280),
+    mHeight(720),
+    mMargin(1.0f),
+    mStats(),
+    mGridW(1), mGridH(1),
+    mCellW(1.0f), mCellH(1.0f),
+    mQuery(0) { }
+
+void LabelPlacer::reset(void) {
+    mAnchors.clear();
+}
+
+size_t LabelPlacer::place(const vector<LabelRequest>& labels, vector<LabelPlacement>& out) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    size_t n = labels.size();
+    LabelPlacement hidden = { glm::vec2(0.0f), -1 };
+    out.assign(n, hidden);
+    mStats = LabelStats();
+    mStats.labels = n;
+
+    // Cells about one average label in size
+    glm::vec2 sum(0.0f);
+    for (size_t i = 0; i < n; i++)
+        sum += labels[i].size;
+    glm::vec2 avg = (n > 0) ? sum / (float)n : glm::vec2(64.0f, 16.0f);
+    mGridW = min(max((int)ceilf(mWidth / max(avg.x + mMargin, 8.0f)), 1), LABEL_GRID_MAX);
+    mGridH = min(max((int)ceilf(mHeight / max(avg.y + mMargin, 8.0f)), 1), LABEL_GRID_MAX);
+    mCellW = (float)max(mWidth, 1) / mGridW;
+    mCellH = (float)max(mHeight, 1) / mGridH;
+    mStats.gridWidth = mGridW;
+    mStats.gridHeight = mGridH;
+    mCellHead.assign(mGridW * mGridH, -1);
+    mNext.clear();
+    mEntryLabel.clear();
+    mRects.clear();
+    mStamp.clear();
+    mQuery = 0;
+
+    // Tracks shown last frame first, so they keep their places; then by score
+    // Sorted as (-score, index) pairs: compact keys, ties in input order
+    mOrder.clear();
+    for (size_t i = 0; i < n; i++) {
+        if (labels[i].track > 0 && mAnchors.count(labels[i].track))
+            mOrder.push_back(make_pair(-labels[i].score, (int)i));
+    }
+    size_t carried = mOrder.size();
+    for (size_t i = 0; i < n; i++) {
+        if (labels[i].track <= 0 || !mAnchors.count(labels[i].track))
+            mOrder.push_back(make_pair(-labels[i].score, (int)i));
+    }
+    sort(mOrder.begin(), mOrder.begin() + carried);
+    sort(mOrder.begin() + carried, mOrder.end());
+
+    mNextAnchors.clear();
+    for (size_t k = 0; k < n; k++) {
+        int i = mOrder[k].second;
+        const LabelRequest& label = labels[i];
+        int first = (k < carried) ? mAnchors[label.track] : 0;
+        for (int a = -1; a < LABEL_ANCHORS; a++) {
+            int anchor = (a < 0) ? first : a;
+            if (a == first)
+                continue;
+            glm::vec4 rect = candidate(label, anchor);
+            if (!isFree(rect))
+                continue;
+            insert(rect);
+            out[i].pos = glm::vec2(rect.x, rect.y);
+            out[i].anchor = anchor;
+            if (label.track > 0)
+                mNextAnchors[label.track] = anchor;
+            if (k < carried && a < 0)
+                mStats.kept++;
+            mStats.placed++;
+            break;
+        }
+    }
+    mStats.hidden = n - mStats.placed;
+    swap(mAnchors, mNextAnchors);
+    mStats.placeMs = msSince(t);
+    return mStats.placed;
+}
+
+// Anchor 0 is where labels went before placement existed: above the box, left aligned
+glm::vec4 LabelPlacer::candidate(const LabelRequest& label, int anchor) const {
+    const glm::vec2& b0 = label.boxMin;
+    const glm::vec2& b1 = label.boxMax;
+    float w = label.size.x, h = label.size.y;
+    glm::vec2 p;
+    switch (anchor) {
+    default:
+    case 0: p = glm::vec2(b0.x, b0.y - h);     break; // above, left
+    case 1: p = glm::vec2(b0.x, b0.y);         break; // inside top, left
+    case 2: p = glm::vec2(b0.x, b1.y);         break; // below, left
+    case 3: p = glm::vec2(b1.x - w, b0.y - h); break; // above, right
+    case 4: p = glm::vec2(b0.x, b1.y - h);     break; // inside bottom, left
+    case 5: p = glm::vec2(b1.x - w, b1.y);     break; // below, right
+    case 6: p = glm::vec2(b0.x - w, b0.y);     break; // left of the top
+    case 7: p = glm::vec2(b1.x, b0.y);         break; // right of the top
+    }
+    // Inside the viewport (labels wider than it stick out on the right/bottom)
+    p.x = max(0.0f, min(p.x, mWidth - w));
+    p.y = max(0.0f, min(p.y, mHeight - h));
+    return glm::vec4(p.x, p.y, p.x + w, p.y + h);
+}
+
+// Tests the rectangle (grown by the margin) against the placed labels in the cells it covers.
+// A label in several of the cells is tested once.
+bool LabelPlacer::isFree(const glm::vec4& rect) {
+    uint32_t query = ++mQuery;
+    float x0 = rect.x - mMargin, y0 = rect.y - mMargin;
+    float x1 = rect.z + mMargin, y1 = rect.w + mMargin;
+    int cx0 = min(max((int)(x0 / mCellW), 0), mGridW - 1);
+    int cy0 = min(max((int)(y0 / mCellH), 0), mGridH - 1);
+    int cx1 = min(max((int)(x1 / mCellW), 0), mGridW - 1);
+    int cy1 = min(max((int)(y1 / mCellH), 0), mGridH - 1);
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            for (int e = mCellHead[cy * mGridW + cx]; e >= 0; e = mNext[e]) {
+                int k = mEntryLabel[e];
+                if (mStamp[k] == query)
+                    continue;
+                mStamp[k] = query;
+                mStats.tests++;
+                const glm::vec4& r = mRects[k];
+                if (x0 < r.z && r.x < x1 && y0 < r.w && r.y < y1)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Links a placed label into the cells it covers
+void LabelPlacer::insert(const glm::vec4& rect) {
+    int k = (int)mRects.size();
+    mRects.push_back(rect);
+    mStamp.push_back(0);
+    int cx0 = min(max((int)(rect.x / mCellW), 0), mGridW - 1);
+    int cy0 = min(max((int)(rect.y / mCellH), 0), mGridH - 1);
+    int cx1 = min(max((int)(rect.z / mCellW), 0), mGridW - 1);
+    int cy1 = min(max((int)(rect.w / mCellH), 0), mGridH - 1);
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            int c = cy * mGridW + cx;
+            mNext.push_back(mCellHead[c]);
+            mEntryLabel.push_back(k);
+            mCellHead[c] = (int)mNext.size() - 1;
+        }
+    }
+}
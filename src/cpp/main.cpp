@@ -1,41 +1,201 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <argp.h>
 #include "detection_window.hpp"
+#include "iou_tracker.hpp"
+#include "detection_log.hpp"
 #include <opencv2/opencv.hpp>
 
 static int parse_opt(int, char*, struct argp_state*);
 #define DEBUG 2
 
+struct Arguments {
+    int arg_count;
+    bool no_state_cache;
+    int mosaic; // number of tiles; 0 for single image view
+    int windows; // extra windows sharing the first one's context
+    int yuv;     // IMAGE_FORMAT_NV12/I420 to feed the image as YUV; IMAGE_FORMAT_BGR otherwise
+    bool host;   // upload from the host cv::Mat instead of the GpuMat
+    bool no_downscale;
+    int gallery; // detection thumbnails
+    int track_stride;       // tracked demo boxes: detector result every N frames; 0: static boxes
+    const char* eval_file;  // recorded track sequence to evaluate interpolation on
+    const char* record_file; // detection log to append every frame's detections to
+    const char* replay_file; // detection log to show instead of the demo boxes
+    double speed;            // replay speed
+    double seek;             // replay start, seconds into the log
+    const char* clip;        // file name pattern to capture frames to
+    int clip_frames;         // frames to capture; 0: all
+    int encoders;            // capture encoder threads; 0: half the cores
+    const char* events;      // pre-event recording: output file prefix
+    const char* trigger;     // LABEL[:SCORE]; * for any label
+    double heatmap;          // heatmap half-life in seconds; 0: off
+    bool overlay;            // static zone, counting line and logo
+    int crowd;               // extra small boxes (level of detail demo)
+    const char* shm;         // shared memory ring to show frames and detections from
+};
+
 using namespace std;
 
+// Prints what is clicked in a window
+class PrintSelection : public PickListener {
+public:
+    void select(DetectionWindow& win, const Detection* det) {
+        if (det != NULL)
+            printf("Selected: %s, score %.2f, track %d, box (%.3f, %.3f)-(%.3f, %.3f)\n", det->label.c_str(),
+                   det->score, det->track, det->xmin, det->ymin, det->xmax, det->ymax);
+        else
+            printf("Selection cleared\n");
+    }
+};
+
+// Interleaves the U and V planes of an I420 frame (width x height*3/2) into NV12
+static cv::Mat i420ToNV12(const cv::Mat& i420) {
+    int width = i420.cols;
+    int height = i420.rows * 2 / 3;
+    cv::Mat nv12(i420.rows, width, CV_8UC1);
+    memcpy(nv12.data, i420.data, (size_t)width * height);
+    const uchar* u = i420.data + (size_t)width * height;
+    const uchar* v = u + (size_t)width * height / 4;
+    uchar* uv = nv12.data + (size_t)width * height;
+    for (size_t i = 0; i < (size_t)width * height / 4; i++) {
+        uv[2 * i]     = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+    return nv12;
+}
+
+// Text file, one box per line: timestamp track xmin ymin xmax ymax (ground truth of every frame)
+static int evalTracks(const char* path, int stride) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("Could not open %s\n", path);
+        return -1;
+    }
+    vector<Detection> seq;
+    Detection d = Detection();
+    while (fscanf(fp, "%lf %d %f %f %f %f", &d.timestamp, &d.track, &d.xmin, &d.ymin, &d.xmax, &d.ymax) == 6)
+        seq.push_back(d);
+    fclose(fp);
+
+    printf("%s: %zu boxes, detector on every %d-th frame\n", path, seq.size(), stride);
+    const double delays[] = { 0.0, 0.05, 0.1, 0.2 };
+    for (double delay: delays) {
+        InterpolationError e = evaluateInterpolation(seq, stride, delay, 0.2);
+        printf("delay %.2fs: IoU %.3f, center error %.4f (max %.4f), %zu missed of %zu | "
+               "no interpolation: IoU %.3f, center error %.4f | without the delay's lag: IoU %.3f, "
+               "center error %.4f\n", delay, e.meanIoU, e.meanCenter, e.maxCenter, e.missed,
+               e.samples + e.missed, e.holdMeanIoU, e.holdMeanCenter, e.alignedMeanIoU, e.alignedMeanCenter);
+    }
+    return 0;
+}
+
+// Box of a demo track moving on a Lissajous path ('path' selects it)
+static Detection movingBox(int track, int path, double t, const Detection& look) {
+    float cx = 0.5f + 0.3f * (float)sin(t * (0.5 + 0.3 * path));
+    float cy = 0.5f + 0.25f * (float)cos(t * (0.4 + 0.2 * path));
+    Detection d = look;
+    d.xmin = cx - 0.08f;
+    d.ymin = cy - 0.08f;
+    d.xmax = cx + 0.08f;
+    d.ymax = cy + 0.08f;
+    d.track = track;
+    d.timestamp = t;
+    return d;
+}
+
 int main(int argc, char *argv[]) {
-    struct argp_option options[] = { { 0 } };
+    struct argp_option options[] = {
+        { "no-state-cache", 'n', 0, 0, "Issue redundant GL binds (for before/after comparison)", 0 },
+        { "mosaic", 'm', "N", 0, "Show the image as N streams in a mosaic", 0 },
+        { "windows", 'w', "N", 0, "Also show the image in N extra (half size) windows", 0 },
+        { "yuv", 'y', "FORMAT", 0, "Feed the image as nv12 or i420 frames (converted in the shader)", 0 },
+        { "host", 'H', 0, 0, "Upload the image from host memory every frame", 0 },
+        { "gallery", 'g', "N", 0, "Show the N best detections as thumbnails", 0 },
+        { "track-demo", 't', "N", 0, "Moving tracked boxes, detected every N-th frame only", 0 },
+        { "eval-tracks", 'e', "FILE", 0, "Report box interpolation error on a recorded sequence and exit", 0 },
+        { "record", 'r', "FILE", 0, "Append the detections of every frame to a detection log", 0 },
+        { "replay", 'R', "FILE", 0, "Show the detections of a detection log", 0 },
+        { "speed", 's', "X", 0, "Replay at X times the recorded speed", 0 },
+        { "seek", 'S', "SECONDS", 0, "Start the replay SECONDS into the log", 0 },
+        { "clip", 'c', "PATTERN", 0, "Capture the frames shown to files, e.g. clip_%05d.jpg (F12: screenshot)", 0 },
+        { "clip-frames", 'C', "N", 0, "Capture N frames only", 0 },
+        { "encoders", 'E', "N", 0, "Encode captured frames on N threads", 0 },
+        { "events", 'v', "PREFIX", 0, "Save 5 s before and after each trigger to PREFIX_NNN.mjpeg", 0 },
+        { "trigger", 'T', "LABEL[:SCORE]", 0, "Detections that start an event (default: *:0.9)", 0 },
+        { "heatmap", 'M', "SECONDS", 0, "Overlay a heatmap of the detections decaying with this half-life", 0 },
+        { "overlay", 'O', 0, 0, "Show a static zone, counting line and logo", 0 },
+        { "crowd", 'D', "N", 0, "Add N small boxes, most of them packed into a few spots", 0 },
+        { "shm", 'i', "NAME", 0, "Show the frames and detections another process publishes to shared memory ring NAME", 0 },
+        { "no-downscale", 'd', 0, 0, "Always sample full resolution (no mip chain for small windows)", 0 },
+        { 0 } };
 
     static const char* doc = "OpenGL Image Viwer";
     struct argp argp = { options, parse_opt, "[FILE]", doc, 0, 0, 0 };
 
-    int arg_count = 1;
-    argp_parse(&argp, argc, argv, 0, 0, &arg_count);
+    struct Arguments args = { 1, false, 0, 0, IMAGE_FORMAT_BGR, false, false, 0, 0, NULL, NULL, NULL, 1.0, 0.0, NULL, 0, 0, NULL, "*:0.9", 0.0, false, 0, NULL };
+    argp_parse(&argp, argc, argv, 0, 0, &args);
+    gltSetStateCache(!args.no_state_cache);
+    if (args.eval_file != NULL)
+        return evalTracks(args.eval_file, (args.track_stride > 0) ? args.track_stride : 6);
 
-    char* imgfile[120];
-    cv::Mat img = cv::imread(argv[1], cv::IMREAD_COLOR); //cv::IMREAD_UNCHANGED); // use UNCHANGED for extracting alpha channel from png files
-    if (img.empty()) {
-        printf("OpenCV error: Could not open image %s\n", argv[1]);
-        return -1;
+    const char* imgfile = argv[argc - 1];
+    cv::Mat img;
+    ShmRingReader ring;
+    if (args.shm != NULL) {
+        // The producer may still be starting up
+        for (int tries = 0; !ring.open(args.shm); tries++) {
+            if (tries == 50) {
+                printf("Could not open shared memory ring %s\n", args.shm);
+                return -1;
+            }
+            usleep(100000);
+        }
+        printf("Shared memory ring %s: %dx%d\n", args.shm, ring.width(), ring.height());
+        // The window is sized for the ring's largest frame; the image only serves the extra windows
+        img = cv::Mat(ring.height(), ring.width(), CV_8UC3, cv::Scalar(0, 0, 0));
+    } else {
+        img = cv::imread(imgfile, cv::IMREAD_COLOR); //cv::IMREAD_UNCHANGED); // use UNCHANGED for extracting alpha channel from png files
+        if (img.empty()) {
+            printf("OpenCV error: Could not open image %s\n", imgfile);
+            return -1;
+        }
     }
     GLint width = img.cols;
     GLint height = img.rows;
 #if DEBUG>=1
-    printf("Image file: %s\n", argv[1]);
+    printf("Image file: %s\n", imgfile);
     printf("Image size: %dx%d\n", width, height);
     printf("Image channels: %d\n", img.channels());
 #endif
+#if WITH_CUDA
     cv::cuda::GpuMat imgGPU;
     imgGPU.upload(img);
+    cv::cuda::GpuMat yuvGPU;
+#else
+    // No CUDA: the same calls take the host frames
+    cv::Mat& imgGPU = img;
+    cv::Mat yuvGPU;
+    args.host = true;
+#endif
+    if (args.yuv != IMAGE_FORMAT_BGR) {
+        // What a decoder would hand us: 4:2:0 planes of an even sized frame
+        cv::Mat yuv;
+        cv::cvtColor(img(cv::Rect(0, 0, width & ~1, height & ~1)), yuv, cv::COLOR_BGR2YUV_I420);
+        if (args.yuv == IMAGE_FORMAT_NV12)
+            yuv = i420ToNV12(yuv);
+#if WITH_CUDA
+        yuvGPU.upload(yuv);
+#else
+        yuvGPU = yuv;
+#endif
+    }
 #if DEBUG>=2
     printf("    img step: %d, elemSize: %d\n", (int)img.step, (int)img.elemSize());
     printf("GPU img step: %d, elemSize: %d\n", (int)imgGPU.step, (int)imgGPU.elemSize());
@@ -48,6 +208,71 @@ int main(int argc, char *argv[]) {
         glfwTerminate();
         return -1;
     }
+    detectionWin.setDownscale(!args.no_downscale);
+    PrintSelection printSelection;
+    detectionWin.setPickListener(&printSelection);
+    if (args.gallery > 0 && detectionWin.setGallery(args.gallery) == GL_FALSE) {
+        detectionWin.cleanup();
+        return -1;
+    }
+    if (args.heatmap > 0.0 &&
+        detectionWin.setHeatmap(256, max(1, 256 * height / width), args.heatmap, (float)(args.heatmap / 10.0)) == GL_FALSE) {
+        detectionWin.cleanup();
+        return -1;
+    }
+    if (args.overlay) {
+        // A concave zone, a counting line and a thumbnail of the image as a logo
+        vector<glm::vec2> zone;
+        zone.push_back(glm::vec2(0.05f, 0.55f));
+        zone.push_back(glm::vec2(0.40f, 0.55f));
+        zone.push_back(glm::vec2(0.40f, 0.75f));
+        zone.push_back(glm::vec2(0.25f, 0.75f));
+        zone.push_back(glm::vec2(0.25f, 0.95f));
+        zone.push_back(glm::vec2(0.05f, 0.95f));
+        detectionWin.overlay().addPolygon(zone, glm::vec4(1.0f, 0.8f, 0.0f, 0.25f), glm::vec4(1.0f, 0.8f, 0.0f, 1.0f), 2.0f);
+        detectionWin.overlay().addLine(glm::vec2(0.5f, 0.1f), glm::vec2(0.95f, 0.4f), glm::vec4(0.0f, 1.0f, 1.0f, 0.8f), 3.0f);
+        cv::Mat logo;
+        cv::resize(img, logo, cv::Size(max(1, width / 8), max(1, height / 8)));
+        detectionWin.overlay().addImage(logo, glm::vec2(0.86f, 0.02f), glm::vec2(0.12f, 0.12f), 0.7f);
+    }
+    if (args.mosaic > 0 && detectionWin.setMosaic(args.mosaic, width, height) == GL_FALSE) {
+        detectionWin.cleanup();
+        return -1;
+    }
+
+    // Captures (clip, F12 screenshots) are encoded off the render thread
+    FrameEncoder encoder;
+    encoder.start(args.encoders);
+    detectionWin.setCapture(&encoder);
+    if (args.clip != NULL)
+        detectionWin.startClip(args.clip, args.clip_frames);
+    EventRecorder recorder("main", (args.events != NULL) ? args.events : "event");
+    if (args.events != NULL) {
+        string label = args.trigger;
+        float score = 0.0f;
+        size_t colon = label.rfind(':');
+        if (colon != string::npos) {
+            score = (float)atof(label.c_str() + colon + 1);
+            label.resize(colon);
+        }
+        recorder.addTrigger(-1, score, (label == "*") ? string() : label);
+        recorder.setFrameRate(10.0);
+        detectionWin.setRecorder(&recorder);
+    }
+
+    // Extra windows share programs and glyphs with the first one
+    vector<DetectionWindow*> extraWins;
+    for (int w = 0; w < args.windows; w++) {
+        DetectionWindow* win = new DetectionWindow();
+        char title[64];
+        sprintf(title, "OpenGL Detections Viewer %d", w + 2);
+        if (win->createWindow(width / 2, height / 2, title) == GL_FALSE) {
+            printf("Could not create extra window %d.\n", w + 2);
+            delete win;
+            break;
+        }
+        extraWins.push_back(win);
+    }
 
     // Create a fake detection results
     string label1 = "Object 1";
@@ -61,37 +286,324 @@ int main(int argc, char *argv[]) {
                     glm::vec3(0.2f, 0.2f, 1.0f), label3, 0.54f };
 
 
+    // A crowd: a few dense spots and some scattered boxes
+    vector<Detection> crowd;
+    for (int i = 0; i < args.crowd; i++) {
+        float cx, cy;
+        if (i % 4 == 3) {
+            cx = 0.05f + 0.9f * (float)rand() / RAND_MAX;
+            cy = 0.05f + 0.9f * (float)rand() / RAND_MAX;
+        } else {
+            int spot = i % 3;
+            cx = 0.2f + 0.3f * spot + 0.08f * ((float)rand() / RAND_MAX - 0.5f);
+            cy = 0.3f + 0.2f * spot + 0.08f * ((float)rand() / RAND_MAX - 0.5f);
+        }
+        float size = 0.005f + 0.025f * (float)rand() / RAND_MAX;
+        Detection d = { cx - size, cy - size, cx + size, cy + size, glm::vec3(0.9f, 0.5f, 0.1f),
+                        "person", 0.3f + 0.7f * (float)rand() / RAND_MAX };
+        crowd.push_back(d);
+    }
+
+    IoUTracker tracker; // track demo
+    vector<int> shownTracks;
+
+    DetectionLogWriter logWriter;
+    if (args.record_file != NULL && !logWriter.open(args.record_file)) {
+        detectionWin.cleanup();
+        return -1;
+    }
+    DetectionLog log;
+    if (args.replay_file != NULL) {
+        if (!log.open(args.replay_file)) {
+            detectionWin.cleanup();
+            return -1;
+        }
+        printf("Replay: %s, %" PRIu64 " frames, %.1f s\n", args.replay_file, log.frames(),
+               log.endTime() - log.startTime());
+    }
+    DetectionReplay replay(log);
+    replay.setSpeed(args.speed);
+    if (args.replay_file != NULL)
+        replay.seek(log.startTime() + args.seek, glfwGetTime());
+    vector<Detection> replayed; // last due set, shown until the next one
+
     int64 cnt = 0;
     char str[100];
     // simulate active detections
     while (!glfwWindowShouldClose(detectionWin.win())) {
         cnt++;
-        if (cnt >= 100)
-            detectionWin.addDetection(det1);
-        if (cnt >= 200)
-            detectionWin.addDetection(det2);
-        if (cnt >= 300)
-            detectionWin.addDetection(det3);
+        if (args.shm != NULL) {
+            // Frames come at the producer's pace: wait for the next one without spinning
+            if (detectionWin.displayShm(ring) == GL_FALSE)
+                glfwWaitEventsTimeout(0.001);
+        } else if (args.mosaic > 0) {
+            // Same frame in every tile; each tile gets the detections from a different time
+            for (int s = 0; s < args.mosaic; s++) {
+                detectionWin.updateStream(s, imgGPU, glfwGetTime());
+                int64 scnt = cnt + 100 * s;
+                if (scnt >= 100)
+                    detectionWin.addDetection(s, det1);
+                if (scnt >= 200)
+                    detectionWin.addDetection(s, det2);
+                if (scnt >= 300)
+                    detectionWin.addDetection(s, det3);
+            }
+            detectionWin.displayMosaic();
+        } else {
+            vector<Detection> found; // detector result of this frame (recorded)
+            bool detected = false;
+            if (args.replay_file != NULL) {
+                if (replay.update(glfwGetTime(), found)) {
+                    replayed = found;
+                    detected = true;
+                }
+                for (Detection& d: replayed)
+                    detectionWin.addDetection(d);
+            } else if (args.track_stride > 0) {
+                // A slow detector: results for the current frame only every track_stride frames
+                // Track IDs come from the IoU tracker, as they would for a real detector
+                if ((cnt % args.track_stride) == 0) {
+                    double t = glfwGetTime();
+                    detected = true;
+                    found.push_back(movingBox(0, 1, t, det1));
+                    found.push_back(movingBox(0, 2, t, det2));
+                    found.push_back(movingBox(0, 3, t, det3));
+                    tracker.update(found);
+                    shownTracks.clear();
+                    for (Detection& d: found) {
+                        detectionWin.addDetection(d);
+                        shownTracks.push_back(d.track);
+                    }
+                }
+                for (size_t k = 0; k < shownTracks.size(); k++) {
+                    glm::vec2 trail[TRACK_TRAIL_LENGTH];
+                    int n = tracker.trail(shownTracks[k], trail, TRACK_TRAIL_LENGTH);
+                    detectionWin.addTrail(trail, n, glm::vec3(1.0f, 1.0f, 0.0f));
+                }
+            } else {
+                if (cnt >= 100)
+                    found.push_back(det1);
+                if (cnt >= 200)
+                    found.push_back(det2);
+                if (cnt >= 300)
+                    found.push_back(det3);
+                found.insert(found.end(), crowd.begin(), crowd.end());
+                for (Detection& d: found)
+                    detectionWin.addDetection(d);
+                detected = true;
+            }
+            if (detected && args.record_file != NULL)
+                logWriter.write(cnt, glfwGetTime(), found);
 
-        detectionWin.display(imgGPU);
-        sprintf(str, "Frame %ld" , cnt);
+            if (args.yuv != IMAGE_FORMAT_BGR)
+                detectionWin.displayYUV(yuvGPU, args.yuv);
+            else if (args.host)
+                detectionWin.display(img);
+            else
+                detectionWin.display(imgGPU);
+        }
+        // Extra windows can be closed on their own; the others keep running
+        for (size_t w = 0; w < extraWins.size(); ) {
+            DetectionWindow* win = extraWins[w];
+            if (glfwWindowShouldClose(win->win())) {
+                win->cleanup();
+                delete win;
+                extraWins.erase(extraWins.begin() + w);
+                continue;
+            }
+            if (cnt >= 100)
+                win->addDetection(det1);
+            if (cnt >= 200)
+                win->addDetection(det2);
+            if (cnt >= 300)
+                win->addDetection(det3);
+            win->display(imgGPU);
+            w++;
+        }
+        const GLTraceCounters& fc = detectionWin.traceStats().last;
+        sprintf(str, "Frame %ld  [draws %" PRIu64 ", binds %" PRIu64 ", upload %" PRIu64 " KB]" , cnt,
+                fc.drawCalls, fc.programBinds + fc.vaoBinds + fc.textureBinds + fc.bufferBinds,
+                fc.uploadBytes >> 10);
 
         detectionWin.setTitle(str);
 
     }
+    const GLTraceStats& ts = detectionWin.traceStats();
+    if (ts.frames > 0) {
+        printf("GL calls per frame (state cache %s): draws %.1f, binds %.1f, redundant binds %.1f\n",
+               gltStateCacheEnabled ? "on" : "off",
+               (double)ts.total.drawCalls / ts.frames,
+               (double)(ts.total.programBinds + ts.total.vaoBinds + ts.total.textureBinds + ts.total.bufferBinds) / ts.frames,
+               (double)ts.total.redundantCalls / ts.frames);
+        if (ts.total.labelsPlaced + ts.total.labelsHidden > 0)
+            printf("Labels per frame: %.1f placed, %.1f hidden, %.1f overlap tests, %.3f ms\n",
+                   (double)ts.total.labelsPlaced / ts.frames, (double)ts.total.labelsHidden / ts.frames,
+                   (double)ts.total.labelTests / ts.frames, ts.total.labelMs / ts.frames);
+    }
+    const DownscaleStats& ds = detectionWin.downscaleStats();
+    if (ds.builds > 0) {
+        printf("Downscale: level %d, %" PRIu64 " builds, %.3f ms GPU per frame (%" PRIu64 " timed), "
+               "%.1f MB built vs %.1f MB of sampling saved\n", ds.level, ds.builds,
+               ds.timed ? ds.gpuNs / 1e6 / ds.timed : 0.0, ds.timed, ds.bytesBuilt / 1e6, ds.bytesSaved / 1e6);
+    }
+    const LodStats& ls = detectionWin.lodStats();
+    if (ls.crowdedFrames + ls.labelsSmall + ls.labelsCapped > 0) {
+        printf("Level of detail per frame: %.1f boxes drawn, %.1f in %.1f count badges (%" PRIu64 " crowded frames), "
+               "labels dropped %.1f small, %.1f over the limit\n", (double)ls.boxesDrawn / ls.frames,
+               (double)ls.boxesClustered / ls.frames, (double)ls.clusters / ls.frames, ls.crowdedFrames,
+               (double)ls.labelsSmall / ls.frames, (double)ls.labelsCapped / ls.frames);
+    }
+    if (args.record_file != NULL)
+        printf("Recorded %" PRIu64 " frames (%.1f MB) to %s\n", logWriter.frames(), logWriter.bytes() / 1e6,
+               args.record_file);
+    logWriter.close();
+    if (args.replay_file != NULL) {
+        const ReplayStats& rs = replay.stats();
+        printf("Replay: %" PRIu64 " frames shown, %" PRIu64 " skipped\n", rs.frames, rs.skipped);
+    }
+    if (args.shm != NULL) {
+        const ShmStats& ss = ring.stats();
+        printf("Shared memory ring: %" PRIu64 " frames shown of %" PRIu64 " published, %" PRIu64 " skipped, %"
+               PRIu64 " reused before read, %" PRIu64 " overrun while uploading, %" PRIu64 " producer restarts\n",
+               ss.frames, ring.published(), ss.skipped, ss.stale, ss.overruns, ss.reopens);
+    }
+    const GLPoolStats& ps = detectionWin.poolStats();
+    if (ps.acquires > 0)
+        printf("Object pool: %" PRIu64 " of %" PRIu64 " textures/buffers recycled, %zu idle (%.1f MB), %" PRIu64 " evicted\n",
+               ps.hits, ps.acquires, ps.idle, ps.idleBytes / 1e6, ps.evicted);
+    for (auto win: extraWins) {
+        win->cleanup();
+        delete win;
+    }
     detectionWin.cleanup();
+    // Every window is gone, and with it the shared objects: anything still alive leaked
+    if (gltLive.buffers + gltLive.textures + gltLive.vertexArrays + gltLive.framebuffers + gltLive.programs != 0)
+        printf("GL objects still alive: %" PRId64 " buffers, %" PRId64 " textures, %" PRId64 " vertex arrays, "
+               "%" PRId64 " framebuffers, %" PRId64 " programs\n", gltLive.buffers, gltLive.textures,
+               gltLive.vertexArrays, gltLive.framebuffers, gltLive.programs);
+
+    encoder.stop(); // writes what is still queued
+    if (args.events != NULL) {
+        recorder.finish();
+        RecorderStats rs = recorder.stats();
+        printf("Events %s: %" PRIu64 " written (%" PRIu64 " frames, %.1f MB); ring %zu frames, %.1f MB (max %.1f MB), "
+               "%" PRIu64 " evicted early, %" PRIu64 " late\n", recorder.name().c_str(), rs.events, rs.eventFrames,
+               rs.eventBytes / 1e6, rs.frames, rs.bytes / 1e6, rs.maxBytes / 1e6, rs.evicted, rs.late);
+    }
+    CaptureStats cs = encoder.stats();
+    if (cs.requested > 0) {
+        printf("Capture: %" PRIu64 " of %" PRIu64 " frames written (%.1f MB), dropped %" PRIu64 " at readback and %"
+               PRIu64 " at the encoder queue (max %zu queued), %" PRIu64 " failed; encode %.1f ms per image "
+               "(max %.1f), render thread copy %.2f ms per image\n", cs.written, cs.requested, cs.bytes / 1e6,
+               cs.readbackDrops, cs.queueDrops, cs.maxQueued, cs.failed,
+               (cs.written + cs.failed) ? cs.encodeMs / (cs.written + cs.failed) : 0.0, cs.maxEncodeMs,
+               (cs.written + cs.failed) ? cs.copyMs / (cs.written + cs.failed) : 0.0);
+    }
 }
 
 static int parse_opt(int key, char *arg, struct argp_state *state) {
-    int *arg_count = (int*) state->input;
+    struct Arguments *args = (struct Arguments*) state->input;
 
     switch (key) {
+    case 'n':
+        args->no_state_cache = true;
+        break;
+
+    case 'm':
+        args->mosaic = atoi(arg);
+        break;
+
+    case 'w':
+        args->windows = atoi(arg);
+        break;
+
+    case 'g':
+        args->gallery = atoi(arg);
+        break;
+
+    case 'd':
+        args->no_downscale = true;
+        break;
+
+    case 't':
+        args->track_stride = atoi(arg);
+        break;
+
+    case 'e':
+        args->eval_file = arg;
+        break;
+
+    case 'r':
+        args->record_file = arg;
+        break;
+
+    case 'R':
+        args->replay_file = arg;
+        break;
+
+    case 's':
+        args->speed = atof(arg);
+        break;
+
+    case 'S':
+        args->seek = atof(arg);
+        break;
+
+    case 'c':
+        args->clip = arg;
+        break;
+
+    case 'C':
+        args->clip_frames = atoi(arg);
+        break;
+
+    case 'E':
+        args->encoders = atoi(arg);
+        break;
+
+    case 'v':
+        args->events = arg;
+        break;
+
+    case 'T':
+        args->trigger = arg;
+        break;
+
+    case 'M':
+        args->heatmap = atof(arg);
+        break;
+
+    case 'O':
+        args->overlay = true;
+        break;
+
+    case 'D':
+        args->crowd = atoi(arg);
+        break;
+
+    case 'i':
+        args->shm = arg;
+        break;
+
+    case 'H':
+        args->host = true;
+        break;
+
+    case 'y':
+        if (strcmp(arg, "nv12") == 0)
+            args->yuv = IMAGE_FORMAT_NV12;
+        else if (strcmp(arg, "i420") == 0)
+            args->yuv = IMAGE_FORMAT_I420;
+        else
+            argp_failure(state, 1, 0, "unknown YUV format: %s (use nv12 or i420)", arg);
+        break;
+
     case ARGP_KEY_ARG:
-        --(*arg_count);
+        --args->arg_count;
         break;
 
     case ARGP_KEY_END:
-        if (*arg_count > 0)
+        if (args->arg_count > 0 && args->eval_file == NULL && args->shm == NULL)
             argp_failure(state, 1, 0, "too few arguments");
         break;
     }
@@ -0,0 +1,330 @@
+/*
+ * nms.cpp
+ *
+ *      Author: maheriya
+ * Description: Grid-binned, SIMD non-maximum suppression (hard and soft)
+ */
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include "nms.hpp"
+#include "box_simd.hpp"
+
+using namespace std;
+
+#define NMS_PAD 8 // widest vector (AVX: 8 floats)
+
+#define NMS_PENDING 0
+#define NMS_KEPT    1
+#define NMS_REMOVED 2
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+NMS::NMS(void) :
+    mMethod(NMS_HARD),
+    mAgnostic(false),
+    mIoUThreshold(0.5f),
+    mScoreThreshold(0.0f),
+    mSigma(0.5f),
+    mMaxDetections(0),
+    mStats(),
+    mGridW(1), mGridH(1),
+    mOriginX(0.0f), mOriginY(0.0f), mCellW(1.0f), mCellH(1.0f) { }
+
+size_t NMS::run(vector<Detection>& dets) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    mStats.input = dets.size();
+    mStats.iouTests = 0;
+
+    // Candidates above the score threshold, best first
+    // Sorted as (-score, index) pairs: compact keys, ties in input order
+    mOrder.clear();
+    for (size_t i = 0; i < dets.size(); i++) {
+        if (dets[i].score >= mScoreThreshold)
+            mOrder.push_back(make_pair(-dets[i].score, (int)i));
+    }
+    sort(mOrder.begin(), mOrder.end());
+    size_t n = mOrder.size();
+    mStats.candidates = n;
+    mCandidates.resize(n);
+    mScores.resize(n);
+    for (size_t k = 0; k < n; k++) {
+        mCandidates[k] = mOrder[k].second;
+        mScores[k] = -mOrder[k].first;
+    }
+    mState.assign(n, NMS_PENDING);
+    mStats.sortMs = msSince(t);
+
+    t = chrono::steady_clock::now();
+    bool hard = (mMethod == NMS_HARD);
+    buildGrid(dets, !hard);
+    mStats.binMs = msSince(t);
+
+    t = chrono::steady_clock::now();
+    size_t maxKeep = (mMaxDetections > 0) ? (size_t)mMaxDetections : n;
+    vector<int> keep;
+    if (hard) {
+        // Scores never change: in sorted order, a box survives if no kept box overlaps it.
+        // Only kept boxes enter the grid, and the test stops at the first overlap.
+        for (size_t k = 0; k < n && keep.size() < maxKeep; k++) {
+            if (overlapsKept((int)k))
+                continue;
+            mState[k] = NMS_KEPT;
+            keep.push_back((int)k);
+            insert((int)k);
+        }
+    } else {
+        // Decayed boxes are pushed again with their new score; stale heap entries are skipped
+        mVisit.assign(n, 0);
+        vector< pair<float, int> > heap;
+        heap.reserve(n);
+        for (size_t k = 0; k < n; k++)
+            heap.push_back(make_pair(mScores[k], -(int)k)); // ties: lower index first
+        make_heap(heap.begin(), heap.end());
+        while (!heap.empty() && keep.size() < maxKeep) {
+            pop_heap(heap.begin(), heap.end());
+            pair<float, int> top = heap.back();
+            heap.pop_back();
+            int k = -top.second;
+            if (mState[k] != NMS_PENDING || top.first != mScores[k])
+                continue;
+            mState[k] = NMS_KEPT;
+            keep.push_back(k);
+            suppress(k, (int)keep.size(), heap);
+        }
+    }
+
+    // Survivors, in the order they were kept
+    vector<Detection> out;
+    out.reserve(keep.size());
+    for (size_t i = 0; i < keep.size(); i++) {
+        out.push_back(std::move(dets[mCandidates[keep[i]]]));
+        out.back().score = mScores[keep[i]];
+    }
+    dets.swap(out);
+    mStats.kept = dets.size();
+    mStats.suppressMs = msSince(t);
+    return dets.size();
+}
+
+// Bins the candidates on a grid of cells about the size of an average box. Each box is added to
+// every cell it covers; boxes covering more than NMS_LARGE_CELLS cells go to one extra list.
+// Without 'fill' the cells are only sized (and filled later by insert()).
+void NMS::buildGrid(const vector<Detection>& dets, bool fill) {
+    size_t n = mCandidates.size();
+    mBox.resize(4 * n);
+    mBoxClass.resize(n);
+    mSpan.resize(4 * n);
+
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    double sumW = 0.0, sumH = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        const Detection& d = dets[mCandidates[k]];
+        float* box = &mBox[4 * k];
+        box[0] = d.xmin; box[1] = d.ymin; box[2] = d.xmax; box[3] = d.ymax;
+        mBoxClass[k] = mAgnostic ? 0.0f : (float)d.classId;
+        minX = min(minX, d.xmin); minY = min(minY, d.ymin);
+        maxX = max(maxX, d.xmax); maxY = max(maxY, d.ymax);
+        sumW += d.xmax - d.xmin;
+        sumH += d.ymax - d.ymin;
+    }
+    if (n == 0) {
+        minX = minY = 0.0f;
+        maxX = maxY = 1.0f;
+    }
+    float extentW = max(maxX - minX, FLT_MIN);
+    float extentH = max(maxY - minY, FLT_MIN);
+    mCellW = max((float)(sumW / max(n, (size_t)1)), extentW / NMS_GRID_MAX);
+    mCellH = max((float)(sumH / max(n, (size_t)1)), extentH / NMS_GRID_MAX);
+    mCellW = max(mCellW, FLT_MIN);
+    mCellH = max(mCellH, FLT_MIN);
+    mGridW = min(max((int)ceilf(extentW / mCellW), 1), NMS_GRID_MAX);
+    mGridH = min(max((int)ceilf(extentH / mCellH), 1), NMS_GRID_MAX);
+    mOriginX = minX;
+    mOriginY = minY;
+    mStats.gridWidth = mGridW;
+    mStats.gridHeight = mGridH;
+
+    int cells = mGridW * mGridH;
+    int large = cells; // index of the large box list
+    mCellStart.assign(cells + 2, 0);
+    mStats.largeBoxes = 0;
+    for (size_t k = 0; k < n; k++) {
+        const float* box = &mBox[4 * k];
+        int* span = &mSpan[4 * k];
+        span[0] = min(max((int)((box[0] - mOriginX) / mCellW), 0), mGridW - 1);
+        span[1] = min(max((int)((box[1] - mOriginY) / mCellH), 0), mGridH - 1);
+        span[2] = min(max((int)((box[2] - mOriginX) / mCellW), 0), mGridW - 1);
+        span[3] = min(max((int)((box[3] - mOriginY) / mCellH), 0), mGridH - 1);
+        if ((span[2] - span[0] + 1) * (span[3] - span[1] + 1) > NMS_LARGE_CELLS) {
+            span[0] = -1 - span[0]; // marks a large box, keeping its span
+            mCellStart[large + 1]++;
+            mStats.largeBoxes++;
+            continue;
+        }
+        for (int cy = span[1]; cy <= span[3]; cy++)
+            for (int cx = span[0]; cx <= span[2]; cx++)
+                mCellStart[cy * mGridW + cx + 1]++;
+    }
+    for (int c = 0; c <= cells; c++)
+        mCellStart[c + 1] += mCellStart[c];
+
+    // Entries, padded with empty boxes so whole vectors can be loaded up to the end
+    size_t entries = mCellStart[cells + 1];
+    mX1.assign(entries + NMS_PAD, 0.0f);
+    mY1.assign(entries + NMS_PAD, 0.0f);
+    mX2.assign(entries + NMS_PAD, 0.0f);
+    mY2.assign(entries + NMS_PAD, 0.0f);
+    mArea.assign(entries + NMS_PAD, 0.0f);
+    mClass.assign(entries + NMS_PAD, -1.0f);
+    mIndex.assign(entries + NMS_PAD, -1);
+    mFill.assign(mCellStart.begin(), mCellStart.end() - 1);
+    if (fill) {
+        for (size_t k = 0; k < n; k++)
+            insert((int)k);
+    }
+}
+
+// Appends candidate k to the cells it covers
+void NMS::insert(int k) {
+    const float* box = &mBox[4 * k];
+    const int* span = &mSpan[4 * k];
+    float area = (box[2] - box[0]) * (box[3] - box[1]);
+    int large = mGridW * mGridH;
+    for (int cy = span[1]; cy <= span[3]; cy++) {
+        for (int cx = span[0]; cx <= span[2]; cx++) {
+            int c = (span[0] < 0) ? large : cy * mGridW + cx;
+            int e = mFill[c]++;
+            mX1[e] = box[0]; mY1[e] = box[1]; mX2[e] = box[2]; mY2[e] = box[3];
+            mArea[e] = area;
+            mClass[e] = mBoxClass[k];
+            mIndex[e] = k;
+            if (span[0] < 0)
+                return;
+        }
+    }
+}
+
+// Hard NMS: whether a kept box of the same class overlaps candidate k above the threshold
+bool NMS::overlapsKept(int k) {
+    const float* box = &mBox[4 * k];
+    const int* span = &mSpan[4 * k];
+    float area = (box[2] - box[0]) * (box[3] - box[1]);
+    float cls = mBoxClass[k];
+    int x0 = (span[0] < 0) ? -1 - span[0] : span[0];
+#ifdef BOX_LANES
+    vfloat ax1 = vset1(box[0]), ay1 = vset1(box[1]), ax2 = vset1(box[2]), ay2 = vset1(box[3]);
+    vfloat aarea = vset1(area), acls = vset1(cls), thr = vset1(mIoUThreshold);
+    const vfloat zero = vset1(0.0f);
+#endif
+
+    // The cells the box covers, then the large box list
+    int cells = mGridW * mGridH;
+    for (int cy = span[1]; cy <= span[3] + 1; cy++) {
+        for (int cx = x0; cx <= span[2]; cx++) {
+            int c = (cy > span[3]) ? cells : cy * mGridW + cx;
+            int s = mCellStart[c], e = mFill[c];
+            mStats.iouTests += e - s;
+#ifdef BOX_LANES
+            for (int j = s; j < e; j += BOX_LANES) {
+                vfloat vi = boxIntersection(ax1, ay1, ax2, ay2, &mX1[j], &mY1[j], &mX2[j], &mY2[j]);
+                vfloat vu = vsub(vadd(aarea, vload(&mArea[j])), vi);
+                int mask = vgtmask(vi, vmul(thr, vu)) & vgtmask(vi, zero);
+                if (!mAgnostic)
+                    mask &= veqmask(acls, vload(&mClass[j]));
+                // Lanes past the cell's fill hold stale or other cells' boxes
+                if (mask & ((1 << min(BOX_LANES, e - j)) - 1))
+                    return true;
+            }
+#else
+            for (int j = s; j < e; j++) {
+                float w = min(box[2], mX2[j]) - max(box[0], mX1[j]);
+                float h = min(box[3], mY2[j]) - max(box[1], mY1[j]);
+                if (w > 0.0f && h > 0.0f && w * h > mIoUThreshold * (area + mArea[j] - w * h) &&
+                    (mAgnostic || mClass[j] == cls))
+                    return true;
+            }
+#endif
+            if (cy > span[3])
+                break; // large box list: once
+        }
+    }
+    return false;
+}
+
+void NMS::suppress(int pick, int pickNo, vector< pair<float, int> >& heap) {
+    const float* box = &mBox[4 * pick];
+    const int* span = &mSpan[4 * pick];
+    float area = (box[2] - box[0]) * (box[3] - box[1]);
+    float cls = mBoxClass[pick];
+    bool gaussian = (mMethod == NMS_SOFT_GAUSSIAN);
+    int x0 = (span[0] < 0) ? -1 - span[0] : span[0];
+
+#ifdef BOX_LANES
+    vfloat ax1 = vset1(box[0]), ay1 = vset1(box[1]), ax2 = vset1(box[2]), ay2 = vset1(box[3]);
+    vfloat aarea = vset1(area), acls = vset1(cls);
+    vfloat thr = vset1(gaussian ? 0.0f : mIoUThreshold);
+    const vfloat zero = vset1(0.0f);
+#endif
+
+    // The cells the pick covers, then the large box list
+    int cells = mGridW * mGridH;
+    for (int cy = span[1]; cy <= span[3] + 1; cy++) {
+        for (int cx = x0; cx <= span[2]; cx++) {
+            int c = (cy > span[3]) ? cells : cy * mGridW + cx;
+            int s = mCellStart[c], e = mCellStart[c + 1];
+            mStats.iouTests += e - s;
+            for (int j = s; j < e; ) {
+                int mask;
+                float inter[NMS_PAD], uni[NMS_PAD];
+#ifdef BOX_LANES
+                vfloat vi = boxIntersection(ax1, ay1, ax2, ay2, &mX1[j], &mY1[j], &mX2[j], &mY2[j]);
+                vfloat vu = vsub(vadd(aarea, vload(&mArea[j])), vi);
+                // IoU > threshold  <=>  inter > threshold * union
+                mask = vgtmask(vi, vmul(thr, vu)) & vgtmask(vi, zero);
+                if (!mAgnostic)
+                    mask &= veqmask(acls, vload(&mClass[j]));
+                int lanes = min(BOX_LANES, e - j);
+                mask &= (1 << lanes) - 1;
+                if (mask != 0) {
+                    vstore(inter, vi);
+                    vstore(uni, vu);
+                }
+#else
+                float w = min(box[2], mX2[j]) - max(box[0], mX1[j]);
+                float h = min(box[3], mY2[j]) - max(box[1], mY1[j]);
+                inter[0] = (w > 0.0f && h > 0.0f) ? w * h : 0.0f;
+                uni[0] = area + mArea[j] - inter[0];
+                mask = (inter[0] > 0.0f && inter[0] > (gaussian ? 0.0f : mIoUThreshold) * uni[0] &&
+                        (mAgnostic || mClass[j] == cls)) ? 1 : 0;
+                int lanes = 1;
+#endif
+                for (int l = 0; mask != 0; l++, mask >>= 1) {
+                    if (!(mask & 1))
+                        continue;
+                    int k = mIndex[j + l];
+                    if (mState[k] != NMS_PENDING)
+                        continue;
+                    if (mVisit[k] == pickNo) // box in several of the cells: decay once
+                        continue;
+                    mVisit[k] = pickNo;
+                    float iou = inter[l] / max(uni[l], FLT_MIN);
+                    mScores[k] *= gaussian ? expf(-iou * iou / mSigma) : (1.0f - iou);
+                    if (mScores[k] < mScoreThreshold || mScores[k] <= 0.0f) {
+                        mState[k] = NMS_REMOVED;
+                    } else {
+                        heap.push_back(make_pair(mScores[k], -k));
+                        push_heap(heap.begin(), heap.end());
+                    }
+                }
+                j += lanes;
+            }
+            if (cy > span[3])
+                break; // large box list: once
+        }
+    }
+}
@@ -0,0 +1,240 @@
+/*
+ * overlay_layer.cpp
+ *
+ *      Author: maheriya
+ * Description: Static overlay elements and their tessellation
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "overlay_layer.hpp"
+
+using namespace std;
+
+#define OVERLAY_POLYGON 0
+#define OVERLAY_LINE    1
+#define OVERLAY_IMAGE   2
+
+static float cross2(glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// p inside or on triangle abc (counter-clockwise)
+static bool inTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    return cross2(a, b, p) >= 0.0f && cross2(b, c, p) >= 0.0f && cross2(c, a, p) >= 0.0f;
+}
+
+bool triangulatePolygon(const vector<glm::vec2>& polygon, vector<glm::vec2>& triangles) {
+    int n = (int)polygon.size();
+    if (n < 3)
+        return false;
+    float area = 0.0f;
+    for (int i = 0; i < n; i++)
+        area += polygon[i].x * polygon[(i + 1) % n].y - polygon[(i + 1) % n].x * polygon[i].y;
+    if (area == 0.0f)
+        return false;
+
+    // Counter-clockwise vertex ring
+    vector<int> ring(n);
+    for (int i = 0; i < n; i++)
+        ring[i] = (area > 0.0f) ? i : n - 1 - i;
+
+    int guard = 0;
+    while (ring.size() > 3) {
+        int m = (int)ring.size();
+        bool cut = false;
+        for (int i = 0; i < m && !cut; i++) {
+            glm::vec2 a = polygon[ring[(i + m - 1) % m]];
+            glm::vec2 b = polygon[ring[i]];
+            glm::vec2 c = polygon[ring[(i + 1) % m]];
+            if (cross2(a, b, c) <= 0.0f)
+                continue; // reflex (or flat) corner
+            bool ear = true;
+            for (int k = 0; k < m && ear; k++) {
+                int v = ring[k];
+                if (k == i || k == (i + 1) % m || k == (i + m - 1) % m)
+                    continue;
+                if (polygon[v] != a && polygon[v] != b && polygon[v] != c && inTriangle(polygon[v], a, b, c))
+                    ear = false;
+            }
+            if (!ear)
+                continue;
+            triangles.push_back(a);
+            triangles.push_back(b);
+            triangles.push_back(c);
+            ring.erase(ring.begin() + i);
+            cut = true;
+        }
+        if (!cut) {
+            // Only flat corners left (collinear points), or not a simple polygon
+            bool flat = false;
+            for (int i = 0; i < m && !flat; i++) {
+                if (cross2(polygon[ring[(i + m - 1) % m]], polygon[ring[i]], polygon[ring[(i + 1) % m]]) == 0.0f) {
+                    ring.erase(ring.begin() + i);
+                    flat = true;
+                }
+            }
+            if (!flat || ++guard > n)
+                return false;
+        }
+    }
+    triangles.push_back(polygon[ring[0]]);
+    triangles.push_back(polygon[ring[1]]);
+    triangles.push_back(polygon[ring[2]]);
+    return true;
+}
+
+OverlayLayer::OverlayLayer(void) :
+    mNextId(1),
+    mVersion(1) { }
+
+int OverlayLayer::addPolygon(const vector<glm::vec2>& points, glm::vec4 fill, glm::vec4 outline, float outlineWidth) {
+    Element e;
+    e.id = mNextId;
+    e.type = OVERLAY_POLYGON;
+    e.fill = fill;
+    e.color = outline;
+    e.width = outlineWidth;
+    e.points = points;
+    e.image = -1;
+    if (fill.a > 0.0f && !triangulatePolygon(points, e.triangles)) {
+        printf("Overlay polygon with %zu points is degenerate or self-intersecting\n", points.size());
+        if (e.triangles.empty() && (outline.a <= 0.0f || points.size() < 2))
+            return -1;
+    }
+    mElements.push_back(e);
+    mVersion++;
+    return mNextId++;
+}
+
+int OverlayLayer::addLine(glm::vec2 a, glm::vec2 b, glm::vec4 color, float width) {
+    Element e;
+    e.id = mNextId;
+    e.type = OVERLAY_LINE;
+    e.fill = glm::vec4(0.0f);
+    e.color = color;
+    e.width = width;
+    e.points.push_back(a);
+    e.points.push_back(b);
+    e.image = -1;
+    mElements.push_back(e);
+    mVersion++;
+    return mNextId++;
+}
+
+int OverlayLayer::addImage(const cv::Mat& img, glm::vec2 pos, glm::vec2 size, float opacity) {
+    OverlayImage oi;
+    oi.id = mNextId;
+    if (img.channels() == 4)
+        oi.bgra = img.clone();
+    else if (img.channels() == 3)
+        cv::cvtColor(img, oi.bgra, cv::COLOR_BGR2BGRA);
+    else if (img.channels() == 1)
+        cv::cvtColor(img, oi.bgra, cv::COLOR_GRAY2BGRA);
+    if (oi.bgra.empty() || oi.bgra.depth() != CV_8U) {
+        printf("Overlay images must be 8-bit gray, BGR or BGRA\n");
+        return -1;
+    }
+    oi.pos = pos;
+    oi.size = size;
+    oi.opacity = opacity;
+    Element e;
+    e.id = mNextId;
+    e.type = OVERLAY_IMAGE;
+    e.fill = glm::vec4(1.0f, 1.0f, 1.0f, opacity);
+    e.color = glm::vec4(0.0f);
+    e.width = 0.0f;
+    e.image = (int)mImages.size();
+    mImages.push_back(oi);
+    mElements.push_back(e);
+    mVersion++;
+    return mNextId++;
+}
+
+bool OverlayLayer::remove(int id) {
+    for (size_t i = 0; i < mElements.size(); i++) {
+        if (mElements[i].id != id)
+            continue;
+        int image = mElements[i].image;
+        mElements.erase(mElements.begin() + i);
+        if (image >= 0) {
+            mImages.erase(mImages.begin() + image);
+            for (size_t k = 0; k < mElements.size(); k++)
+                if (mElements[k].image > image)
+                    mElements[k].image--;
+        }
+        mVersion++;
+        return true;
+    }
+    return false;
+}
+
+void OverlayLayer::clear(void) {
+    mElements.clear();
+    mImages.clear();
+    mVersion++;
+}
+
+// Quad around segment a-b, 'width' pixels wide and extended by half of it at both ends (so
+// outline corners close)
+static void addSegment(glm::vec2 a, glm::vec2 b, float width, glm::vec4 color, glm::vec2 pixels,
+                       vector<OverlayVertex>& out) {
+    glm::vec2 d = (b - a) * pixels; // in pixels
+    float len = sqrtf(d.x * d.x + d.y * d.y);
+    if (len == 0.0f)
+        return;
+    d *= 0.5f * width / len;
+    glm::vec2 n(-d.y, d.x);
+    d /= pixels;
+    n /= pixels;
+    glm::vec2 q[4] = { a - d + n, a - d - n, b + d + n, b + d - n };
+    const int idx[6] = { 0, 1, 2, 2, 1, 3 };
+    for (int i = 0; i < 6; i++) {
+        OverlayVertex v = { q[idx[i]], glm::vec2(0.0f), color };
+        out.push_back(v);
+    }
+}
+
+void OverlayLayer::build(int width, int height, vector<OverlayVertex>& vertices, vector<OverlayBatch>& batches) const {
+    vertices.clear();
+    batches.clear();
+    glm::vec2 pixels((float)width, (float)height);
+    for (size_t i = 0; i < mElements.size(); i++) {
+        const Element& e = mElements[i];
+        int first = (int)vertices.size();
+        if (e.type == OVERLAY_IMAGE) {
+            const OverlayImage& img = mImages[e.image];
+            glm::vec2 p[4] = { img.pos, img.pos + glm::vec2(img.size.x, 0.0f),
+                               img.pos + glm::vec2(0.0f, img.size.y), img.pos + img.size };
+            glm::vec2 uv[4] = { glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(0, 1), glm::vec2(1, 1) };
+            const int idx[6] = { 0, 1, 2, 2, 1, 3 };
+            for (int k = 0; k < 6; k++) {
+                OverlayVertex v = { p[idx[k]], uv[idx[k]], e.fill };
+                vertices.push_back(v);
+            }
+            OverlayBatch batch = { first, 6, e.image };
+            batches.push_back(batch);
+            continue;
+        }
+        for (size_t k = 0; k < e.triangles.size(); k++) {
+            OverlayVertex v = { e.triangles[k], glm::vec2(0.0f), e.fill };
+            vertices.push_back(v);
+        }
+        if (e.color.a > 0.0f && e.width > 0.0f) {
+            size_t n = e.points.size();
+            size_t segments = (e.type == OVERLAY_POLYGON) ? n : n - 1;
+            for (size_t k = 0; k < segments; k++)
+                addSegment(e.points[k], e.points[(k + 1) % n], e.width, e.color, pixels, vertices);
+        }
+        int count = (int)vertices.size() - first;
+        if (count == 0)
+            continue;
+        // Shapes in a row share one draw
+        if (!batches.empty() && batches.back().image < 0 && batches.back().first + batches.back().count == first)
+            batches.back().count += count;
+        else {
+            OverlayBatch batch = { first, count, -1 };
+            batches.push_back(batch);
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/*
+ * pick_index.cpp
+ *
+ *      Author: maheriya
+ * Description: Uniform grid over detection boxes for point picking
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "pick_index.hpp"
+
+using namespace std;
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+PickIndex::PickIndex(void) :
+    mGridW(1), mGridH(1),
+    mStats() {
+    clear();
+}
+
+void PickIndex::clear(void) {
+    mGridW = mGridH = 1;
+    mCellStart.assign(3, 0);
+    mBox.clear();
+    mIndex.clear();
+    mStats.boxes = 0;
+    mStats.largeBoxes = 0;
+    mStats.picks = 0;
+    mStats.tests = 0;
+}
+
+void PickIndex::build(const vector<Detection>& dets, const uint8_t* flags, uint8_t mask) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    size_t n = dets.size();
+
+    // Cells about the size of an average box
+    size_t count = 0;
+    float sumW = 0.0f, sumH = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        if (flags != NULL && (flags[i] & mask) == 0)
+            continue;
+        sumW += dets[i].xmax - dets[i].xmin;
+        sumH += dets[i].ymax - dets[i].ymin;
+        count++;
+    }
+    float cellW = (count > 0) ? max(sumW / count, 1.0f / PICK_GRID_MAX) : 1.0f;
+    float cellH = (count > 0) ? max(sumH / count, 1.0f / PICK_GRID_MAX) : 1.0f;
+    mGridW = min(max((int)ceilf(1.0f / cellW), 1), PICK_GRID_MAX);
+    mGridH = min(max((int)ceilf(1.0f / cellH), 1), PICK_GRID_MAX);
+    mStats.gridWidth = mGridW;
+    mStats.gridHeight = mGridH;
+
+    // Count, prefix sum, fill (entries of a cell stay in detection order)
+    int cells = mGridW * mGridH;
+    int large = cells;
+    mCellStart.assign(cells + 2, 0);
+    mSpan.resize(n * 4);
+    size_t largeBoxes = 0;
+    for (size_t i = 0; i < n; i++) {
+        int* span = &mSpan[i * 4];
+        if (flags != NULL && (flags[i] & mask) == 0) {
+            span[0] = -2;
+            continue;
+        }
+        const Detection& d = dets[i];
+        span[0] = min(max((int)(d.xmin * mGridW), 0), mGridW - 1);
+        span[1] = min(max((int)(d.ymin * mGridH), 0), mGridH - 1);
+        span[2] = min(max((int)(d.xmax * mGridW), 0), mGridW - 1);
+        span[3] = min(max((int)(d.ymax * mGridH), 0), mGridH - 1);
+        if ((span[2] - span[0] + 1) * (span[3] - span[1] + 1) > PICK_LARGE_CELLS) {
+            span[0] = -1;
+            mCellStart[large + 1]++;
+            largeBoxes++;
+            continue;
+        }
+        for (int cy = span[1]; cy <= span[3]; cy++)
+            for (int cx = span[0]; cx <= span[2]; cx++)
+                mCellStart[cy * mGridW + cx + 1]++;
+    }
+    for (int c = 0; c <= cells; c++)
+        mCellStart[c + 1] += mCellStart[c];
+    size_t entries = mCellStart[cells + 1];
+    mBox.resize(entries);
+    mIndex.resize(entries);
+    mFill.assign(mCellStart.begin(), mCellStart.end() - 1);
+    for (size_t i = 0; i < n; i++) {
+        const int* span = &mSpan[i * 4];
+        if (span[0] == -2)
+            continue;
+        const Detection& d = dets[i];
+        glm::vec4 box(d.xmin, d.ymin, d.xmax, d.ymax);
+        if (span[0] < 0) {
+            int e = mFill[large]++;
+            mBox[e] = box;
+            mIndex[e] = (int)i;
+            continue;
+        }
+        for (int cy = span[1]; cy <= span[3]; cy++) {
+            for (int cx = span[0]; cx <= span[2]; cx++) {
+                int e = mFill[cy * mGridW + cx]++;
+                mBox[e] = box;
+                mIndex[e] = (int)i;
+            }
+        }
+    }
+
+    mStats.boxes = count;
+    mStats.largeBoxes = largeBoxes;
+    mStats.picks = 0;
+    mStats.tests = 0;
+    mStats.buildMs = msSince(t);
+}
+
+int PickIndex::pick(glm::vec2 p) {
+    mStats.picks++;
+    if (mStats.boxes == 0 || p.x < 0.0f || p.y < 0.0f || p.x > 1.0f || p.y > 1.0f)
+        return -1;
+    int cx = min((int)(p.x * mGridW), mGridW - 1);
+    int cy = min((int)(p.y * mGridH), mGridH - 1);
+    int cells[2] = { cy * mGridW + cx, mGridW * mGridH };
+    int best = -1;
+    float bestArea = 0.0f;
+    for (int k = 0; k < 2; k++) {
+        int end = mCellStart[cells[k] + 1];
+        for (int e = mCellStart[cells[k]]; e < end; e++) {
+            const glm::vec4& b = mBox[e];
+            mStats.tests++;
+            if (p.x < b.x || p.x > b.z || p.y < b.y || p.y > b.w)
+                continue;
+            float area = (b.z - b.x) * (b.w - b.y);
+            if (best < 0 || area < bestArea || (area == bestArea && mIndex[e] > best)) {
+                best = mIndex[e];
+                bestArea = area;
+            }
+        }
+    }
+    return best;
+}
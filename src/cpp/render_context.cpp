@@ -0,0 +1,579 @@
+/*
+ * render_context.cpp
+ *
+ *      Author: maheriya
+ * Description: Shared GL context, shader programs and glyph textures for all DetectionWindows
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <chrono>
+#include "render_context.hpp"
+#include "shader_manager.hpp"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+using namespace std;
+
+RenderContext* RenderContext::sInstance = NULL;
+
+// Image fragment shader, also used by the gallery thumbnails.
+// format 0: RGB texture on unit 0. Otherwise YUV 4:2:0: Y on unit 0 and either interleaved UV
+// (NV12, format 1) on unit 1, or U and V (I420, format 2) on units 1 and 2. The chroma planes
+// are half size; the sampler interpolates them up.
+static const GLchar* image_fs_source = R"(#version 440
+
+out vec4 frag_color;
+in vec2 texUV;
+
+uniform sampler2D texture;
+uniform sampler2D texU;
+uniform sampler2D texV;
+uniform int  format;
+uniform mat3 yuvMatrix; // rgb = yuvMatrix * (yuv - yuvOffset)
+uniform vec3 yuvOffset;
+void main() {
+  if (format == 0) {
+    frag_color = texture2D(texture, texUV);
+    return;
+  }
+  vec3 yuv;
+  yuv.x = texture2D(texture, texUV).r;
+  if (format == 1)
+    yuv.yz = texture2D(texU, texUV).rg;
+  else
+    yuv.yz = vec2(texture2D(texU, texUV).r, texture2D(texV, texUV).r);
+  frag_color = vec4(clamp(yuvMatrix * (yuv - yuvOffset), 0.0, 1.0), 1.0);
+}
+)";
+
+// Callback for errors
+static void glfw_error_callback(int error, const char* desc) {
+    fprintf(stderr, "glfw_error_callback(): Error %d: %s\n", error, desc);
+}
+
+// Milliseconds since t; t is moved to now (lap timer for the startup phases)
+static double lapMs(chrono::steady_clock::time_point& t) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(now - t).count();
+    t = now;
+    return ms;
+}
+
+RenderContext::RenderContext(void) :
+    mRefs(0),
+    mRootWindow(NULL),
+    mFontRasterMs(0.0) {
+    memset(&mNoGlyph, 0, sizeof(mNoGlyph));
+    memset(&mGLState, 0, sizeof(mGLState));
+}
+
+RenderContext* RenderContext::acquire(StartupTimings* timings) {
+    if (sInstance == NULL) {
+        RenderContext* ctx = new RenderContext();
+        if (ctx->init(timings) == GL_FALSE) {
+            ctx->destroy();
+            delete ctx;
+            return NULL;
+        }
+        sInstance = ctx;
+    }
+    sInstance->mRefs++;
+    return sInstance;
+}
+
+void RenderContext::release(void) {
+    if (--mRefs > 0)
+        return;
+    destroy();
+    if (sInstance == this)
+        sInstance = NULL;
+    delete this;
+}
+
+void RenderContext::makeCurrent(void) {
+    if (mRootWindow != NULL)
+        glfwMakeContextCurrent(mRootWindow);
+    gltState = &mGLState;
+    gltTrace = &gltStats;
+}
+
+int RenderContext::init(StartupTimings* timings) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+
+    // Glyph rasterization needs no GL context; run it while GLFW and the context come up
+    mFontJob = async(launch::async, &RenderContext::rasterizeGlyphs, this);
+
+    if (!gltIsNoop()) {
+        if (glfwInit() == GL_FALSE) {
+            printf("Failed to initialize GLFW\n");
+            return GL_FALSE;
+        }
+        glfwSetErrorCallback(glfw_error_callback);
+        glfwWindowHint(GLFW_SAMPLES, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // 4.2 works too
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_RESIZABLE, 1);
+
+        // Hidden window that only holds the share group; it outlives any DetectionWindow
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        mRootWindow = glfwCreateWindow(1, 1, "gl-render", NULL, NULL);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (mRootWindow == NULL) {
+            printf("Failed to create root GL context\n");
+            return GL_FALSE;
+        }
+    }
+    makeCurrent();
+    timings->glfwInit = lapMs(t);
+
+    if (!gltIsNoop()) {
+        glewExperimental = GL_TRUE; // *Needed* for core profile
+        if (glewInit() != GLEW_OK) {
+            printf("%s\n", "glewInit() failed");
+            return GL_FALSE;
+        }
+        gltGetError(); // glewInit() may leave GL_INVALID_ENUM behind
+    }
+    gltInvalidateState();
+    timings->glew = lapMs(t);
+
+    // Issue every compile and link before querying any status. With KHR_parallel_shader_compile
+    // the driver builds the programs on its own threads while the glyphs are uploaded.
+    ShaderManager& shaders = shaderManager();
+    GLint ret = GL_TRUE;
+    shaders.beginBatch();
+    if (createImageShaders(mImageShaderProgram) == GL_FALSE)
+        ret = GL_FALSE;
+    if (createBBoxShaders(mBBoxShaderProgram) == GL_FALSE)
+        ret = GL_FALSE;
+    if (createTextShaders(mTextShaderProgram) == GL_FALSE)
+        ret = GL_FALSE;
+    timings->shaderIssue = lapMs(t);
+
+    if (loadFonts(timings) == GL_FALSE) // waits for rasterizeGlyphs()
+        ret = GL_FALSE;
+    t = chrono::steady_clock::now();
+
+    if (shaders.endBatch() == false)
+        ret = GL_FALSE;
+    timings->shaderWait = lapMs(t);
+    if (ret == GL_FALSE) {
+        printf("Shader compilation or font loading failed\n");
+        return GL_FALSE;
+    }
+    shaders.printStats();
+
+    // Sampler units are program state, so this holds for every window sharing the program
+    gltUseProgram(mImageShaderProgram);
+    gltUniform1i(gltGetUniformLocation(mImageShaderProgram, "texU"), 1);
+    gltUniform1i(gltGetUniformLocation(mImageShaderProgram, "texV"), 2);
+    return GL_TRUE;
+}
+
+void RenderContext::destroy(void) {
+    if (mFontJob.valid())
+        mFontJob.wait();
+    if (mRootWindow != NULL || gltIsNoop()) {
+        makeCurrent();
+        for (auto& ch: mCharacters)
+            gltDeleteTextures(1, &ch.second.TextureID);
+        mCharacters.clear();
+        GLProgram* programs[] = { &mImageShaderProgram, &mBBoxShaderProgram, &mTextShaderProgram,
+                                  &mMosaicShaderProgram, &mGalleryShaderProgram, &mHeatSplatShaderProgram,
+                                  &mHeatmapShaderProgram, &mOverlayShaderProgram };
+        for (GLProgram* prog: programs)
+            prog->reset();
+        mPool.clear();
+    }
+    if (mRootWindow != NULL)
+        glfwDestroyWindow(mRootWindow);
+    mRootWindow = NULL;
+    if (!gltIsNoop())
+        glfwTerminate();
+}
+
+// Any context of the share group may be current; program objects are shared
+GLuint RenderContext::mosaicProgram(void) {
+    if (mMosaicShaderProgram == 0 && createMosaicShaders(mMosaicShaderProgram) == GL_FALSE)
+        printf("Mosaic shader compilation failed\n");
+    return mMosaicShaderProgram;
+}
+
+GLuint RenderContext::galleryProgram(void) {
+    if (mGalleryShaderProgram != 0)
+        return mGalleryShaderProgram;
+    if (createGalleryShaders(mGalleryShaderProgram) == GL_FALSE) {
+        printf("Gallery shader compilation failed\n");
+        return 0;
+    }
+    gltUseProgram(mGalleryShaderProgram);
+    gltUniform1i(gltGetUniformLocation(mGalleryShaderProgram, "texU"), 1);
+    gltUniform1i(gltGetUniformLocation(mGalleryShaderProgram, "texV"), 2);
+    return mGalleryShaderProgram;
+}
+
+GLuint RenderContext::heatSplatProgram(void) {
+    if (mHeatSplatShaderProgram == 0 && createHeatSplatShaders(mHeatSplatShaderProgram) == GL_FALSE)
+        printf("Heatmap splat shader compilation failed\n");
+    return mHeatSplatShaderProgram;
+}
+
+GLuint RenderContext::heatmapProgram(void) {
+    if (mHeatmapShaderProgram != 0)
+        return mHeatmapShaderProgram;
+    if (createHeatmapShaders(mHeatmapShaderProgram) == GL_FALSE) {
+        printf("Heatmap shader compilation failed\n");
+        return 0;
+    }
+    gltUseProgram(mHeatmapShaderProgram);
+    gltUniform1i(gltGetUniformLocation(mHeatmapShaderProgram, "heat"), 0);
+    return mHeatmapShaderProgram;
+}
+
+GLuint RenderContext::overlayProgram(void) {
+    if (mOverlayShaderProgram != 0)
+        return mOverlayShaderProgram;
+    if (createOverlayShaders(mOverlayShaderProgram) == GL_FALSE) {
+        printf("Overlay shader compilation failed\n");
+        return 0;
+    }
+    gltUseProgram(mOverlayShaderProgram);
+    gltUniform1i(gltGetUniformLocation(mOverlayShaderProgram, "tex"), 0);
+    return mOverlayShaderProgram;
+}
+
+int RenderContext::createImageShaders(GLProgram& program) {
+    const GLchar* vs_source = R"(#version 330
+
+layout(location = 0) in vec4 vertex;
+
+out vec2 texUV;
+
+void main() {
+  gl_Position = vec4(vertex.xy, 0.0f, 1.0f);
+  texUV = vertex.zw;
+}
+)";
+    return shaderManager().buildProgram("image", vs_source, image_fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createGalleryShaders(GLProgram& program) {
+    // Instance i shows crops[i] of the frame texture in cells[i]; the fragment shader is the image one
+    const GLchar* vs_source = R"(#version 330 core
+
+layout(location = 0) in vec4 vertex; // image quad: NDC position, uv
+
+uniform vec4 cells[16]; // xmin, ymin, xmax, ymax in NDC (MAX_GALLERY_THUMBS)
+uniform vec4 crops[16]; // umin, vmin, umax, vmax in texture coordinates
+out vec2 texUV;
+
+void main() {
+  vec4 cell = cells[gl_InstanceID];
+  vec4 crop = crops[gl_InstanceID];
+  gl_Position = vec4(mix(cell.xy, cell.zw, vertex.xy * 0.5 + 0.5), 0.0, 1.0);
+  texUV = mix(crop.xy, crop.zw, vertex.zw);
+}
+)";
+    return shaderManager().buildProgram("gallery", vs_source, image_fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createBBoxShaders(GLProgram& program) {
+    // This shader takes xmin,ymin,xmax,ymax format box input, and converts into OpenGL convention
+    const GLchar* vs_source = R"(#version 330 core
+
+layout(location = 0) in vec3 vertexPosition;
+
+void main() {
+  vec3 position;
+  position = vertexPosition * 2 - 1.0f;
+  position.y *= -1.0f;
+  gl_Position = vec4(position, 1.0f);
+}
+)";
+
+    const GLchar* fs_source = R"(#version 440 core
+
+out vec4 frag_color;
+
+uniform vec3 BBCOLOR;
+void main() {
+  frag_color = vec4(BBCOLOR, 0.8f);
+}
+)";
+
+    return shaderManager().buildProgram("bbox", vs_source, fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createTextShaders(GLProgram& program) {
+    // Shaders for TrueType fonts rendering
+    const GLchar* vs_source = R"(#version 330 core
+
+layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+out vec2 UV;
+
+uniform mat4 projection;
+
+void main() {
+    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+    UV = vertex.zw;
+}
+)";
+
+    const GLchar* fs_source = R"(#version 440 core
+
+in vec2 UV;
+out vec4 color;
+
+uniform sampler2D texSampler;
+uniform vec3      textColor;
+
+void main()
+{    
+    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(texSampler, UV).r);
+    color = vec4(textColor, 0.8) * sampled;
+}
+)";
+
+    return shaderManager().buildProgram("text", vs_source, fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createMosaicShaders(GLProgram& program) {
+    // Instance i draws stream i into its grid cell; streams without a frame yet are culled
+    const GLchar* vs_source = R"(#version 330 core
+
+layout(location = 0) in vec4 vertex; // image quad: NDC position, uv
+
+uniform ivec2 grid;      // cols, rows
+uniform uint  validMask; // bit per stream that has a frame
+out vec3 texUVL;
+
+void main() {
+  vec2 cell = vec2(gl_InstanceID % grid.x, gl_InstanceID / grid.x);
+  vec2 corner = vec2(vertex.x * 0.5 + 0.5, 0.5 - vertex.y * 0.5); // [0..1], y down
+  vec2 pos = (cell + corner) / vec2(grid);
+  gl_Position = vec4(pos.x * 2.0 - 1.0, 1.0 - pos.y * 2.0, 0.0, 1.0);
+  if (((validMask >> uint(gl_InstanceID)) & 1u) == 0u)
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0); // outside the clip volume
+  texUVL = vec3(vertex.zw, float(gl_InstanceID));
+}
+)";
+
+    const GLchar* fs_source = R"(#version 330 core
+
+in vec3 texUVL;
+out vec4 frag_color;
+
+uniform sampler2DArray frames;
+void main() {
+  frag_color = texture(frames, texUVL);
+}
+)";
+
+    return shaderManager().buildProgram("mosaic", vs_source, fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createHeatSplatShaders(GLProgram& program) {
+    // Instance i adds a soft elliptical splat filling box i to the heat target. The decay pass
+    // covers the whole target with 0 (blending scales what is there).
+    const GLchar* vs_source = R"(#version 330 core
+
+layout(location = 0) in vec2 corner; // unit quad, [0..1]
+layout(location = 1) in vec4 box;    // xmin, ymin, xmax, ymax in [0..1], y down (per instance)
+
+uniform int decayPass;
+out vec2 local; // [-1..1] across the box
+
+void main() {
+  vec4 b = (decayPass != 0) ? vec4(0.0, 0.0, 1.0, 1.0) : box;
+  vec2 p = mix(b.xy, b.zw, corner);
+  gl_Position = vec4(p.x * 2.0 - 1.0, 1.0 - p.y * 2.0, 0.0, 1.0);
+  local = corner * 2.0 - 1.0;
+}
+)";
+
+    const GLchar* fs_source = R"(#version 330 core
+
+in vec2 local;
+out vec4 heat;
+
+uniform float weight;
+void main() {
+  heat = vec4(weight * max(0.0, 1.0 - dot(local, local)), 0.0, 0.0, 0.0);
+}
+)";
+
+    return shaderManager().buildProgram("heatsplat", vs_source, fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createHeatmapShaders(GLProgram& program) {
+    // Heat target over the whole window through a colormap (Turbo, polynomial fit); cold is clear
+    const GLchar* vs_source = R"(#version 330 core
+
+layout(location = 0) in vec2 corner; // unit quad, [0..1]
+out vec2 uv;
+
+void main() {
+  gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+  uv = corner;
+}
+)";
+
+    const GLchar* fs_source = R"(#version 330 core
+
+in vec2 uv;
+out vec4 frag_color;
+
+uniform sampler2D heat;
+uniform float scale;   // 1 / heat at the top of the colormap
+uniform float opacity;
+
+vec3 turbo(float x) {
+  const vec4 r4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+  const vec4 g4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+  const vec4 b4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+  const vec2 r2 = vec2(-152.94239396, 59.28637943);
+  const vec2 g2 = vec2(4.27729857, 2.82956604);
+  const vec2 b2 = vec2(-89.90310912, 27.34824973);
+  vec4 v4 = vec4(1.0, x, x * x, x * x * x);
+  vec2 v2 = v4.zw * v4.z;
+  return vec3(dot(v4, r4) + dot(v2, r2), dot(v4, g4) + dot(v2, g2), dot(v4, b4) + dot(v2, b2));
+}
+
+void main() {
+  float v = clamp(texture(heat, uv).r * scale, 0.0, 1.0);
+  frag_color = vec4(turbo(v), opacity * min(v * 4.0, 1.0));
+}
+)";
+
+    return shaderManager().buildProgram("heatmap", vs_source, fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+int RenderContext::createOverlayShaders(GLProgram& program) {
+    // Static overlay: colored triangles and images, baked into a texture; the same program then
+    // draws that texture over the frame
+    const GLchar* vs_source = R"(#version 330 core
+
+layout(location = 0) in vec2 position; // [0..1], y down
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec4 color;
+
+out vec2 texUV;
+out vec4 vertexColor;
+
+void main() {
+  gl_Position = vec4(position.x * 2.0 - 1.0, 1.0 - position.y * 2.0, 0.0, 1.0);
+  texUV = uv;
+  vertexColor = color;
+}
+)";
+
+    const GLchar* fs_source = R"(#version 330 core
+
+in vec2 texUV;
+in vec4 vertexColor;
+out vec4 frag_color;
+
+uniform sampler2D tex;
+uniform int textured;
+void main() {
+  frag_color = (textured != 0) ? vertexColor * texture(tex, texUV) : vertexColor;
+}
+)";
+
+    return shaderManager().buildProgram("overlay", vs_source, fs_source, program) ? GL_TRUE : GL_FALSE;
+}
+
+// Runs on a worker thread (see init); must not touch GL
+int RenderContext::rasterizeGlyphs(void) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    // Load TrueType fonts
+    FT_Library ft;
+    if (FT_Init_FreeType(&ft)) {
+        cout << "ERROR::FREETYPE: Could not init FreeType Library" << endl;
+        return GL_FALSE;
+    }
+
+    FT_Face face;
+    if (FT_New_Face(ft, "/usr/share/fonts/truetype/ubuntu-font-family/Ubuntu-R.ttf", 0, &face)) {
+        cout << "ERROR::FREETYPE: Failed to load font" << endl;
+        FT_Done_FreeType(ft);
+        return GL_FALSE;
+    }
+    FT_Set_Pixel_Sizes(face, 0, 48); // width decided by lib
+
+    mGlyphBitmaps.clear();
+    mGlyphBitmaps.reserve(128);
+    for (GLubyte c = 0; c < 128; c++) {
+        // Load character glyph
+        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
+            cout << "ERROR::FREETYTPE: Failed to load Glyph" << endl;
+            continue;
+        }
+        const FT_Bitmap& bm = face->glyph->bitmap;
+        GlyphBitmap glyph;
+        glyph.c       = c;
+        glyph.Size    = glm::ivec2(bm.width, bm.rows);
+        glyph.Bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+        glyph.Advance = (GLuint)face->glyph->advance.x;
+        // Copy out tightly packed rows; the FreeType buffer is reused by the next FT_Load_Char
+        glyph.pixels.resize(bm.width * bm.rows);
+        for (unsigned int row = 0; row < bm.rows; row++)
+            memcpy(&glyph.pixels[row * bm.width], bm.buffer + row * bm.pitch, bm.width);
+        mGlyphBitmaps.push_back(glyph);
+    }
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft);
+    mFontRasterMs = lapMs(t);
+    return GL_TRUE;
+}
+
+// Waits for rasterizeGlyphs() and uploads one texture per glyph
+int RenderContext::loadFonts(StartupTimings* timings) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    if (!mFontJob.valid() || mFontJob.get() == GL_FALSE)
+        return GL_FALSE;
+    timings->fontWait = lapMs(t);
+
+    gltPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Glyph rows are tightly packed
+
+    for (auto& glyph: mGlyphBitmaps) {
+        // Generate texture
+        GLuint texture;
+        gltGenTextures(1, &texture);
+        gltBindTexture(GL_TEXTURE_2D, texture);
+        gltTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     GL_RED,
+                     glyph.Size.x,
+                     glyph.Size.y,
+                     0,
+                     GL_RED,
+                     GL_UNSIGNED_BYTE,
+                     glyph.pixels.empty() ? NULL : &glyph.pixels[0]
+        );
+        // Set texture options
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gltTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Now store character for later use
+        Character character = {
+            texture,
+            glyph.Size,
+            glyph.Bearing,
+            glyph.Advance
+        };
+        mCharacters.insert(pair<GLchar, Character>(glyph.c, character));
+    }
+    gltUnpackDefaults();
+    mGlyphBitmaps.clear();
+    mGlyphBitmaps.shrink_to_fit();
+    timings->fontRaster = mFontRasterMs;
+    timings->glyphUpload = lapMs(t);
+    return GL_TRUE;
+}
@@ -0,0 +1,345 @@
+/*
+ * shader_manager.cpp
+ *
+ *      Author: maheriya
+ * Description: GLSL program builder with an on-disk program binary cache
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include "gl_trace.hpp"
+#include "shader_manager.hpp"
+
+using namespace std;
+
+#define SHADER_CACHE_MAGIC "GLRPROG1"
+
+// On-disk layout: header followed by 'length' bytes of driver specific program binary
+struct ShaderCacheHeader {
+    char     magic[8];
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+static double msSince(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+// FNV-1a, 64 bit
+static uint64_t fnv1a(uint64_t h, const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// mkdir -p
+static bool makeDirs(const string& path) {
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos == path.size() || path[pos] == '/') {
+            string dir = path.substr(0, pos);
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool readFile(const char* path, string& contents) {
+    ifstream stream(path, ios::in);
+    if (!stream.is_open())
+        return false;
+    stringstream sstr;
+    sstr << stream.rdbuf();
+    contents = sstr.str();
+    return true;
+}
+
+ShaderManager& shaderManager(void) {
+    static ShaderManager manager;
+    return manager;
+}
+
+ShaderManager::ShaderManager(void) :
+    mBinarySupported(false),
+    mDriverQueried(false),
+    mBatching(false) {
+    memset(&mStats, 0, sizeof(mStats));
+
+    // GL_RENDER_SHADER_CACHE overrides the location; set it empty to disable the cache
+    const char* env = getenv("GL_RENDER_SHADER_CACHE");
+    if (env != NULL) {
+        mCacheDir = env;
+    } else if ((env = getenv("XDG_CACHE_HOME")) != NULL && env[0] != '\0') {
+        mCacheDir = string(env) + "/gl-render/shaders";
+    } else if ((env = getenv("HOME")) != NULL && env[0] != '\0') {
+        mCacheDir = string(env) + "/.cache/gl-render/shaders";
+    }
+}
+
+void ShaderManager::setCacheDir(const string& dir) {
+    mCacheDir = dir;
+}
+
+void ShaderManager::queryDriver(void) {
+    if (mDriverQueried)
+        return;
+    mDriverQueried = true;
+
+    if (gltIsNoop())
+        return; // nothing to cache without a driver
+
+    const GLenum ids[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    for (GLenum id: ids) {
+        const GLubyte* str = gltGetString(id);
+        mDriverId += (str != NULL) ? (const char*)str : "?";
+        mDriverId += '\n';
+    }
+
+    GLint numFormats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+        gltGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    mBinarySupported = (numFormats > 0);
+    if (!mBinarySupported)
+        printf("Shader cache: program binaries not supported by driver\n");
+}
+
+uint64_t ShaderManager::programKey(const char* vs_source, const char* fs_source) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    // Include the terminating NULs so that moving text between the stages changes the key
+    h = fnv1a(h, vs_source, strlen(vs_source) + 1);
+    h = fnv1a(h, fs_source, strlen(fs_source) + 1);
+    h = fnv1a(h, mDriverId.c_str(), mDriverId.size());
+    return h;
+}
+
+string ShaderManager::cachePath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016" PRIx64 ".bin", key);
+    return mCacheDir + name;
+}
+
+int ShaderManager::loadBinary(const char* name, uint64_t key, GLuint program) {
+    string path = cachePath(key);
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+        return SHADER_CACHE_MISS;
+
+    ShaderCacheHeader hdr;
+    vector<char> binary;
+    bool valid = (fread(&hdr, sizeof(hdr), 1, fp) == 1) &&
+                 (memcmp(hdr.magic, SHADER_CACHE_MAGIC, sizeof(hdr.magic)) == 0) &&
+                 (hdr.key == key) && (hdr.length > 0);
+    if (valid) {
+        binary.resize(hdr.length);
+        valid = (fread(&binary[0], 1, hdr.length, fp) == hdr.length);
+    }
+    fclose(fp);
+
+    if (valid) {
+        gltProgramBinary(program, hdr.format, &binary[0], hdr.length);
+        // Drivers reject binaries freely (e.g. after an update); that is not an error
+        if (checkLinked(name, program, false))
+            return SHADER_CACHE_HIT;
+    }
+    unlink(path.c_str()); // stale or corrupt; rewritten after the recompile
+    return SHADER_CACHE_REJECT;
+}
+
+void ShaderManager::storeBinary(uint64_t key, GLuint program) {
+    GLint length = 0;
+    gltGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    ShaderCacheHeader hdr;
+    memcpy(hdr.magic, SHADER_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.key = key;
+    vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    gltGetProgramBinary(program, length, &written, &format, &binary[0]);
+    if (written <= 0)
+        return;
+    hdr.format = format;
+    hdr.length = written;
+
+    if (!makeDirs(mCacheDir)) {
+        printf("Shader cache: could not create %s\n", mCacheDir.c_str());
+        return;
+    }
+    // Write to a temporary file first so that a concurrent reader never sees a partial entry
+    string path = cachePath(key);
+    string tmp = path + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (fp == NULL)
+        return;
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1) &&
+              (fwrite(&binary[0], 1, written, fp) == (size_t)written);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        unlink(tmp.c_str());
+}
+
+// Only issues the compile; the status is checked (if needed) in finishProgram()
+GLuint ShaderManager::compileShader(GLenum type, const char* source) {
+    GLuint shader = gltCreateShader(type);
+    gltShaderSource(shader, 1, &source, NULL);
+    gltCompileShader(shader);
+    return shader;
+}
+
+bool ShaderManager::checkCompiled(const char* name, GLenum type, GLuint shader) {
+    GLint compile_ok = GL_FALSE;
+    gltGetShaderiv(shader, GL_COMPILE_STATUS, &compile_ok);
+    if (compile_ok == GL_FALSE) {
+        GLint logLength = 0;
+        gltGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        vector<char> log(logLength + 1, '\0');
+        if (logLength > 0)
+            gltGetShaderInfoLog(shader, logLength, NULL, &log[0]);
+        printf("%s: %s shader compilation failed\n%s\n", name,
+               (type == GL_VERTEX_SHADER) ? "vertex" : "fragment", &log[0]);
+    }
+    return (compile_ok != GL_FALSE);
+}
+
+bool ShaderManager::checkLinked(const char* name, GLuint program, bool verbose) {
+    GLint link_ok = GL_FALSE;
+    gltGetProgramiv(program, GL_LINK_STATUS, &link_ok);
+    if (link_ok == GL_FALSE && verbose) {
+        GLint logLength = 0;
+        gltGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+        vector<char> log(logLength + 1, '\0');
+        if (logLength > 0)
+            gltGetProgramInfoLog(program, logLength, NULL, &log[0]);
+        printf("%s: program link failed\n%s\n", name, &log[0]);
+    }
+    return (link_ok != GL_FALSE);
+}
+
+void ShaderManager::beginBatch(void) {
+    queryDriver();
+    if (!mStats.parallel && !gltIsNoop() &&
+        (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)) {
+        gltMaxShaderCompilerThreads(0xFFFFFFFF);
+        mStats.parallel = true;
+    }
+    mBatching = true;
+}
+
+bool ShaderManager::endBatch(void) {
+    bool ok = true;
+    for (auto& p: mPending)
+        ok = finishProgram(p) && ok;
+    mPending.clear();
+    mBatching = false;
+    return ok;
+}
+
+// First status query on the program; blocks until the driver is done with it
+bool ShaderManager::finishProgram(PendingProgram& p) {
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    const char* name = p.name.c_str();
+    GLuint program = *p.program;
+    bool linked = checkLinked(name, program, false);
+    if (!linked) {
+        // Logs are only fetched on failure. A stage that did not compile explains the link error.
+        bool vs_ok = checkCompiled(name, GL_VERTEX_SHADER, p.vs);
+        bool fs_ok = checkCompiled(name, GL_FRAGMENT_SHADER, p.fs);
+        if (vs_ok && fs_ok)
+            checkLinked(name, program, true);
+    }
+    gltDetachShader(program, p.fs);
+    gltDetachShader(program, p.vs);
+    gltDeleteShader(p.vs);
+    gltDeleteShader(p.fs);
+
+    if (!linked) {
+        p.program->reset(); // through the owner's handle, so nothing holds the deleted name
+        mStats.failures++;
+    } else if (p.useCache) {
+        storeBinary(p.key, program);
+    }
+    mStats.compileMs += msSince(t0);
+    return linked;
+}
+
+bool ShaderManager::buildProgram(const char* name, const char* vs_source, const char* fs_source, GLProgram& program) {
+    queryDriver();
+    PendingProgram p;
+    p.name = name;
+    p.useCache = mBinarySupported && !mCacheDir.empty();
+    p.key = 0;
+    p.program = &program;
+    program = GLProgram::create();
+
+    if (p.useCache) {
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        p.key = programKey(vs_source, fs_source);
+        int ret = loadBinary(name, p.key, program);
+        if (ret == SHADER_CACHE_HIT) {
+            mStats.hits++;
+            mStats.loadMs += msSince(t0);
+            return true;
+        }
+        if (ret == SHADER_CACHE_REJECT) {
+            // A failed glProgramBinary leaves the program unlinked; start from a fresh object
+            mStats.rejects++;
+            program = GLProgram::create();
+        } else {
+            mStats.misses++;
+        }
+    } else {
+        mStats.misses++;
+    }
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    p.vs = compileShader(GL_VERTEX_SHADER, vs_source);
+    p.fs = compileShader(GL_FRAGMENT_SHADER, fs_source);
+    if (p.useCache)
+        gltProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    gltAttachShader(program, p.fs);
+    gltAttachShader(program, p.vs);
+    gltLinkProgram(program);
+    mStats.compileMs += msSince(t0);
+
+    if (mBatching) {
+        mPending.push_back(p);
+        return true;
+    }
+    return finishProgram(p);
+}
+
+GLuint ShaderManager::loadProgram(const char* vertex_file_path, const char* fragment_file_path) {
+    string vs_source, fs_source;
+    if (!readFile(vertex_file_path, vs_source)) {
+        printf("Impossible to open %s. Are you in the right directory ?\n", vertex_file_path);
+        return 0;
+    }
+    if (!readFile(fragment_file_path, fs_source)) {
+        printf("Impossible to open %s. Are you in the right directory ?\n", fragment_file_path);
+        return 0;
+    }
+    GLProgram program;
+    if (!buildProgram(vertex_file_path, vs_source.c_str(), fs_source.c_str(), program))
+        return 0;
+    return program.release();
+}
+
+void ShaderManager::printStats(void) const {
+    printf("Shader cache (%s): %u hits, %u misses, %u rejected, %u failed; compile %.1f ms%s, load %.1f ms\n",
+           (mBinarySupported && !mCacheDir.empty()) ? mCacheDir.c_str() : "disabled",
+           mStats.hits, mStats.misses, mStats.rejects, mStats.failures,
+           mStats.compileMs, mStats.parallel ? " (parallel)" : "", mStats.loadMs);
+}
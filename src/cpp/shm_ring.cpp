@@ -0,0 +1,398 @@
+/*
+ * shm_ring.cpp
+ *
+ *      Author: maheriya
+ * Description: Shared memory frame ring: producer side and memory-mapped reader
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <new>
+#include "shm_ring.hpp"
+
+using namespace std;
+
+#define SHM_CHECK_PRODUCER 128 // idle polls between checks that the producer is still alive
+
+static_assert(sizeof(ShmRingHeader) <= SHM_PAGE, "ring header must fit its page");
+
+static size_t pageUp(size_t bytes) {
+    return (bytes + SHM_PAGE - 1) / SHM_PAGE * SHM_PAGE;
+}
+
+// shm_open() names start with a slash
+static string shmName(const char* name) {
+    return (name[0] == '/') ? string(name) : "/" + string(name);
+}
+
+static int frameRows(int format, int height) {
+    return (format == SHM_FORMAT_NV12 || format == SHM_FORMAT_I420) ? height * 3 / 2 : height;
+}
+
+size_t shmFrameBytes(int format, int width, int height) {
+    if (width <= 0 || height <= 0)
+        return 0;
+    switch (format) {
+    case SHM_FORMAT_GRAY: return (size_t)width * height;
+    case SHM_FORMAT_BGR:  return (size_t)width * height * 3;
+    case SHM_FORMAT_BGRA: return (size_t)width * height * 4;
+    case SHM_FORMAT_NV12:
+    case SHM_FORMAT_I420: return ((width | height) & 1) ? 0 : (size_t)width * height * 3 / 2;
+    default:              return 0;
+    }
+}
+
+cv::Mat ShmFrame::mat(void) const {
+    int type = (format == SHM_FORMAT_BGR) ? CV_8UC3 : (format == SHM_FORMAT_BGRA) ? CV_8UC4 : CV_8UC1;
+    return cv::Mat(frameRows(format, height), width, type, (void*)data, step);
+}
+
+//-------------------------------------------------------------------------------------
+// Writer
+//-------------------------------------------------------------------------------------
+ShmRingWriter::ShmRingWriter(void) :
+    mFd(-1),
+    mData(NULL),
+    mSize(0),
+    mHeader(NULL),
+    mNext(0),
+    mWriting(false) { }
+
+ShmRingWriter::~ShmRingWriter(void) {
+    close();
+}
+
+bool ShmRingWriter::create(const char* name, uint32_t slots, uint32_t width, uint32_t height, uint32_t maxBoxes) {
+    close();
+    if (slots < 2 || width == 0 || height == 0) {
+        printf("ShmRingWriter: need at least 2 slots and a frame size\n");
+        return false;
+    }
+    mName = shmName(name);
+    shm_unlink(mName.c_str()); // left behind by a producer that did not close
+    mFd = shm_open(mName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (mFd < 0) {
+        printf("ShmRingWriter: could not create %s (%s)\n", mName.c_str(), strerror(errno));
+        return false;
+    }
+    uint64_t pixelOffset = pageUp(sizeof(ShmSlot) + (size_t)maxBoxes * sizeof(ShmBox));
+    uint64_t pixelBytes = pageUp((size_t)width * height * 4);
+    uint64_t slotSize = pixelOffset + pixelBytes;
+    mSize = SHM_PAGE + slots * slotSize;
+    if (ftruncate(mFd, (off_t)mSize) != 0) {
+        printf("ShmRingWriter: could not size %s to %zu bytes (%s)\n", mName.c_str(), mSize, strerror(errno));
+        close();
+        return false;
+    }
+    void* data = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (data == MAP_FAILED) {
+        printf("ShmRingWriter: could not map %s (%s)\n", mName.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+    mData = (uint8_t*)data;
+
+    // The pages come zeroed: every slot starts at sequence 0 (never written)
+    mHeader = new (mData) ShmRingHeader();
+    mHeader->version = SHM_VERSION;
+    mHeader->headerSize = sizeof(ShmRingHeader);
+    mHeader->slotHeaderSize = sizeof(ShmSlot);
+    mHeader->boxSize = sizeof(ShmBox);
+    mHeader->slots = slots;
+    mHeader->maxBoxes = maxBoxes;
+    mHeader->width = width;
+    mHeader->height = height;
+    mHeader->slotSize = slotSize;
+    mHeader->pixelOffset = pixelOffset;
+    mHeader->pixelBytes = pixelBytes;
+    mHeader->producer = (int32_t)getpid();
+    for (uint32_t i = 0; i < slots; i++)
+        new (mData + SHM_PAGE + i * slotSize) ShmSlot();
+    // Readers check the magic first: it goes in last
+    atomic_thread_fence(memory_order_release);
+    memcpy(mHeader->magic, SHM_MAGIC, sizeof(mHeader->magic));
+    mNext = 0;
+    mWriting = false;
+    printf("Shared memory ring %s: %u slots of %ux%u, %.1f MB\n", mName.c_str(), slots, width, height, mSize / 1e6);
+    return true;
+}
+
+void ShmRingWriter::close(void) {
+    if (mHeader != NULL)
+        mHeader->closed.store(1, memory_order_release);
+    if (mData != NULL)
+        munmap(mData, mSize);
+    if (mFd >= 0) {
+        ::close(mFd);
+        shm_unlink(mName.c_str());
+    }
+    mFd = -1;
+    mData = NULL;
+    mSize = 0;
+    mHeader = NULL;
+}
+
+uint8_t* ShmRingWriter::beginFrame(int format, int width, int height, size_t* step) {
+    if (mHeader == NULL)
+        return NULL;
+    size_t bytes = shmFrameBytes(format, width, height);
+    if (bytes == 0 || bytes > mHeader->pixelBytes) {
+        printf("ShmRingWriter: %dx%d frame of format %d does not fit the ring\n", width, height, format);
+        return NULL;
+    }
+    uint8_t* base = mData + SHM_PAGE + (mNext % mHeader->slots) * mHeader->slotSize;
+    ShmSlot* s = (ShmSlot*)base;
+    // Odd: readers that get to this slot from now on see it as being rewritten
+    s->sequence.store(2 * mNext + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->format = format;
+    s->width = width;
+    s->height = height;
+    s->step = (uint32_t)(bytes / frameRows(format, height));
+    *step = s->step;
+    mWriting = true;
+    return base + mHeader->pixelOffset;
+}
+
+bool ShmRingWriter::endFrame(uint64_t frameId, double timestamp, const vector<Detection>& dets) {
+    if (!mWriting)
+        return false;
+    ShmSlot* s = (ShmSlot*)(mData + SHM_PAGE + (mNext % mHeader->slots) * mHeader->slotSize);
+    ShmBox* boxes = (ShmBox*)(s + 1);
+    size_t count = min(dets.size(), (size_t)mHeader->maxBoxes);
+    for (size_t i = 0; i < count; i++) {
+        const Detection& d = dets[i];
+        ShmBox& b = boxes[i];
+        b.xmin = d.xmin;
+        b.ymin = d.ymin;
+        b.xmax = d.xmax;
+        b.ymax = d.ymax;
+        b.color[0] = d.color.x;
+        b.color[1] = d.color.y;
+        b.color[2] = d.color.z;
+        b.score = d.score;
+        b.track = d.track;
+        b.classId = d.classId;
+        strncpy(b.label, d.label.c_str(), SHM_LABEL_CHARS - 1);
+        b.label[SHM_LABEL_CHARS - 1] = '\0';
+    }
+    s->frameId = frameId;
+    s->timestamp = timestamp;
+    s->count = (uint32_t)count;
+    s->sequence.store(2 * mNext + 2, memory_order_release);
+    mNext++;
+    mHeader->published.store(mNext, memory_order_release);
+    mWriting = false;
+    return true;
+}
+
+bool ShmRingWriter::write(const cv::Mat& frame, int format, uint64_t frameId, double timestamp,
+                          const vector<Detection>& dets) {
+    int height = (format == SHM_FORMAT_NV12 || format == SHM_FORMAT_I420) ? frame.rows * 2 / 3 : frame.rows;
+    if (frame.depth() != CV_8U || frameRows(format, height) != frame.rows ||
+        shmFrameBytes(format, frame.cols, height) != frame.total() * frame.elemSize()) {
+        printf("ShmRingWriter: frame does not match format %d\n", format);
+        return false;
+    }
+    size_t step;
+    uint8_t* pixels = beginFrame(format, frame.cols, height, &step);
+    if (pixels == NULL)
+        return false;
+    if (frame.isContinuous()) {
+        memcpy(pixels, frame.data, step * frame.rows);
+    } else {
+        for (int y = 0; y < frame.rows; y++)
+            memcpy(pixels + y * step, frame.ptr(y), step);
+    }
+    return endFrame(frameId, timestamp, dets);
+}
+
+//-------------------------------------------------------------------------------------
+// Reader
+//-------------------------------------------------------------------------------------
+ShmRingReader::ShmRingReader(void) :
+    mFd(-1),
+    mData(NULL),
+    mSize(0),
+    mHeader(NULL),
+    mNext(0),
+    mDevice(0),
+    mInode(0),
+    mStats() { }
+
+ShmRingReader::~ShmRingReader(void) {
+    close();
+}
+
+bool ShmRingReader::open(const char* name) {
+    mName = shmName(name);
+    if (!map(mName.c_str())) {
+        printf("ShmRingReader: %s is not a frame ring (or there is no producer yet)\n", mName.c_str());
+        return false;
+    }
+    printf("Shared memory ring %s: %u slots of %ux%u from process %d\n", mName.c_str(), mHeader->slots,
+           mHeader->width, mHeader->height, mHeader->producer);
+    return true;
+}
+
+void ShmRingReader::close(void) {
+    if (mData != NULL)
+        munmap(mData, mSize);
+    if (mFd >= 0)
+        ::close(mFd);
+    mFd = -1;
+    mData = NULL;
+    mSize = 0;
+    mHeader = NULL;
+}
+
+bool ShmRingReader::map(const char* name) {
+    close();
+    mFd = shm_open(name, O_RDONLY, 0);
+    if (mFd < 0)
+        return false;
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || (size_t)st.st_size < SHM_PAGE) {
+        close();
+        return false;
+    }
+    mSize = st.st_size;
+    mDevice = st.st_dev;
+    mInode = st.st_ino;
+    void* data = mmap(NULL, mSize, PROT_READ, MAP_SHARED, mFd, 0);
+    if (data == MAP_FAILED) {
+        mData = NULL;
+        close();
+        return false;
+    }
+    mData = (uint8_t*)data;
+    const ShmRingHeader* h = (const ShmRingHeader*)mData;
+    bool valid = memcmp(h->magic, SHM_MAGIC, sizeof(h->magic)) == 0;
+    atomic_thread_fence(memory_order_acquire);
+    valid = valid && h->version == SHM_VERSION && h->headerSize == sizeof(ShmRingHeader) &&
+            h->slotHeaderSize == sizeof(ShmSlot) && h->boxSize == sizeof(ShmBox) && h->slots >= 2 &&
+            h->pixelOffset >= sizeof(ShmSlot) + (uint64_t)h->maxBoxes * sizeof(ShmBox) &&
+            h->slotSize == h->pixelOffset + h->pixelBytes && SHM_PAGE + h->slots * h->slotSize <= mSize;
+    if (!valid) {
+        close();
+        return false;
+    }
+    mHeader = h;
+    // Start with the newest frame already there
+    uint64_t published = mHeader->published.load(memory_order_acquire);
+    mNext = (published > 0) ? published - 1 : 0;
+    return true;
+}
+
+// True if 'name' now refers to another ring than the one mapped (a producer created it anew)
+bool ShmRingReader::replaced(const char* name) const {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool other = fstat(fd, &st) == 0 && (st.st_dev != mDevice || st.st_ino != mInode);
+    ::close(fd);
+    return other;
+}
+
+const ShmSlot* ShmRingReader::slot(uint32_t i) const {
+    return (const ShmSlot*)(mData + SHM_PAGE + i * mHeader->slotSize);
+}
+
+bool ShmRingReader::acquire(ShmFrame& frame) {
+    if (mHeader == NULL && (mName.empty() || !map(mName.c_str()))) {
+        mStats.idle++;
+        return false;
+    }
+    uint64_t published = mHeader->published.load(memory_order_acquire);
+    if (published <= mNext) {
+        // Nothing new. A closed ring, or one whose producer died, may have been replaced by a
+        // new producer under the same name. Until then the old one stays mapped, and what was
+        // handed out stays handed out.
+        mStats.idle++;
+        bool gone = mHeader->closed.load(memory_order_acquire) != 0;
+        if (!gone && (mStats.idle % SHM_CHECK_PRODUCER) == 0)
+            gone = kill(mHeader->producer, 0) != 0 && errno == ESRCH;
+        if (gone && replaced(mName.c_str())) {
+            string name = mName;
+            if (map(name.c_str()))
+                mStats.reopens++;
+        }
+        return false;
+    }
+
+    // Newest first; older frames are only tried when the newer slots are being rewritten
+    uint32_t slots = mHeader->slots;
+    uint64_t oldest = max(mNext, (published > slots) ? published - slots : (uint64_t)0);
+    for (uint64_t n = published; n-- > oldest; ) {
+        uint32_t i = (uint32_t)(n % slots);
+        const ShmSlot* s = slot(i);
+        uint64_t seq = s->sequence.load(memory_order_acquire);
+        if (seq != 2 * n + 2) {
+            mStats.stale++;
+            continue;
+        }
+        frame.format = s->format;
+        frame.width = s->width;
+        frame.height = s->height;
+        frame.step = s->step;
+        frame.frameId = s->frameId;
+        frame.timestamp = s->timestamp;
+        uint32_t count = min(s->count, mHeader->maxBoxes);
+        const ShmBox* boxes = (const ShmBox*)(s + 1);
+        frame.dets.resize(count);
+        for (uint32_t k = 0; k < count; k++) {
+            const ShmBox& b = boxes[k];
+            Detection& d = frame.dets[k];
+            d.xmin = b.xmin;
+            d.ymin = b.ymin;
+            d.xmax = b.xmax;
+            d.ymax = b.ymax;
+            d.color = glm::vec3(b.color[0], b.color[1], b.color[2]);
+            d.label.assign(b.label, strnlen(b.label, SHM_LABEL_CHARS));
+            d.score = b.score;
+            d.track = b.track;
+            d.timestamp = 0.0; // the producer's clock is not ours
+            d.classId = b.classId;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (s->sequence.load(memory_order_relaxed) != seq) {
+            mStats.stale++;
+            continue;
+        }
+        size_t bytes = shmFrameBytes(frame.format, frame.width, frame.height);
+        if (bytes == 0 || (size_t)frame.step * frameRows(frame.format, frame.height) > mHeader->pixelBytes) {
+            mStats.stale++; // not a frame we can show
+            continue;
+        }
+        frame.data = (const uint8_t*)s + mHeader->pixelOffset;
+        frame.sequence = n;
+        frame.slot = i;
+        mStats.skipped += n - mNext;
+        mStats.frames++;
+        mNext = n + 1;
+        return true;
+    }
+    // The producer went round the ring before any of them could be read
+    mStats.skipped += oldest - mNext;
+    mNext = published;
+    return false;
+}
+
+bool ShmRingReader::release(const ShmFrame& frame) {
+    if (mHeader == NULL)
+        return false;
+    atomic_thread_fence(memory_order_acquire);
+    if (slot(frame.slot)->sequence.load(memory_order_relaxed) != 2 * frame.sequence + 2) {
+        mStats.overruns++;
+        return false;
+    }
+    return true;
+}
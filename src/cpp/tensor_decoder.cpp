@@ -0,0 +1,510 @@
+/*
+ * tensor_decoder.cpp
+ *
+ *      Author: maheriya
+ * Description: Bulk decoding of YOLO/SSD/[N, 6] detector outputs into Detection records
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include "tensor_decoder.hpp"
+#include "box_simd.hpp"
+
+using namespace std;
+
+#define MAX_CLASS_ID 65535
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+//-------------------------------------------------------------------------------------
+// Bulk exp/sigmoid: Cephes-style range reduction and polynomial (relative error ~2e-7)
+//-------------------------------------------------------------------------------------
+#define EXP_HI      88.3762626647949f
+#define EXP_LO     -87.3365478515625f // keeps 2^n a normal float
+#define EXP_LOG2E   1.44269504088896341f
+#define EXP_C1      0.693359375f
+#define EXP_C2     -2.12194440e-4f
+#define EXP_P0      1.9875691500e-4f
+#define EXP_P1      1.3981999507e-3f
+#define EXP_P2      8.3334519073e-3f
+#define EXP_P3      4.1665795894e-2f
+#define EXP_P4      1.6666665459e-1f
+#define EXP_P5      5.0000001201e-1f
+
+#if defined(__AVX2__)
+#define EXP_LANES 8
+static inline __m256 exp8(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    // n = round(x / ln 2), x = x - n ln 2
+    __m256 fx = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)), _mm256_set1_ps(0.5f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(EXP_C1)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(EXP_C2)));
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(EXP_P0);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P1));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P2));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P3));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P4));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P5));
+    y = _mm256_add_ps(_mm256_mul_ps(y, z), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    // * 2^n
+    __m256i n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(0x7f)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+}
+#define vexp(x) exp8(x)
+#elif defined(__SSE2__)
+#define EXP_LANES 4
+static inline __m128 exp4(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+    // n = round(x / ln 2) (floor by truncation and correction: no SSE4.1), x = x - n ln 2
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)), _mm_set1_ps(0.5f));
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, fx), _mm_set1_ps(1.0f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(EXP_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+    y = _mm_add_ps(_mm_mul_ps(y, z), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+    // * 2^n
+    __m128i n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(n));
+}
+#define vexp(x) exp4(x)
+#endif
+
+void expArray(const float* in, float* out, size_t n) {
+    size_t i = 0;
+#ifdef EXP_LANES
+#if EXP_LANES == 8
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, vexp(_mm256_loadu_ps(in + i)));
+#else
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, vexp(_mm_loadu_ps(in + i)));
+#endif
+#endif
+    for (; i < n; i++)
+        out[i] = expf(in[i]);
+}
+
+void sigmoidArray(const float* in, float* out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = -in[i];
+    expArray(out, out, n);
+    for (size_t i = 0; i < n; i++)
+        out[i] = 1.0f / (1.0f + out[i]);
+}
+
+// Largest of p[0 .. n)
+static float rowMax(const float* p, int n) {
+    float m = -FLT_MAX;
+    int i = 0;
+#ifdef BOX_LANES
+    if (n >= BOX_LANES) {
+        vfloat vm = vload(p);
+        for (i = BOX_LANES; i + BOX_LANES <= n; i += BOX_LANES)
+            vm = vmax(vm, vload(p + i));
+        float lanes[BOX_LANES];
+        vstore(lanes, vm);
+        for (int l = 0; l < BOX_LANES; l++)
+            m = max(m, lanes[l]);
+    }
+#endif
+    for (; i < n; i++)
+        m = max(m, p[i]);
+    return m;
+}
+
+// Index of the first m in p[0 .. n)
+static int indexOf(const float* p, int n, float m) {
+    int i = 0;
+    while (i < n - 1 && p[i] != m)
+        i++;
+    return i;
+}
+
+// Index of the largest of p[0 .. n); its value in *best
+static int argmax(const float* p, int n, float* best) {
+    *best = rowMax(p, n);
+    return indexOf(p, n, *best);
+}
+
+// Same, over p[0], p[stride], ...
+static int argmaxStrided(const float* p, int n, size_t stride, float* best) {
+    int idx = 0;
+    float m = p[0];
+    for (int i = 1; i < n; i++) {
+        if (p[i * stride] > m) {
+            m = p[i * stride];
+            idx = i;
+        }
+    }
+    *best = m;
+    return idx;
+}
+
+static float logit(float p) {
+    if (p <= 0.0f)
+        return -FLT_MAX;
+    if (p >= 1.0f)
+        return FLT_MAX;
+    return logf(p / (1.0f - p));
+}
+
+// Well separated hues (golden ratio steps), fairly saturated
+static glm::vec3 paletteColor(int i) {
+    float h = fmodf(0.1f + 0.618034f * i, 1.0f) * 6.0f;
+    float s = 0.75f, v = 1.0f;
+    int sector = (int)h;
+    float f = h - sector;
+    float p = v * (1.0f - s), q = v * (1.0f - s * f), t = v * (1.0f - s * (1.0f - f));
+    switch (sector) {
+    case 0:  return glm::vec3(v, t, p);
+    case 1:  return glm::vec3(q, v, p);
+    case 2:  return glm::vec3(p, v, t);
+    case 3:  return glm::vec3(p, q, v);
+    case 4:  return glm::vec3(t, p, v);
+    default: return glm::vec3(v, p, q);
+    }
+}
+
+//-------------------------------------------------------------------------------------
+// Decoder
+//-------------------------------------------------------------------------------------
+TensorDecoder::TensorDecoder(void) :
+    mLayout(DECODE_BOXES),
+    mClasses(0),
+    mScoreThreshold(0.25f),
+    mInputWidth(1),
+    mInputHeight(1),
+    mStats(),
+    mObjectness(true),
+    mWHMode(YOLO_SIGMOID_WH),
+    mChannelsFirst(false),
+    mAnchors(0),
+    mActivation(SSD_SOFTMAX),
+    mVariance(0.1f, 0.2f),
+    mNormalized(true) { }
+
+void TensorDecoder::setLabels(const vector<string>& labels) {
+    mLabels = labels;
+    mColors.resize(mLabels.size());
+    for (size_t i = 0; i < mLabels.size(); i++)
+        mColors[i] = paletteColor((int)i);
+}
+
+void TensorDecoder::setColor(int classId, glm::vec3 color) {
+    label(classId); // makes the entry
+    mColors[classId] = color;
+}
+
+const string& TensorDecoder::label(int classId) {
+    char name[32];
+    while ((int)mLabels.size() <= classId) {
+        sprintf(name, "class %d", (int)mLabels.size());
+        mLabels.push_back(name);
+        mColors.push_back(paletteColor((int)mColors.size()));
+    }
+    return mLabels[classId];
+}
+
+glm::vec3 TensorDecoder::color(int classId) {
+    label(classId);
+    return mColors[classId];
+}
+
+bool TensorDecoder::setYolo(const vector<YoloLevel>& levels, int classes, bool objectness,
+                            int whMode, bool channelsFirst) {
+    if (classes <= 0 || levels.empty() || mInputWidth <= 1 || mInputHeight <= 1) {
+        printf("TensorDecoder: YOLO needs classes, levels and the input size (setInputSize)\n");
+        return false;
+    }
+    mLayout = DECODE_YOLO;
+    mClasses = classes;
+    mObjectness = objectness;
+    mWHMode = whMode;
+    mChannelsFirst = channelsFirst;
+
+    // Grid cell, stride and anchor size of every row, in tensor order
+    mGridX.clear(); mGridY.clear(); mStride.clear(); mAnchorW.clear(); mAnchorH.clear();
+    for (size_t l = 0; l < levels.size(); l++) {
+        const YoloLevel& level = levels[l];
+        int gw = mInputWidth / level.stride, gh = mInputHeight / level.stride;
+        for (size_t a = 0; a < level.anchors.size(); a++) {
+            for (int gy = 0; gy < gh; gy++) {
+                for (int gx = 0; gx < gw; gx++) {
+                    mGridX.push_back((float)gx);
+                    mGridY.push_back((float)gy);
+                    mStride.push_back((float)level.stride);
+                    mAnchorW.push_back(level.anchors[a].x);
+                    mAnchorH.push_back(level.anchors[a].y);
+                }
+            }
+        }
+    }
+    mAnchors = (int)mGridX.size();
+    return true;
+}
+
+bool TensorDecoder::setSSD(const float* priors, int count, int classes, int activation, glm::vec2 variance) {
+    if (priors == NULL || count <= 0 || classes < 2) {
+        printf("TensorDecoder: SSD needs priors and at least background + 1 class\n");
+        return false;
+    }
+    mLayout = DECODE_SSD;
+    mClasses = classes;
+    mActivation = activation;
+    mVariance = variance;
+    mPriors.assign(priors, priors + (size_t)count * 4);
+    mAnchors = count;
+    return true;
+}
+
+bool TensorDecoder::setBoxes(bool normalized) {
+    if (!normalized && (mInputWidth <= 1 || mInputHeight <= 1)) {
+        printf("TensorDecoder: pixel boxes need the input size (setInputSize)\n");
+        return false;
+    }
+    mLayout = DECODE_BOXES;
+    mNormalized = normalized;
+    return true;
+}
+
+void TensorDecoder::emit(vector<Detection>& out, int cls, float score, float xmin, float ymin,
+                         float xmax, float ymax, double timestamp) {
+    if (cls < 0 || cls > MAX_CLASS_ID)
+        return;
+    out.resize(out.size() + 1);
+    Detection& d = out.back();
+    d.xmin = xmin; d.ymin = ymin; d.xmax = xmax; d.ymax = ymax;
+    d.label = label(cls);
+    d.color = mColors[cls];
+    d.score = score;
+    d.track = 0;
+    d.timestamp = timestamp;
+    d.classId = cls;
+}
+
+// Rows whose objectness (or best class) logit passes the threshold; since sigmoid is monotonic
+// and the final score is at most either sigmoid, the others cannot pass either
+void TensorDecoder::findYoloCandidates(const float* tensor, float logitThreshold) {
+    int obj = mObjectness ? 1 : 0;
+    int width = 4 + obj + mClasses;
+    size_t A = mAnchors;
+    mRows.clear(); mClassOf.clear(); mClassLogit.clear();
+    mA.clear(); mB.clear(); mC.clear(); mD.clear(); mScore.clear();
+
+    if (!mChannelsFirst) {
+        for (size_t r = 0; r < A; r++) {
+            const float* p = tensor + r * width;
+            if (obj && p[4] < logitThreshold)
+                continue;
+            float best;
+            int cls = argmax(p + 4 + obj, mClasses, &best);
+            if (best < logitThreshold)
+                continue;
+            mRows.push_back((int)r); mClassOf.push_back(cls); mClassLogit.push_back(best);
+            mA.push_back(p[0]); mB.push_back(p[1]); mC.push_back(p[2]); mD.push_back(p[3]);
+            mScore.push_back(obj ? p[4] : 0.0f);
+        }
+        return;
+    }
+
+    // Channels first: one row per channel, so anchors are scanned a vector at a time
+    const float* gate = tensor + 4 * A; // objectness, or running max over the classes
+    vector<float> block;
+    if (!obj) {
+        block.assign(tensor + 4 * A, tensor + 5 * A);
+        for (int c = 1; c < mClasses; c++) {
+            const float* p = tensor + (4 + c) * A;
+            size_t a = 0;
+#ifdef BOX_LANES
+            for (; a + BOX_LANES <= A; a += BOX_LANES)
+                vstore(&block[a], vmax(vload(&block[a]), vload(p + a)));
+#endif
+            for (; a < A; a++)
+                block[a] = max(block[a], p[a]);
+        }
+        gate = &block[0];
+    }
+    for (size_t a = 0; a < A; ) {
+        int mask;
+        int lanes;
+#ifdef BOX_LANES
+        if (a + BOX_LANES <= A) {
+            mask = vgemask(vload(gate + a), vset1(logitThreshold));
+            lanes = BOX_LANES;
+        } else
+#endif
+        {
+            mask = (gate[a] >= logitThreshold) ? 1 : 0;
+            lanes = 1;
+        }
+        for (int l = 0; mask != 0; l++, mask >>= 1) {
+            if (!(mask & 1))
+                continue;
+            size_t r = a + l;
+            float best;
+            int cls = argmaxStrided(tensor + (4 + obj) * A + r, mClasses, A, &best);
+            if (best < logitThreshold)
+                continue;
+            mRows.push_back((int)r); mClassOf.push_back(cls); mClassLogit.push_back(best);
+            mA.push_back(tensor[r]); mB.push_back(tensor[A + r]);
+            mC.push_back(tensor[2 * A + r]); mD.push_back(tensor[3 * A + r]);
+            mScore.push_back(obj ? tensor[4 * A + r] : 0.0f);
+        }
+        a += lanes;
+    }
+}
+
+size_t TensorDecoder::decode(const float* tensor, vector<Detection>& out, int rows, double timestamp) {
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    size_t before = out.size();
+    float thr = mScoreThreshold;
+
+    if (mLayout == DECODE_BOXES) {
+        float sx = mNormalized ? 1.0f : 1.0f / mInputWidth;
+        float sy = mNormalized ? 1.0f : 1.0f / mInputHeight;
+        size_t candidates = 0;
+        for (int r = 0; r < rows; r++) {
+            const float* p = tensor + (size_t)r * 6;
+            if (!(p[4] >= thr))
+                continue;
+            candidates++;
+            emit(out, (int)p[5], p[4], p[0] * sx, p[1] * sy, p[2] * sx, p[3] * sy, timestamp);
+        }
+        mStats.anchors = rows;
+        mStats.candidates = candidates;
+    } else if (mLayout == DECODE_YOLO) {
+        findYoloCandidates(tensor, logit(thr));
+        size_t m = mRows.size();
+        // Activations over the survivors only, as whole arrays
+        sigmoidArray(mClassLogit.data(), mClassLogit.data(), m);
+        if (mObjectness)
+            sigmoidArray(mScore.data(), mScore.data(), m);
+        sigmoidArray(mA.data(), mA.data(), m);
+        sigmoidArray(mB.data(), mB.data(), m);
+        if (mWHMode == YOLO_EXP_WH) {
+            expArray(mC.data(), mC.data(), m);
+            expArray(mD.data(), mD.data(), m);
+        } else {
+            sigmoidArray(mC.data(), mC.data(), m);
+            sigmoidArray(mD.data(), mD.data(), m);
+        }
+        float sx = 1.0f / mInputWidth, sy = 1.0f / mInputHeight;
+        bool v5 = (mWHMode == YOLO_SIGMOID_WH);
+        for (size_t k = 0; k < m; k++) {
+            float score = mObjectness ? mScore[k] * mClassLogit[k] : mClassLogit[k];
+            if (score < thr)
+                continue;
+            int r = mRows[k];
+            float stride = mStride[r];
+            float cx, cy, w, h;
+            if (v5) {
+                cx = (2.0f * mA[k] - 0.5f + mGridX[r]) * stride;
+                cy = (2.0f * mB[k] - 0.5f + mGridY[r]) * stride;
+                w = 4.0f * mC[k] * mC[k] * mAnchorW[r];
+                h = 4.0f * mD[k] * mD[k] * mAnchorH[r];
+            } else {
+                cx = (mA[k] + mGridX[r]) * stride;
+                cy = (mB[k] + mGridY[r]) * stride;
+                w = mC[k] * mAnchorW[r];
+                h = mD[k] * mAnchorH[r];
+            }
+            emit(out, mClassOf[k], score, (cx - 0.5f * w) * sx, (cy - 0.5f * h) * sy,
+                 (cx + 0.5f * w) * sx, (cy + 0.5f * h) * sy, timestamp);
+        }
+        mStats.anchors = mAnchors;
+        mStats.candidates = m;
+    } else {
+        printf("TensorDecoder: SSD output needs decode(loc, conf, ...)\n");
+    }
+
+    mStats.detections = out.size() - before;
+    mStats.decodeMs = msSince(t);
+    return mStats.detections;
+}
+
+size_t TensorDecoder::decode(const float* loc, const float* conf, vector<Detection>& out, double timestamp) {
+    if (mLayout != DECODE_SSD) {
+        printf("TensorDecoder: not configured for SSD (setSSD)\n");
+        return 0;
+    }
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    size_t before = out.size();
+    float thr = mScoreThreshold;
+    // Softmax: score = exp(best - max) / sum <= exp(best - max), so most priors (background
+    // well ahead) are rejected before any exp
+    float logThr = (thr > 0.0f) ? logf(thr) : -FLT_MAX;
+    float logitThr = logit(thr);
+    int C = mClasses;
+    vector<float> row(C);
+
+    mRows.clear(); mClassOf.clear(); mClassLogit.clear();
+    for (int p = 0; p < mAnchors; p++) {
+        const float* c = conf + (size_t)p * C;
+        float best = rowMax(c + 1, C - 1); // class 0 is background
+        float score;
+        if (mActivation == SSD_SOFTMAX) {
+            float top = max(best, c[0]);
+            if (best - top < logThr)
+                continue;
+            for (int k = 0; k < C; k++)
+                row[k] = c[k] - top;
+            expArray(&row[0], &row[0], C);
+            float sum = 0.0f;
+            for (int k = 0; k < C; k++)
+                sum += row[k];
+            score = expf(best - top) / sum;
+            if (score < thr)
+                continue;
+        } else if (mActivation == SSD_SIGMOID) {
+            if (best < logitThr)
+                continue;
+            score = best; // activated in bulk below
+        } else {
+            if (best < thr)
+                continue;
+            score = best;
+        }
+        mRows.push_back(p); mClassOf.push_back(indexOf(c + 1, C - 1, best) + 1); mClassLogit.push_back(score);
+    }
+
+    size_t m = mRows.size();
+    if (mActivation == SSD_SIGMOID)
+        sigmoidArray(mClassLogit.data(), mClassLogit.data(), m);
+    // Box offsets of the survivors; sizes through one bulk exp
+    mC.resize(m); mD.resize(m);
+    for (size_t k = 0; k < m; k++) {
+        const float* l = loc + (size_t)mRows[k] * 4;
+        mC[k] = l[2] * mVariance.y;
+        mD[k] = l[3] * mVariance.y;
+    }
+    expArray(mC.data(), mC.data(), m);
+    expArray(mD.data(), mD.data(), m);
+    for (size_t k = 0; k < m; k++) {
+        int p = mRows[k];
+        const float* l = loc + (size_t)p * 4;
+        const float* prior = &mPriors[(size_t)p * 4];
+        float cx = prior[0] + l[0] * mVariance.x * prior[2];
+        float cy = prior[1] + l[1] * mVariance.x * prior[3];
+        float w = prior[2] * mC[k], h = prior[3] * mD[k];
+        emit(out, mClassOf[k], mClassLogit[k], cx - 0.5f * w, cy - 0.5f * h, cx + 0.5f * w, cy + 0.5f * h, timestamp);
+    }
+
+    mStats.anchors = mAnchors;
+    mStats.candidates = m;
+    mStats.detections = out.size() - before;
+    mStats.decodeMs = msSince(t);
+    return mStats.detections;
+}
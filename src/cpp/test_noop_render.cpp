@@ -0,0 +1,84 @@
+/*
+ * test_noop_render.cpp
+ *
+ *      Author: maheriya
+ * Description: Headless check of the GL trace counters: a DetectionWindow on the no-op GL backend
+ *              shows a 640x360 host image, then the same with one labeled box, and the draws,
+ *              binds and uploaded bytes of those frames are compared with the expected counts.
+ *              Exits 77 (skipped) when the window cannot be set up (e.g. the font is missing).
+ *              Usage: test-noop-render
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "detection_window.hpp"
+
+using namespace std;
+
+#define TEST_WIDTH  640
+#define TEST_HEIGHT 360
+
+#if !GL_TRACE
+#error "test-noop-render checks the GL trace counters: build it with GL_TRACE=1"
+#endif
+
+static int failures = 0;
+
+static void expect(const char* frame, const char* what, uint64_t got, uint64_t expected) {
+    if (got == expected)
+        return;
+    printf("%s: %s %" PRIu64 ", expected %" PRIu64 "\n", frame, what, got, expected);
+    failures++;
+}
+
+static uint64_t binds(const GLTraceCounters& c) {
+    return c.programBinds + c.vaoBinds + c.textureBinds + c.bufferBinds;
+}
+
+int main(void) {
+    gltSetBackend(GLT_BACKEND_NOOP);
+    DetectionWindow win;
+    if (win.createWindow(TEST_WIDTH, TEST_HEIGHT, "test") == GL_FALSE) {
+        printf("Could not set up the window; skipped\n");
+        return 77;
+    }
+    cv::Mat img(TEST_HEIGHT, TEST_WIDTH, CV_8UC3, cv::Scalar(0, 0, 0));
+
+    // The first frame also counts the window's setup; the second is the steady state:
+    // one image quad, drawn from the texture uploaded again
+    win.display(img);
+    win.display(img);
+    const GLTraceCounters& image = win.traceStats().last;
+    expect("image", "draws", image.drawCalls, 1);
+    expect("image", "binds", binds(image), 4);
+    expect("image", "upload bytes", image.uploadBytes, TEST_WIDTH * TEST_HEIGHT * 3);
+    expect("image", "objects created", image.objectsCreated, 0);
+
+    // One box with a 3 character label: image, box outline, label background and a quad per
+    // character. The outline and the background upload 4 vertices of 2 floats each, every
+    // character 4 vertices of 4 floats.
+    Detection det = Detection();
+    det.xmin = 0.25f;
+    det.ymin = 0.25f;
+    det.xmax = 0.5f;
+    det.ymax = 0.75f;
+    det.score = 0.9f;
+    det.label = "car";
+    det.color = glm::vec3(1.0f, 0.0f, 0.0f);
+    win.addDetection(det);
+    win.display(img);
+    const GLTraceCounters& boxed = win.traceStats().last;
+    expect("box", "draws", boxed.drawCalls, 6);
+    expect("box", "binds", binds(boxed), 13);
+    expect("box", "upload bytes", boxed.uploadBytes, TEST_WIDTH * TEST_HEIGHT * 3 +
+           (2 * 4 * 2 + 3 * 4 * 4) * sizeof(GLfloat));
+    expect("box", "frames", win.traceStats().frames, 3);
+
+    win.cleanup();
+    // Every object the window and the shared context made is gone
+    expect("cleanup", "live objects", gltLive.buffers + gltLive.textures + gltLive.vertexArrays +
+           gltLive.framebuffers + gltLive.programs, 0);
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
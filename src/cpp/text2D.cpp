@@ -2,6 +2,7 @@
 #include <cstring>
 
 #include <GL/glew.h>
+#include "gl_trace.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -24,14 +25,14 @@ void initText2D(const char * texturePath) {
     Text2DTextureID = loadDDS(texturePath);
 
     // Initialize VBO
-    glGenBuffers(1, &Text2DVertexBufferID);
-    glGenBuffers(1, &Text2DUVBufferID);
+    gltGenBuffers(1, &Text2DVertexBufferID);
+    gltGenBuffers(1, &Text2DUVBufferID);
 
     // Initialize Shader
     Text2DShaderID = LoadShaders("../shaders/TextVertexShader.vertexshader", "../shaders/TextVertexShader.fragmentshader");
 
     // Initialize uniforms' IDs
-    Text2DUniformID = glGetUniformLocation(Text2DShaderID, "myTextureSampler");
+    Text2DUniformID = gltGetUniformLocation(Text2DShaderID, "myTextureSampler");
 
 }
 
@@ -73,52 +74,52 @@ void printText2D(const char * text, int x, int y, int size) {
 		UVs.push_back(uv_up_right);
 		UVs.push_back(uv_down_left);
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
+	gltBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
+	gltBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+	gltBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
+	gltBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
 
 	// Bind shader
-	glUseProgram(Text2DShaderID);
+	gltUseProgram(Text2DShaderID);
 
 	// Bind texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, Text2DTextureID);
+	gltActiveTexture(GL_TEXTURE0);
+	gltBindTexture(GL_TEXTURE_2D, Text2DTextureID);
 	// Set our "myTextureSampler" sampler to use Texture Unit 0
-	glUniform1i(Text2DUniformID, 0);
+	gltUniform1i(Text2DUniformID, 0);
 
 	// 1rst attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	gltEnableVertexAttribArray(0);
+	gltBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
+	gltVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
 
 	// 2nd attribute buffer : UVs
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	gltEnableVertexAttribArray(1);
+	gltBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
+	gltVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gltEnable(GL_BLEND);
+	gltBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Draw call
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size() );
+	gltDrawArrays(GL_TRIANGLES, 0, vertices.size() );
 
-	glDisable(GL_BLEND);
+	gltDisable(GL_BLEND);
 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
+	gltDisableVertexAttribArray(0);
+	gltDisableVertexAttribArray(1);
 
 }
 
 void cleanupText2D() {
 
 	// Delete buffers
-	glDeleteBuffers(1, &Text2DVertexBufferID);
-	glDeleteBuffers(1, &Text2DUVBufferID);
+	gltDeleteBuffers(1, &Text2DVertexBufferID);
+	gltDeleteBuffers(1, &Text2DUVBufferID);
 
 	// Delete texture
-	glDeleteTextures(1, &Text2DTextureID);
+	gltDeleteTextures(1, &Text2DTextureID);
 
 	// Delete shader
-	glDeleteProgram(Text2DShaderID);
+	gltDeleteProgram(Text2DShaderID);
 }
@@ -0,0 +1,206 @@
+/*
+ * track_interpolator.cpp
+ *
+ *      Author: maheriya
+ * Description: Display-time interpolation of tracked boxes between detector results
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "track_interpolator.hpp"
+
+using namespace std;
+
+TrackInterpolator::TrackInterpolator(void) :
+    mDelay(0.1),
+    mMaxExtrapolation(0.2),
+    mTimeout(0.5) { }
+
+void TrackInterpolator::setTiming(double delay, double maxExtrapolation, double timeout) {
+    mDelay = delay;
+    mMaxExtrapolation = maxExtrapolation;
+    mTimeout = timeout;
+}
+
+void TrackInterpolator::observe(const Detection& det, int stream) {
+    if (det.track <= 0)
+        return;
+    Track& tr = mTracks[make_pair(stream, det.track)]; // value-initialized (empty) for a new track
+    if (tr.count > 0 && det.timestamp <= tr.at(tr.count - 1).timestamp)
+        return;
+    if (tr.count < TRACK_HISTORY) {
+        tr.obs[(tr.head + tr.count) % TRACK_HISTORY] = det;
+        tr.count++;
+    } else {
+        tr.obs[tr.head] = det; // overwrite the oldest
+        tr.head = (tr.head + 1) % TRACK_HISTORY;
+    }
+}
+
+// a + (b - a) * alpha for the box; everything else from 'b'
+static Detection lerpBox(const Detection& a, const Detection& b, double alpha) {
+    Detection d = b;
+    d.xmin = (float)(a.xmin + (b.xmin - a.xmin) * alpha);
+    d.ymin = (float)(a.ymin + (b.ymin - a.ymin) * alpha);
+    d.xmax = (float)(a.xmax + (b.xmax - a.xmax) * alpha);
+    d.ymax = (float)(a.ymax + (b.ymax - a.ymax) * alpha);
+    return d;
+}
+
+void TrackInterpolator::resolve(double t, vector<Detection>& out) {
+    double te = t - mDelay; // the moment the boxes are shown for
+    for (map<pair<int, int>, Track>::iterator it = mTracks.begin(); it != mTracks.end(); ) {
+        const Track& tr = it->second;
+        const Detection& last = tr.at(tr.count - 1);
+        if (t - last.timestamp > mTimeout + mDelay) {
+            mTracks.erase(it++);
+            continue;
+        }
+        Detection d;
+        if (te <= tr.at(0).timestamp) {
+            d = tr.at(0);
+        } else if (te >= last.timestamp) {
+            if (tr.count < 2) {
+                d = last;
+            } else {
+                // Constant velocity from the last two observations, for a bounded time
+                const Detection& prev = tr.at(tr.count - 2);
+                double dt = min(te - last.timestamp, mMaxExtrapolation);
+                d = lerpBox(prev, last, 1.0 + dt / (last.timestamp - prev.timestamp));
+            }
+        } else {
+            int i = tr.count - 2;
+            while (i > 0 && tr.at(i).timestamp > te)
+                i--;
+            const Detection& a = tr.at(i);
+            const Detection& b = tr.at(i + 1);
+            d = lerpBox(a, b, (te - a.timestamp) / (b.timestamp - a.timestamp));
+        }
+        d.timestamp = te;
+        out.push_back(d);
+        ++it;
+    }
+}
+
+void TrackInterpolator::clear(void) {
+    mTracks.clear();
+}
+
+//-------------------------------------------------------------------------------------
+// Evaluation on recorded sequences
+//-------------------------------------------------------------------------------------
+static double boxIoU(const Detection& a, const Detection& b) {
+    double iw = min(a.xmax, b.xmax) - max(a.xmin, b.xmin);
+    double ih = min(a.ymax, b.ymax) - max(a.ymin, b.ymin);
+    if (iw <= 0.0 || ih <= 0.0)
+        return 0.0;
+    double inter = iw * ih;
+    double uni = (a.xmax - a.xmin) * (a.ymax - a.ymin) + (b.xmax - b.xmin) * (b.ymax - b.ymin) - inter;
+    return (uni > 0.0) ? inter / uni : 0.0;
+}
+
+static double centerDistance(const Detection& a, const Detection& b) {
+    double dx = 0.5 * ((a.xmin + a.xmax) - (b.xmin + b.xmax));
+    double dy = 0.5 * ((a.ymin + a.ymax) - (b.ymin + b.ymax));
+    return sqrt(dx * dx + dy * dy);
+}
+
+static const Detection* findTrack(const vector<Detection>& dets, int track) {
+    for (size_t i = 0; i < dets.size(); i++)
+        if (dets[i].track == track)
+            return &dets[i];
+    return NULL;
+}
+
+InterpolationError evaluateInterpolation(const vector<Detection>& sequence, int stride,
+                                         double delay, double maxExtrapolation) {
+    InterpolationError err = InterpolationError();
+    if (sequence.empty() || stride < 1)
+        return err;
+
+    // Frame f spans sequence[frameStart[f] .. frameStart[f + 1])
+    vector<size_t> frameStart;
+    vector<double> frameTime;
+    for (size_t i = 0; i < sequence.size(); i++) {
+        if (i == 0 || sequence[i].timestamp != sequence[i - 1].timestamp) {
+            frameStart.push_back(i);
+            frameTime.push_back(sequence[i].timestamp);
+        }
+    }
+    size_t frames = frameStart.size();
+    frameStart.push_back(sequence.size());
+
+    TrackInterpolator interp;
+    interp.setTiming(delay, maxExtrapolation, 1e9);
+    map<int, Detection> held; // last detector result per track
+    vector<Detection> shown;
+    double sumIoU = 0.0, sumCenter = 0.0, holdIoU = 0.0, holdCenter = 0.0;
+    double alignedIoU = 0.0, alignedCenter = 0.0;
+    size_t holdSamples = 0, alignedSamples = 0;
+
+    for (size_t f = 0; f < frames; f++) {
+        if ((f % stride) == 0) {
+            for (size_t i = frameStart[f]; i < frameStart[f + 1]; i++) {
+                interp.observe(sequence[i]);
+                held[sequence[i].track] = sequence[i];
+            }
+        }
+        // Interpolated boxes stand for frameTime[f] - delay; scored once that is within the sequence
+        double te = frameTime[f] - delay;
+        if (te < frameTime[0])
+            continue;
+        shown.clear();
+        interp.resolve(frameTime[f], shown);
+
+        // Both ways are scored against frame f, the one they are drawn over
+        for (size_t i = frameStart[f]; i < frameStart[f + 1]; i++) {
+            const Detection& gt = sequence[i];
+            if (gt.track <= 0)
+                continue;
+            // Without interpolation the overlay shows the last result as it is
+            map<int, Detection>::const_iterator h = held.find(gt.track);
+            if (h != held.end()) {
+                holdIoU += boxIoU(h->second, gt);
+                holdCenter += centerDistance(h->second, gt);
+                holdSamples++;
+            }
+            const Detection* d = findTrack(shown, gt.track);
+            if (d == NULL) {
+                err.missed++;
+                continue;
+            }
+            double c = centerDistance(*d, gt);
+            sumIoU += boxIoU(*d, gt);
+            sumCenter += c;
+            err.maxCenter = max(err.maxCenter, c);
+            err.samples++;
+        }
+
+        // Interpolation alone: against the frame closest to the time the boxes stand for
+        size_t g = lower_bound(frameTime.begin(), frameTime.begin() + f + 1, te) - frameTime.begin();
+        if (g > 0 && (g > f || te - frameTime[g - 1] < frameTime[g] - te))
+            g--;
+        for (size_t i = frameStart[g]; i < frameStart[g + 1]; i++) {
+            const Detection& gt = sequence[i];
+            const Detection* d = (gt.track > 0) ? findTrack(shown, gt.track) : NULL;
+            if (d == NULL)
+                continue;
+            alignedIoU += boxIoU(*d, gt);
+            alignedCenter += centerDistance(*d, gt);
+            alignedSamples++;
+        }
+    }
+    if (err.samples > 0) {
+        err.meanIoU = sumIoU / err.samples;
+        err.meanCenter = sumCenter / err.samples;
+    }
+    if (holdSamples > 0) {
+        err.holdMeanIoU = holdIoU / holdSamples;
+        err.holdMeanCenter = holdCenter / holdSamples;
+    }
+    if (alignedSamples > 0) {
+        err.alignedMeanIoU = alignedIoU / alignedSamples;
+        err.alignedMeanCenter = alignedCenter / alignedSamples;
+    }
+    return err;
+}
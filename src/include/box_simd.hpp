@@ -0,0 +1,59 @@
+/*
+ * box_simd.hpp
+ *
+ *      Author: maheriya
+ * Description: Float vector helpers for the box overlap kernels (IoU tracker, NMS) and the
+ *              tensor decoder.
+ *              BOX_LANES boxes per instruction: 8 with AVX, 4 with SSE2; not defined
+ *              otherwise (the kernels then use their scalar loops). Include in .cpp files only.
+ */
+
+#ifndef __BOX_SIMD_HPP_
+#define __BOX_SIMD_HPP_
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BOX_LANES 8
+typedef __m256 vfloat;
+#define vset1(x)      _mm256_set1_ps(x)
+#define vload(p)      _mm256_loadu_ps(p)
+#define vstore(p, v)  _mm256_storeu_ps(p, v)
+#define vmin(a, b)    _mm256_min_ps(a, b)
+#define vmax(a, b)    _mm256_max_ps(a, b)
+#define vadd(a, b)    _mm256_add_ps(a, b)
+#define vsub(a, b)    _mm256_sub_ps(a, b)
+#define vmul(a, b)    _mm256_mul_ps(a, b)
+#define vdiv(a, b)    _mm256_div_ps(a, b)
+#define vgemask(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))
+#define vgtmask(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))
+#define veqmask(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BOX_LANES 4
+typedef __m128 vfloat;
+#define vset1(x)      _mm_set1_ps(x)
+#define vload(p)      _mm_loadu_ps(p)
+#define vstore(p, v)  _mm_storeu_ps(p, v)
+#define vmin(a, b)    _mm_min_ps(a, b)
+#define vmax(a, b)    _mm_max_ps(a, b)
+#define vadd(a, b)    _mm_add_ps(a, b)
+#define vsub(a, b)    _mm_sub_ps(a, b)
+#define vmul(a, b)    _mm_mul_ps(a, b)
+#define vdiv(a, b)    _mm_div_ps(a, b)
+#define vgemask(a, b) _mm_movemask_ps(_mm_cmpge_ps(a, b))
+#define vgtmask(a, b) _mm_movemask_ps(_mm_cmpgt_ps(a, b))
+#define veqmask(a, b) _mm_movemask_ps(_mm_cmpeq_ps(a, b))
+#endif
+
+#ifdef BOX_LANES
+// Intersection of box (ax1, ay1, ax2, ay2) with the BOX_LANES boxes at x1[j], y1[j], ... (0 if apart)
+static inline vfloat boxIntersection(vfloat ax1, vfloat ay1, vfloat ax2, vfloat ay2,
+                                     const float* x1, const float* y1, const float* x2, const float* y2) {
+    const vfloat zero = vset1(0.0f);
+    vfloat w = vmax(vsub(vmin(ax2, vload(x2)), vmax(ax1, vload(x1))), zero);
+    vfloat h = vmax(vsub(vmin(ay2, vload(y2)), vmax(ay1, vload(y1))), zero);
+    return vmul(w, h);
+}
+#endif
+
+#endif /* __BOX_SIMD_HPP_ */
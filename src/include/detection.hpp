@@ -0,0 +1,28 @@
+/*
+ * detection.hpp
+ *
+ *      Author: maheriya
+ * Description: Detection record passed between detectors, trackers and DetectionWindow
+ */
+
+#ifndef __DETECTION_HPP_
+#define __DETECTION_HPP_
+#include <string>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+struct Detection {
+    float xmin;       // box in [0..1] frame coordinates, y down
+    float ymin;
+    float xmax;
+    float ymax;
+    glm::vec3 color;
+    string label;
+    float score;
+    int    track;     // track ID (> 0); 0 if the detection is not tracked
+    double timestamp; // capture time of the frame in seconds (glfwGetTime() clock); 0: now
+    int    classId;   // detector class index (per-class NMS); 0 if unused
+};
+
+#endif /* __DETECTION_HPP_ */
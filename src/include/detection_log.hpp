@@ -0,0 +1,186 @@
+/*
+ * detection_log.hpp
+ *
+ *      Author: maheriya
+ * Description: Append-only binary log of detection sets, and a replay driver.
+ *              The log is a file header followed by fixed-layout records: one per frame (frame ID,
+ *              timestamp, boxes with class, score, track, label and color), and one per label
+ *              string, written the first time it is used. A sidecar "<log>.idx" holds a sparse time
+ *              index (every DLOG_INDEX_INTERVAL frames) and the label records, so opening an hours
+ *              long log does not read it. Readers memory-map the log; records are used in place.
+ *              A log cut short (crash) is valid up to its last complete record.
+ */
+
+#ifndef __DETECTION_LOG_HPP_
+#define __DETECTION_LOG_HPP_
+#include <stdio.h>
+#include <inttypes.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "detection.hpp"
+
+using namespace std;
+
+#define DLOG_MAGIC          "GLRDLOG1"
+#define DLOG_INDEX_MAGIC    "GLRDIDX1"
+#define DLOG_VERSION        1
+#define DLOG_INDEX_INTERVAL 64 // frames between index entries (seek reads at most this many)
+
+#define DLOG_FRAME 1
+#define DLOG_LABEL 2
+
+struct DLogFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize; // sizeof(DLogFileHeader)
+    uint32_t recordSize; // sizeof(DLogRecord)
+    uint32_t boxSize;    // sizeof(DLogBox)
+    uint32_t reserved[2];
+};
+
+// Followed by 'count' DLogBox (frame) or 'count' characters padded to 8 bytes (label)
+struct DLogRecord {
+    uint32_t type;      // DLOG_FRAME or DLOG_LABEL
+    uint32_t size;      // whole record in bytes, a multiple of 8
+    uint64_t frameId;   // label: label ID
+    double   timestamp;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct DLogBox {
+    float    xmin, ymin, xmax, ymax;
+    float    score;
+    int32_t  classId;
+    int32_t  track;
+    uint32_t label;     // label ID (DLOG_LABEL record)
+    uint32_t color;     // RGBA8
+    uint32_t reserved;
+};
+
+struct DLogIndexEntry {
+    double   timestamp;
+    uint64_t offset;    // record in the log
+    uint64_t frameId;   // label: label ID
+    uint32_t type;      // DLOG_FRAME or DLOG_LABEL
+    uint32_t ordinal;   // frames before this one in the log
+};
+
+class DetectionLogWriter {
+public:
+    DetectionLogWriter(void);
+    ~DetectionLogWriter(void);
+
+    // Creates the log, or appends to an existing one (a partial last record is cut off)
+    bool open(const char* path);
+    // Appends one detection set (boxes are stored with the frame's timestamp)
+    bool write(uint64_t frameId, double timestamp, const vector<Detection>& dets);
+    void flush(void);
+    void close(void);
+
+    inline uint64_t frames(void) const { return mFrames; }
+    inline uint64_t bytes(void) const { return mOffset; }
+
+private:
+    FILE* mLog;
+    FILE* mIndex;
+    uint64_t mOffset; // end of the log
+    uint64_t mFrames;
+    map<string, uint32_t> mLabelIds;
+    vector<DLogBox> mBoxes; // scratch
+
+    bool writeLabel(const string& label, uint32_t id);
+    bool writeIndex(const DLogIndexEntry& entry);
+};
+
+class DetectionLog {
+public:
+    DetectionLog(void);
+    ~DetectionLog(void);
+
+    // Maps the log and loads its index (rebuilt from the records where missing or short)
+    bool open(const char* path);
+    void close(void);
+    // Picks up records appended since open() (live logs)
+    bool refresh(void);
+
+    inline uint64_t frames(void) const { return mFrames; }
+    inline double startTime(void) const { return mStartTime; }
+    inline double endTime(void) const { return mEndTime; }
+    inline const vector<string>& labels(void) const { return mLabels; }
+    // End of the last complete record
+    inline uint64_t validEnd(void) const { return mEnd; }
+
+    // Offset of the first frame with timestamp >= t (0 past the end): binary search in the
+    // index, then at most DLOG_INDEX_INTERVAL records forward
+    uint64_t seek(double t) const;
+    // Offset of the first frame (0 if empty)
+    uint64_t first(void) const;
+    // Frame record at 'offset' (NULL if there is none), used in place
+    const DLogRecord* frame(uint64_t offset) const;
+    // Offset of the frame after the one at 'offset' (0 at the end)
+    uint64_t next(uint64_t offset) const;
+    // Appends the frame's boxes to 'out'
+    void read(const DLogRecord* rec, vector<Detection>& out) const;
+    // Rewrites the sidecar index from the one in memory (complete after open/refresh)
+    bool saveIndex(void) const;
+
+private:
+    int      mFd;
+    uint8_t* mData;
+    uint64_t mSize;   // mapped bytes
+    uint64_t mEnd;
+    uint64_t mFrames;
+    double   mStartTime;
+    double   mEndTime;
+    string   mIndexPath;
+    vector<DLogIndexEntry> mIndex; // frame entries, in log order
+    vector<DLogIndexEntry> mLabelEntries;
+    vector<string> mLabels;
+
+    bool map(void);
+    // Walks the records from 'offset' to the end, indexing as the writer would
+    void scan(uint64_t offset, uint32_t ordinal);
+    void addLabel(const DLogRecord* rec);
+    const DLogRecord* record(uint64_t offset) const;
+};
+
+struct ReplayStats {
+    uint64_t frames;  // frames handed out
+    uint64_t skipped; // frames passed over because a newer one was already due
+    uint64_t seeks;
+};
+
+// Plays a log back against a wall clock, at its original speed or faster/slower
+class DetectionReplay {
+public:
+    DetectionReplay(DetectionLog& log);
+
+    inline void setSpeed(double speed) { mSpeed = (speed > 0.0) ? speed : 1.0; }
+    // Restamp detections onto the wall clock (needed when tracked boxes are interpolated)
+    inline void setRestamp(bool restamp) { mRestamp = restamp; }
+    // Continue from log time t, starting at wall clock 'now'
+    void seek(double t, double now);
+    // Log time shown at wall clock 'now'
+    double logTime(double now) const;
+
+    // Moves to wall clock 'now'. When a frame has come due, 'out' gets the newest due frame's
+    // detections and its frame ID and log timestamp are returned; returns false otherwise.
+    bool update(double now, vector<Detection>& out, uint64_t* frameId=NULL, double* timestamp=NULL);
+    inline bool finished(void) const { return mNext == 0; }
+    inline const ReplayStats& stats(void) const { return mStats; }
+
+private:
+    DetectionLog& mLog;
+    double   mSpeed;
+    bool     mRestamp;
+    double   mLogStart;  // log time at mWallStart
+    double   mWallStart;
+    uint64_t mNext;      // next frame to hand out (0: end)
+    uint64_t mLast;      // last frame handed out
+    bool     mStarted;
+    ReplayStats mStats;
+};
+
+#endif /* __DETECTION_LOG_HPP_ */
@@ -9,35 +9,111 @@
 #define __DETECTION_WINDOW_HPP_
 #include <inttypes.h>
 #include <map>
+#include <vector>
+#include <future>
+#include <chrono>
 //#define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "gl_trace.hpp"
+#include "gl_object.hpp"
+#include "render_context.hpp"
+#include "detection.hpp"
+#include "track_interpolator.hpp"
+#include "frame_encoder.hpp"
+#include "event_recorder.hpp"
+#include "overlay_layer.hpp"
+#include "label_placer.hpp"
+#include "pick_index.hpp"
+#include "shm_ring.hpp"
 // GL includes
 //#include "Shader.h"
 
 #include <string>
 #include <opencv2/opencv.hpp>
 
+// WITH_CUDA 0 builds without the cv::cuda::GpuMat entry points (no CUDA, no OpenCV OpenGL
+// interop); frames then come from host memory only. It changes the class layout, so it must match
+// the library: the glrender target passes it on to whatever links it.
+#ifndef WITH_CUDA
+#error "WITH_CUDA must be defined (0 or 1) to the value glrender was built with"
+#endif
+#if WITH_CUDA
+#include <opencv2/core/opengl.hpp>
+#endif
+
 using namespace std;
 
-struct Character {
-    GLuint     TextureID;  // ID handle of the glyph texture
-    glm::ivec2 Size;       // Size of glyph
-    glm::ivec2 Bearing;    // Offset from baseline to left/top of glyph
-    GLuint     Advance;    // Offset to advance to next glyph
+#define MAX_MOSAIC_STREAMS 32 // one bit per stream in the mosaic valid mask
+
+#define MAX_GALLERY_THUMBS 16 // size of the cells/crops arrays in the gallery shader
+
+#define CAPTURE_BUFFERS 3 // frame readbacks in flight; more requests while all are busy are dropped
+
+// Image formats (image shader 'format' uniform)
+#define IMAGE_FORMAT_BGR  0
+#define IMAGE_FORMAT_NV12 1 // Y plane, then interleaved UV at half resolution
+#define IMAGE_FORMAT_I420 2 // Y plane, then U and V planes at half resolution
+
+// YUV to RGB conversion matrices
+#define COLOR_MATRIX_BT601 0 // SD video
+#define COLOR_MATRIX_BT709 1 // HD video
+
+// Downscale pyramid counters (see DetectionWindow::buildPyramid). Bandwidth is estimated from the
+// texture sizes: sampling level L touches 1/4^L of the source bytes, building it reads and writes
+// every level in between.
+struct DownscaleStats {
+    uint64_t builds;     // pyramids generated (per texture and frame)
+    GLint    level;      // level sampled by the last build; 0 when drawn at full resolution
+    uint64_t timed;      // frames whose mip generation was timed on the GPU
+    uint64_t gpuNs;      // GPU time of mip generation in those frames (GL_TIME_ELAPSED)
+    uint64_t bytesBuilt; // bytes read and written by mip generation
+    uint64_t bytesSaved; // source bytes the image pass did not have to fetch
 };
 
-struct Detection {
-    float xmin;
-    float ymin;
-    float xmax;
-    float ymax;
-    glm::vec3 color;
-    string label;
-    float score;
+// Static overlay bakes (see DetectionWindow::overlay)
+struct OverlayStats {
+    uint64_t bakes;       // layer or window size changed
+    double   lastBakeMs;  // CPU time of the last bake: tessellation, uploads, draw submission
+    size_t   triangles;   // in the last bake
+    uint64_t composites;  // frames the baked texture was drawn in (one draw each)
+};
+
+// Level of detail decisions for crowded frames (see DetectionWindow::setLod), summed over frames
+struct LodStats {
+    uint64_t frames;
+    uint64_t crowdedFrames;  // frames with clustering on (enough detections)
+    uint64_t boxesDrawn;
+    uint64_t boxesClustered; // drawn as part of a count badge instead
+    uint64_t clusters;       // badges drawn
+    uint64_t labelsSmall;    // dropped: box below the label size
+    uint64_t labelsCapped;   // dropped: over the per-frame label limit
+};
+
+// A cluster of boxes drawn as one count badge
+struct LodBadge {
+    glm::vec2 center;  // window pixels, y down
+    int       count;
+    glm::vec3 color;   // of the best scoring box
+    float     score;
+};
+
+#define LOD_BOX   1
+#define LOD_LABEL 2
+
+class DetectionWindow;
+
+// Mouse picking events (see DetectionWindow::setPickListener), called from glfwPollEvents()
+class PickListener {
+public:
+    virtual ~PickListener(void) { }
+    // The box under the cursor changed (NULL: none)
+    virtual void hover(DetectionWindow& win, const Detection* det) { }
+    // Left click: the box clicked, or NULL (selection cleared)
+    virtual void select(DetectionWindow& win, const Detection* det) { }
 };
 
 class DetectionWindow {
@@ -48,44 +124,251 @@ public:
         mHeight(720),
         mScreenWidth(1280),
         mScreenHeight(720),
+        mFbWidth(1280),
+        mFbHeight(720),
+        mWindow(NULL),
         //
-        mImageVAO(-1),
-        mImageVertexBuffer(-1),
-        mImageTexID(-1),
         mImageShaderProgram(-1),
+        mImageUniFormat(-1),
+        mImageUniYUVMatrix(-1),
+        mImageUniYUVOffset(-1),
+        mYUVFormat(IMAGE_FORMAT_BGR),
+        mYUVWidth(0),
+        mYUVHeight(0),
+        mColorMatrix(COLOR_MATRIX_BT601),
+        mColorFullRange(false),
+        mDownscale(true),
+        mDownscaleQuery(0),
+        mDownscaleTiming(false),
+        mDownscalePending(false),
+        mDownscaleStats(),
+        mMosaicLevel(-1),
+        mMosaicDirty(false),
+        mGalleryThumbs(0),
+        mGallerySize(0.2f),
+        mGalleryShaderProgram(0),
+        mGalleryUniCells(-1),
+        mGalleryUniCrops(-1),
+        mGalleryUniFormat(-1),
+        mGalleryUniYUVMatrix(-1),
+        mGalleryUniYUVOffset(-1),
+        mHeatWidth(0),
+        mHeatHeight(0),
+        mHeatHalfLife(600.0),
+        mHeatFullScale(60.0f),
+        mHeatOpacity(0.6f),
+        mHeatBoxBufferSize(0),
+        mHeatSplatProgram(0),
+        mHeatProgram(0),
+        mHeatUniDecayPass(-1),
+        mHeatUniWeight(-1),
+        mHeatUniScale(-1),
+        mHeatUniOpacity(-1),
+        mHeatLastTime(-1.0),
+        mLabelPlacement(true),
+        mLodCrowd(50),
+        mLodMinLabel(8.0f),
+        mLodCell(64),
+        mLodClusterMin(12),
+        mLodMaxLabels(200),
+        mLodStats(),
+        mPickListener(NULL),
+        mPickBuilt(false),
+        mCursorIn(false),
+        mCursor(0.0f),
+        mHover(-1),
+        mSelect(-1),
+        mSelecting(false),
+        mSelectPoint(0.0f),
+        mSelectTrack(0),
+        mOverlayStats(),
+        mOverlayProgram(0),
+        mOverlayUniTextured(-1),
+        mOverlayBufferSize(0),
+        mOverlayVersion(0),
+        mOverlayImagesVersion(0),
+        mOverlayWidth(0),
+        mOverlayHeight(0),
+        mOverlayFailed(false),
         //
         mLineWidth(2.6f),
-        mBBoxVAO(-1),
         mBBoxUniColor(-1),
-        mBBoxVertexBuffer(-1),
         mBBoxShaderProgram(-1),
+        mTrailBufferSize(0),
         //
-        mTextVAO(-1),
-        mTextVertexBuffer(-1),
-        mTextUVBuffer(-1),
+        mTextShaderProgram(-1),
         mTextUniTexSampler(-1),
         mTextUniTextColor(-1),
-        mTextTextID(-1),
-        mTextShaderProgram(-1),
-        mWindow(NULL) { }
+        mTextUniProjection(-1),
+        //
+        mMosaicStreams(0),
+        mMosaicCols(0),
+        mMosaicRows(0),
+        mMosaicTileWidth(0),
+        mMosaicTileHeight(0),
+        mMosaicShaderProgram(0),
+        mMosaicUniGrid(-1),
+        mMosaicUniValid(-1),
+        mMosaicValidMask(0),
+        mEncoder(NULL),
+        mRecorder(NULL),
+        mReadbacks(),
+        mReadbackHead(0),
+        mReadbackCount(0),
+        mClipFrames(0),
+        mClipIndex(0),
+        mContext(NULL),
+        mTrace(),
+        mFirstFrameShown(false) { }
 
     int createWindow(int width, int height, string winname="OpenGL Window");
     int display(const unsigned char* img, GLuint format);
+#if WITH_CUDA
     int display(cv::cuda::GpuMat& img);
+#endif
+    // Host image of 8-bit gray, BGR or BGRA pixels. ROIs and padded rows are uploaded in place.
+    int display(const cv::Mat& img);
+
+    // YUV 4:2:0 frames as decoders deliver them: one 8-bit plane of width x height*3/2 holding
+    // the Y plane followed by the chroma planes (IMAGE_FORMAT_NV12 or IMAGE_FORMAT_I420).
+    // The planes are uploaded as they are; the image shader converts to RGB. Host frames may have
+    // a padded step (I420 chroma rows are then step/2 apart, as decoders lay them out).
+#if WITH_CUDA
+    int displayYUV(cv::cuda::GpuMat& frame, int format);
+#endif
+    int displayYUV(const cv::Mat& frame, int format);
+    // Newest frame of a shared memory ring fed by another process, with the detections published
+    // with it (as published: tracked boxes do not go through the track interpolator). The pixels
+    // are uploaded straight from the shared pages, and the slot is checked right after the upload
+    // (see ShmRingReader::release). Returns GL_FALSE when there is no new frame; nothing is drawn then.
+    int displayShm(ShmRingReader& ring);
+    // COLOR_MATRIX_BT601 or COLOR_MATRIX_BT709; limited (16..235) or full (0..255) range.
+    // Default is BT.601 limited range, which is what cv::cvtColor(..., COLOR_BGR2YUV_I420) produces.
+    void setColorSpace(int matrix, bool fullRange);
+
+    // When the image is shown at half its size or less, build a mip chain down to the smallest
+    // level still covering the on-screen size and sample that instead of the full resolution
+    // (less aliasing, less texture bandwidth). On by default.
+    inline void setDownscale(bool enable) { mDownscale = enable; }
+    inline const DownscaleStats& downscaleStats(void) { return mDownscaleStats; }
+
+    // Move labels off each other (see LabelPlacer); labels that cannot be placed are hidden.
+    // Off: every label above its box, as drawn. On by default.
+    inline void setLabelPlacement(bool enable) { mLabelPlacement = enable; mLabelPlacer.reset(); }
+    inline const LabelStats& labelStats(void) { return mLabelPlacer.stats(); }
+
+    // Level of detail, so overlay cost stays bounded however many detections there are:
+    // - boxes smaller than 'minLabelSize' pixels (either side) get no label
+    // - with 'crowd' or more detections, boxes are binned on a grid of 'clusterCell' pixels and
+    //   cells holding 'clusterMin' or more boxes are drawn as one count badge instead
+    // - at most 'maxLabels' labels (best scores first) are drawn per frame
+    // 0 turns a rule off. The heatmap, gallery and recorder still see every detection.
+    void setLod(int crowd=50, float minLabelSize=8.0f, int clusterCell=64, int clusterMin=12, int maxLabels=200);
+    inline const LodStats& lodStats(void) { return mLodStats; }
+
+    // Mouse hover and click on boxes. While the cursor is in the window (or something is
+    // selected) the boxes drawn are indexed on a grid as each frame is finished, and cursor
+    // events up to the next frame are resolved against it. The hovered and selected boxes are
+    // highlighted, the selected detection's details shown in the top left corner; a selected
+    // track stays selected while it is shown.
+    inline void setPickListener(PickListener* listener) { mPickListener = listener; }
+    inline const PickStats& pickStats(void) { return mPickIndex.stats(); }
+    // Selected detection of the frame last shown (NULL: none)
+    inline const Detection* selected(void) { return (mSelect >= 0) ? &mPickDets[mSelect] : NULL; }
+    inline void clearSelection(void) { mSelecting = false; mSelect = -1; }
+    // From the GLFW callbacks: cursor position in window coordinates, left click, cursor left
+    void cursorMoved(double x, double y);
+    void clicked(void);
+    void cursorLeft(void);
+
+    // Thumbnail strip along the right edge showing zoomed crops of the (up to) 'thumbs'
+    // highest-scoring detections, each fitted into a square of 'size' x window height.
+    // The crops are sampled from the frame texture already uploaded for the main view, in one
+    // instanced draw. 0 thumbs turns the gallery off. Not available in mosaic mode.
+    int setGallery(int thumbs, float size=0.2f);
+
+    // Heatmap of where detections were shown. Every frame, each box shown adds a soft splat to a
+    // float render target of width x height texels (covering the window) and everything in it
+    // decays with the given half-life in seconds, all on the GPU; the cost per frame does not
+    // depend on how long it has been accumulating. Heat is in seconds of presence; 'fullScale'
+    // seconds reach the top of the colormap. It is drawn over the image, under the boxes.
+    // 0 width turns it off.
+    int setHeatmap(int width, int height, double halfLife=600.0, float fullScale=60.0f, float opacity=0.6f);
+    void clearHeatmap(void);
+
+    // Static overlay layer: zone polygons, counting lines and logos, in box coordinates. Elements
+    // are added to the layer returned here; after a change (or a window resize) the layer is
+    // rendered once into a window-sized texture, which is then drawn with one draw per frame,
+    // over the image and heatmap and under the boxes.
+    inline OverlayLayer& overlay(void) { return mOverlay; }
+    inline const OverlayStats& overlayStats(void) { return mOverlayStats; }
+
+    // Mosaic mode: one window shows 'streams' frames of tileWidth x tileHeight (BGR) in a grid.
+    // Frames are kept in a texture array and drawn with a single instanced draw.
+    int setMosaic(int streams, int tileWidth, int tileHeight);
+#if WITH_CUDA
+    int updateStream(int stream, cv::cuda::GpuMat& frame, double timestamp);
+#endif
+    int updateStream(int stream, const cv::Mat& frame, double timestamp);
+    int displayMosaic(void);
+    inline int mosaicStreams(void) { return mMosaicStreams; }
+    // Capture time of the frame currently shown in a tile (as given to updateStream)
+    inline double streamTimestamp(int stream) { return mStreamTimestamps[stream]; }
+    // Spread of the tiles' timestamps (newest - oldest); 0 if fewer than two tiles have frames
+    double mosaicSkew(void);
     void setTitle(char* title);
 
+    // Capture of the composited frames (image, boxes and labels) to image files. Frames are read
+    // back into pixel buffers without waiting for the GPU and picked up once the copy is done,
+    // a frame or two later; the encoder's workers convert and write them. Without an encoder
+    // (the default) nothing is captured. An encoder may be shared by several windows.
+    inline void setCapture(FrameEncoder* encoder) { mEncoder = encoder; }
+    // Writes the next frame shown to 'path' (format from the extension: .png, .jpg, ...)
+    int captureFrame(const string& path);
+    // Writes the next 'frames' frames (0: until stopClip) to files named by 'pattern', a printf
+    // format for the frame number within the clip, e.g. "clip_%05d.jpg"
+    int startClip(const string& pattern, int frames=0);
+    inline void stopClip(void) { mClipFrames = 0; }
+    inline bool clipActive(void) { return mClipFrames != 0; }
+    // Pre-event recording: frames shown go (at the recorder's frame rate) through the capture
+    // encoder into the recorder's ring, and the detections shown are checked against its
+    // triggers. Needs setCapture(). NULL turns it off.
+    inline void setRecorder(EventRecorder* recorder) { mRecorder = recorder; }
+
     // Adds a detection to a list of detections. No visual processing is involved.
-    inline void addDetection(Detection& det) {
-        detections.push_back(det);
+    // Untracked detections (track 0) are shown in the next frame only. Tracked ones are kept
+    // and their boxes interpolated between detector results at display time, so the detector
+    // may run at a lower rate than the display (see TrackInterpolator).
+    void addDetection(Detection& det);
+    // Mosaic mode: box coordinates are relative to the given stream's frame. Each stream has its
+    // own track IDs.
+    void addDetection(int stream, Detection& det);
+    inline void setTrackTiming(double delay, double maxExtrapolation, double timeout) {
+        mTracks.setTiming(delay, maxExtrapolation, timeout);
     }
+    // Seconds on the clock of Detection::timestamp (glfwGetTime(), or time since createWindow()
+    // without a window)
+    double displayTime(void);
+    // Polyline in box coordinates (e.g. from IoUTracker::trail), drawn under the boxes in the
+    // next frame only
+    void addTrail(const glm::vec2* points, int count, glm::vec3 color);
     inline void delDetections(void) {
         detections.clear();
         detections.shrink_to_fit();
+        mTrails.clear();
+        mTrailVertices.clear();
     }
 
     void cleanup(void);
 
     inline GLFWwindow* win(void) { return mWindow; }
+    // Draw/bind/upload counters of the GL interposition layer (see gl_trace.hpp), this window's frames only
+    inline const GLTraceStats& traceStats(void) { return mTrace; }
+    // Texture/buffer recycling shared by all windows (valid until cleanup())
+    inline const GLPoolStats& poolStats(void) { return mContext->pool().stats(); }
+    inline const StartupTimings& startupTimings(void) { return mStartup; }
+    // Framebuffer size, as last reported by GLFW
+    inline void resized(int width, int height) { mFbWidth = width; mFbHeight = height; }
     int _checkError(char *file, int line);
 
 private:
@@ -94,55 +377,250 @@ private:
     GLint mHeight;
     GLint mScreenWidth;
     GLint mScreenHeight;
+    GLint mFbWidth;
+    GLint mFbHeight;
 
     // Image setup
     GLFWwindow* mWindow;
-    GLuint mImageVAO;
-    GLuint mImageVertexBuffer;
+    GLVertexArray mImageVAO;
+    GLBuffer      mImageVertexBuffer;
     GLuint mImageShaderProgram;
-    GLuint mImageTexID;
+    PooledTexture mImageTex; // host images (see display(const cv::Mat&))
+    GLint  mImageUniFormat;
+    GLint  mImageUniYUVMatrix;
+    GLint  mImageUniYUVOffset;
+
+    // YUV input: Y, U (or UV) and V plane textures, and staging for GpuMat frames
+    PooledTexture mYUVTex[3];
+    GLint  mYUVFormat;
+    GLint  mYUVWidth;
+    GLint  mYUVHeight;
+    GLint  mColorMatrix;
+    bool   mColorFullRange;
+#if WITH_CUDA
+    cv::ogl::Buffer mYUVPBO;
+    cv::ogl::Texture2D mGpuTex; // GpuMat images (see showImage(const cv::cuda::GpuMat&))
+#endif
+    ShmFrame mShmFrame; // last frame taken from a shared memory ring (see displayShm)
+
+    // Downscale pyramid
+    bool   mDownscale;
+    GLuint mDownscaleQuery;   // GL_TIME_ELAPSED around the frame's mip generation
+    bool   mDownscaleTiming;  // query begun and not yet ended
+    bool   mDownscalePending; // query ended, result not yet read
+    DownscaleStats mDownscaleStats;
+    GLint  mMosaicLevel;      // mosaic levels valid up to this one; -1 if none
+    bool   mMosaicDirty;      // a stream was updated since the pyramid was built
+
+    // Detection thumbnail gallery
+    GLint   mGalleryThumbs;   // 0: off
+    GLfloat mGallerySize;     // thumbnail box, fraction of window height
+    GLuint  mGalleryShaderProgram;
+    GLint   mGalleryUniCells;
+    GLint   mGalleryUniCrops;
+    GLint   mGalleryUniFormat;
+    GLint   mGalleryUniYUVMatrix;
+    GLint   mGalleryUniYUVOffset;
+
+    // Detection heatmap
+    GLint   mHeatWidth;       // 0: off
+    GLint   mHeatHeight;
+    double  mHeatHalfLife;
+    GLfloat mHeatFullScale;
+    GLfloat mHeatOpacity;
+    PooledTexture mHeatTex;   // GL_R32F: 16-bit floats cannot hold the per-frame decay of long half-lives
+    GLFramebuffer mHeatFBO;
+    GLVertexArray mHeatVAO;   // unit quad, and the boxes as instances
+    GLBuffer      mHeatQuadBuffer;
+    GLBuffer      mHeatBoxBuffer;
+    GLsizeiptr mHeatBoxBufferSize;
+    GLuint  mHeatSplatProgram;
+    GLuint  mHeatProgram;
+    GLint   mHeatUniDecayPass;
+    GLint   mHeatUniWeight;
+    GLint   mHeatUniScale;
+    GLint   mHeatUniOpacity;
+    double  mHeatLastTime;    // display time of the last update; < 0 before the first
+    vector<glm::vec4> mHeatBoxes;
+
+    // Label placement
+    bool mLabelPlacement;
+    LabelPlacer mLabelPlacer;
+    vector<LabelRequest>   mLabelRequests;
+    vector<LabelPlacement> mLabelPlacements;
+
+    // Level of detail
+    int   mLodCrowd;
+    float mLodMinLabel;
+    int   mLodCell;
+    int   mLodClusterMin;
+    int   mLodMaxLabels;
+    LodStats mLodStats;
+    vector<uint8_t>  mLodFlags;     // per detection: LOD_BOX, LOD_LABEL
+    vector<int>      mLodCellOf;    // per detection: grid cell
+    vector<int>      mLodCellCount;
+    vector<int>      mLodCellBadge; // per cell: badge, -1: none
+    vector<LodBadge> mLodBadges;
+    vector< pair<float, int> > mLodOrder; // scratch: (-score, detection)
+    vector<int>      mLabelDets;    // detection of each label request
+
+    // Picking. After a frame is finished, mPickDets holds its detections (swapped, not copied),
+    // and the index, mHover and mSelect refer to them.
+    PickIndex mPickIndex;
+    PickListener* mPickListener;
+    vector<Detection> mPickDets;
+    bool      mPickBuilt;
+    bool      mCursorIn;
+    glm::vec2 mCursor;       // [0..1], y down
+    int       mHover;        // detection under the cursor, -1: none
+    int       mSelect;       // selected detection, -1: none (or its track is not shown)
+    bool      mSelecting;    // something was clicked
+    glm::vec2 mSelectPoint;  // where (untracked boxes are picked there again each frame)
+    int       mSelectTrack;  // what (tracked boxes are followed)
+
+    // Static overlay layer
+    OverlayLayer mOverlay;
+    OverlayStats mOverlayStats;
+    GLuint   mOverlayProgram;
+    GLint    mOverlayUniTextured;
+    PooledTexture mOverlayTex;      // baked layer, RGBA8 premultiplied, framebuffer size
+    GLFramebuffer mOverlayFBO;
+    GLVertexArray mOverlayVAO;
+    GLBuffer mOverlayBuffer;        // the composite quad, then the layer's triangles
+    GLsizeiptr mOverlayBufferSize;
+    uint64_t mOverlayVersion;       // layer version baked; 0: none
+    uint64_t mOverlayImagesVersion; // layer version the image textures were uploaded for
+    GLint    mOverlayWidth;         // baked size
+    GLint    mOverlayHeight;
+    bool     mOverlayFailed;        // a bake failed: the layer is not shown until cleanup()
+    vector<PooledTexture> mOverlayImageTex;
+    vector<OverlayVertex> mOverlayVertices;
+    vector<OverlayBatch>  mOverlayBatches;
 
     // Bounding box setup
     GLfloat mLineWidth;
-    GLuint mBBoxVAO;
+    GLVertexArray mBBoxVAO;
     GLuint mBBoxUniColor;
-    GLuint mBBoxVertexBuffer;
+    GLBuffer mBBoxVertexBuffer;
     GLuint mBBoxShaderProgram;
     vector<Detection> detections;
+    TrackInterpolator mTracks;
+
+    // Track trails: all points in one buffer, a line strip per trail
+    struct Trail {
+        GLint     first;
+        GLsizei   count;
+        glm::vec3 color;
+    };
+    GLVertexArray mTrailVAO;
+    GLBuffer mTrailVertexBuffer;
+    GLsizeiptr mTrailBufferSize;
+    vector<Trail> mTrails;
+    vector<glm::vec2> mTrailVertices;
 
     // Text setup (for labels)
-    GLuint mTextVAO;
-    GLuint mTextTextID;
-    GLuint mTextVertexBuffer;
-    GLuint mTextUVBuffer;
+    GLVertexArray mTextVAO;
+    GLBuffer mTextVertexBuffer;
     GLuint mTextShaderProgram;
     GLuint mTextUniTexSampler;
     GLuint mTextUniTextColor;
-    map<GLchar, Character> mCharacters;
+    GLint  mTextUniProjection;
+
+    // Mosaic setup
+    GLint  mMosaicStreams; // 0: single image mode
+    GLint  mMosaicCols;
+    GLint  mMosaicRows;
+    GLint  mMosaicTileWidth;
+    GLint  mMosaicTileHeight;
+    GLTexture mMosaicTexArray;
+    GLuint mMosaicShaderProgram;
+    GLint  mMosaicUniGrid;
+    GLint  mMosaicUniValid;
+    GLuint mMosaicValidMask; // bit per stream that has received a frame
+    vector<double> mStreamTimestamps;
+#if WITH_CUDA
+    cv::ogl::Buffer mStreamPBO; // staging for GpuMat frames
+#endif
+
+    // Frame capture: a ring of pixel pack buffers, each with the fence of its readback
+    struct Readback {
+        PooledBuffer pbo;
+        GLsizeiptr size;       // bytes read back (the buffer may be larger)
+        GLsync     fence;
+        GLint      width;
+        GLint      height;
+        string     path;
+        EventRecorder* recorder; // instead of 'path'
+        double     timestamp;
+    };
+    FrameEncoder* mEncoder;
+    EventRecorder* mRecorder;
+    Readback mReadbacks[CAPTURE_BUFFERS];
+    int      mReadbackHead;  // oldest readback in flight
+    int      mReadbackCount;
+    string   mCapturePath;   // captureFrame() request for the next frame
+    string   mClipPattern;
+    int      mClipFrames;    // frames left in the clip; -1: until stopClip(); 0: no clip
+    int      mClipIndex;
+
+    // Shared programs and glyphs (one per process); the bind cache is per context, the trace
+    // counters per window
+    RenderContext* mContext;
+    GLStateCache   mGLState;
+    GLTraceStats   mTrace;
+
+    // Startup profiling
+    StartupTimings mStartup;
+    chrono::steady_clock::time_point mStartTime;
+    bool mFirstFrameShown;
 
-    int initializeGLFW(void);
+    void makeCurrent(void);
     int initBuffers(void);
     int initImageBuffers(void);
     int initBBoxBuffers(void);
     int initTextBuffers(void);
 
-    GLuint createVertexBuffer(const void *vertex_buffer, GLuint vbsize, bool dstatic=true);
-    GLuint createVertexArray(void);
-    int createImageShaders(GLuint*);
-    int createBBoxShaders(GLuint*);
-    int createTextShaders(GLuint*);
+    GLBuffer createVertexBuffer(const void *vertex_buffer, GLuint vbsize, bool dstatic=true);
+    GLVertexArray createVertexArray(void);
 
+#if WITH_CUDA
     int showImage(cv::cuda::GpuMat& img);
+#endif
+    int showImage(const cv::Mat& img);
+    int uploadImage(const cv::Mat& img);
+    void drawImage(int width, int height, size_t bytes);
+    int checkYUVFrame(int rows, int cols, int format);
+    int uploadYUV(const GLubyte* planes, size_t step);
+    int showYUV(void);
+    GLint buildPyramid(GLenum target, GLint srcWidth, GLint srcHeight, GLint dstWidth, GLint dstHeight,
+                       GLsizeiptr bytes, GLint builtLevel=-1);
+    void endPyramidTiming(void);
+    void setImageFormat(GLint uniFormat, GLint uniMatrix, GLint uniOffset, GLint format);
+    int showGallery(GLint srcWidth, GLint srcHeight, GLint format);
+    void deleteHeatmap(void);
+    int bakeOverlay(void);
+    int showOverlay(void);
+    void deleteOverlay(void);
+    int showHeatmap(void);
+    int showMosaic(void);
+    void beginFrame(void);
+    void addStreamDetection(int stream, const Detection& det);
+    int finishFrame(void);
     int showBBox(void);
+    void applyLod(void);
+    void updatePicking(void);
     int showText(void);
+    void capture(void);
+    void readback(const string& path, EventRecorder* recorder=NULL);
+    void collectReadbacks(bool wait);
 
-    int loadFonts(void);
+    void printStartupTimings(void);
     void renderTextTrueType(string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color);
 
     inline void unBindBuffers(void) {
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glBindVertexArray(0);
+        gltBindBuffer(GL_ARRAY_BUFFER, 0);
+        gltBindTexture(GL_TEXTURE_2D, 0);
+        gltBindVertexArray(0);
     }
 
 };
@@ -0,0 +1,101 @@
+/*
+ * event_recorder.hpp
+ *
+ *      Author: maheriya
+ * Description: Pre-event recording of one stream. The composited frames of a DetectionWindow are
+ *              kept as JPEGs in a ring covering the last few seconds, bounded in bytes. When the
+ *              shown detections match a trigger (class, label, score), the ring and the frames
+ *              that follow, up to a few seconds after the last match, are written to a file.
+ *              Frames are encoded and written on the FrameEncoder's workers, never on the render
+ *              thread. The output is a Motion JPEG stream (concatenated JPEGs; ffmpeg -f mjpeg).
+ */
+
+#ifndef __EVENT_RECORDER_HPP_
+#define __EVENT_RECORDER_HPP_
+#include <stdio.h>
+#include <inttypes.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "detection.hpp"
+#include "frame_encoder.hpp"
+
+using namespace std;
+
+// Fires on a detection with this class (-1: any) and label (empty: any) scoring at least minScore
+struct EventTrigger {
+    int    classId;
+    string label;
+    float  minScore;
+};
+
+struct RecorderStats {
+    size_t   frames;     // in the ring now
+    size_t   bytes;      // in the ring now
+    size_t   maxBytes;   // most held at once
+    uint64_t received;   // frames encoded into the ring
+    uint64_t evicted;    // pushed out of the ring by the byte limit before their time was up
+    uint64_t late;       // arrived after a later frame had been written to the event file
+    uint64_t events;     // files written
+    uint64_t eventFrames;
+    uint64_t eventBytes;
+};
+
+class EventRecorder : public EncodedFrameSink {
+public:
+    // 'name' labels the stream in reports; files are '<prefix>_<event number>.mjpeg'
+    EventRecorder(const string& name, const string& prefix);
+    ~EventRecorder(void);
+
+    // Seconds kept before the first and after the last matching frame
+    void setWindow(double pre, double post);
+    // Ring size limit; the oldest frames go first when it is reached
+    inline void setMemoryLimit(size_t bytes) { mMemoryLimit = bytes; }
+    // Frames kept per second (0: every frame shown)
+    inline void setFrameRate(double fps) { mFrameInterval = (fps > 0.0) ? 1.0 / fps : 0.0; }
+    void addTrigger(int classId, float minScore, const string& label="");
+
+    // Render thread, once per frame shown at time t
+    bool wantFrame(double t);
+    // Checks the detections shown at time t against the triggers; returns true if one matched
+    bool check(const vector<Detection>& dets, double t);
+    // Closes the event file, if any (its post-event frames may be cut short)
+    void finish(void);
+
+    void put(vector<uchar>& jpeg, double timestamp);
+    inline const string& name(void) const { return mName; }
+    RecorderStats stats(void);
+
+private:
+    struct Frame {
+        double timestamp;
+        vector<uchar> jpeg;
+    };
+
+    string mName;
+    string mPrefix;
+    double mPre;
+    double mPost;
+    size_t mMemoryLimit;
+    double mFrameInterval;
+    double mLastWanted;   // render thread only
+    vector<EventTrigger> mTriggers;
+
+    mutex  mLock;         // everything below
+    deque<Frame> mRing;   // by timestamp
+    size_t mRingBytes;
+    bool   mEventPending; // triggered; file not opened yet
+    double mEventStart;   // first match
+    double mEventEnd;     // last match + post
+    FILE*  mEventFile;
+    double mWritten;      // timestamp of the last frame written to the event file
+    RecorderStats mStats;
+
+    void openEvent(void);
+    void writeEvent(void);
+    void closeEvent(void);
+    void trim(void);
+};
+
+#endif /* __EVENT_RECORDER_HPP_ */
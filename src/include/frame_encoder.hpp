@@ -0,0 +1,101 @@
+/*
+ * frame_encoder.hpp
+ *
+ *      Author: maheriya
+ * Description: Pool of worker threads writing captured frames to disk (PNG, JPEG, ... by file
+ *              extension). Frames arrive as they were read back from GL (BGRA, bottom-up rows);
+ *              the workers flip, convert and encode them. The queue is bounded: when the workers
+ *              fall behind, new frames are dropped (and counted) rather than held in memory or
+ *              waited for. Pixel buffers are recycled between frames.
+ */
+
+#ifndef __FRAME_ENCODER_HPP_
+#define __FRAME_ENCODER_HPP_
+#include <inttypes.h>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+// Receiver of encoded (JPEG) frames instead of a file; called on the worker threads, in the
+// order frames finish, which may differ slightly from the order they were captured in
+class EncodedFrameSink {
+public:
+    virtual ~EncodedFrameSink(void) { }
+    // May take over the contents of 'jpeg' (swap)
+    virtual void put(vector<uchar>& jpeg, double timestamp) = 0;
+};
+
+struct CaptureStats {
+    uint64_t requested;     // frames asked for
+    uint64_t readbackDrops; // no free readback buffer (the GPU is behind): not read
+    uint64_t queueDrops;    // read back, but the encoder queue was full
+    uint64_t written;
+    uint64_t failed;        // encode or write errors
+    uint64_t bytes;         // encoded bytes written
+    size_t   queued;        // frames waiting for a worker now
+    size_t   maxQueued;
+    double   encodeMs;      // per image: total, last and worst (convert + encode + write)
+    double   lastEncodeMs;
+    double   maxEncodeMs;
+    double   copyMs;        // render thread: total time copying read back pixels out
+};
+
+class FrameEncoder {
+public:
+    FrameEncoder(void);
+    ~FrameEncoder(void); // writes what is queued, then stops the workers
+
+    // Starts 'workers' threads (0: half the cores) with room for 'queueDepth' frames
+    bool start(int workers=0, int queueDepth=8, int jpegQuality=90);
+    // Waits for the buffers acquired to be submitted, writes what is queued and stops the workers.
+    // Not to be called between acquire() and submit() on the same thread.
+    void stop(void);
+    inline bool running(void) const { return !mWorkers.empty(); }
+
+    // Reserves a place in the queue and returns a pixel buffer for a frame of the given size
+    // (recycled if possible). Empty, and counted as dropped, if the queue is full.
+    cv::Mat acquire(int width, int height);
+    // Queues an acquired buffer, filled with BGRA pixels bottom-up (as read back), for writing
+    // to 'path', or as JPEG to 'sink'. Neither gives the place back.
+    void submit(cv::Mat& bgra, const string& path, EncodedFrameSink* sink=NULL, double timestamp=0.0);
+    // Capture bookkeeping done by the producer (DetectionWindow)
+    void countRequest(void);
+    void countReadbackDrop(void);
+    void countCopy(double ms);
+    // Blocks until every queued frame has been written
+    void drain(void);
+
+    CaptureStats stats(void);
+
+private:
+    struct Job {
+        cv::Mat bgra;
+        string  path;
+        EncodedFrameSink* sink;
+        double  timestamp;
+    };
+
+    vector<thread>     mWorkers;
+    mutex              mLock;
+    condition_variable mWake;  // job queued, or stopping
+    condition_variable mIdle;  // job finished
+    deque<Job>         mQueue;
+    vector<cv::Mat>    mFree;  // recycled pixel buffers
+    size_t   mQueueDepth;
+    size_t   mReserved;        // acquired and not yet submitted
+    size_t   mBusy;            // jobs taken by workers and not finished
+    int      mJpegQuality;
+    bool     mStopping;
+    CaptureStats mStats;
+
+    void run(void);
+    bool encode(Job& job, size_t& bytes);
+};
+
+#endif /* __FRAME_ENCODER_HPP_ */
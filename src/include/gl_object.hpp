@@ -0,0 +1,163 @@
+/*
+ * gl_object.hpp
+ *
+ *      Author: maheriya
+ * Description: Owning handles for GL objects, and a pool that recycles textures and buffers.
+ *              A handle holds one name, deletes it when it goes away and can only be moved, so
+ *              every object has exactly one owner. Names are made and freed through the gl_trace
+ *              wrappers, which keep the live counts (gltLive). Handles convert to GLuint and pass
+ *              straight to the glt* calls. They must be reset while their context is current.
+ *              GLObjectPool keeps released textures (by size and format) and buffers (by size
+ *              class and usage) for reuse, so objects that come and go with the content (resizes,
+ *              format changes, overlay edits) stop being created once the sizes have been seen.
+ */
+
+#ifndef __GL_OBJECT_HPP_
+#define __GL_OBJECT_HPP_
+#include <inttypes.h>
+#include <vector>
+#include "gl_trace.hpp"
+
+using namespace std;
+
+// How each kind of name is made and freed
+struct GLTextureKind {
+    static void gen(GLuint* name) { gltGenTextures(1, name); }
+    static void del(GLuint name)  { gltDeleteTextures(1, &name); }
+};
+struct GLBufferKind {
+    static void gen(GLuint* name) { gltGenBuffers(1, name); }
+    static void del(GLuint name)  { gltDeleteBuffers(1, &name); }
+};
+struct GLVertexArrayKind {
+    static void gen(GLuint* name) { gltGenVertexArrays(1, name); }
+    static void del(GLuint name)  { gltDeleteVertexArrays(1, &name); }
+};
+struct GLFramebufferKind {
+    static void gen(GLuint* name) { gltGenFramebuffers(1, name); }
+    static void del(GLuint name)  { gltDeleteFramebuffers(1, &name); }
+};
+struct GLProgramKind {
+    static void gen(GLuint* name) { *name = gltCreateProgram(); }
+    static void del(GLuint name)  { gltDeleteProgram(name); }
+};
+
+template <class Kind>
+class GLObject {
+public:
+    GLObject(void) : mName(0) { }
+    // Takes ownership of an existing name
+    explicit GLObject(GLuint name) : mName(name) { }
+    GLObject(GLObject&& other) : mName(other.release()) { }
+    GLObject& operator=(GLObject&& other) {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+    ~GLObject(void) { reset(); }
+    GLObject(const GLObject&) = delete;
+    GLObject& operator=(const GLObject&) = delete;
+
+    static GLObject create(void) {
+        GLuint name = 0;
+        Kind::gen(&name);
+        return GLObject(name);
+    }
+
+    inline operator GLuint(void) const { return mName; }
+    inline GLuint get(void) const { return mName; }
+    // Gives up ownership without deleting
+    inline GLuint release(void) {
+        GLuint name = mName;
+        mName = 0;
+        return name;
+    }
+    // Deletes the object held (if any) and takes 'name'
+    inline void reset(GLuint name = 0) {
+        if (mName != 0)
+            Kind::del(mName);
+        mName = name;
+    }
+    // For functions that return a name through a pointer: deletes the object held and lets the
+    // function store the new one
+    inline GLuint* put(void) {
+        reset();
+        return &mName;
+    }
+
+private:
+    GLuint mName;
+};
+
+typedef GLObject<GLTextureKind>     GLTexture;
+typedef GLObject<GLBufferKind>      GLBuffer;
+typedef GLObject<GLVertexArrayKind> GLVertexArray;
+typedef GLObject<GLFramebufferKind> GLFramebuffer;
+typedef GLObject<GLProgramKind>     GLProgram;
+
+// A pooled 2D texture and the storage it was allocated with
+struct PooledTexture {
+    GLTexture tex;
+    GLint     format; // internal format
+    GLsizei   width;
+    GLsizei   height;
+};
+
+// A pooled buffer; 'capacity' bytes of storage (at least the size asked for)
+struct PooledBuffer {
+    GLBuffer   buf;
+    GLsizeiptr capacity;
+    GLenum     usage;
+};
+
+struct GLPoolStats {
+    uint64_t acquires;  // textures and buffers handed out
+    uint64_t hits;      // of them recycled
+    uint64_t released;  // handed back
+    uint64_t evicted;   // deleted to stay under the idle limit
+    size_t   idle;      // objects waiting in the pool
+    uint64_t idleBytes; // their storage
+};
+
+// Textures are shared by all contexts of a share group, buffers too; one pool serves them all
+// (see RenderContext::pool). Objects come back with their old contents and parameters. Buffers
+// are pooled for capture readbacks; vertex buffers stay with their window, whose vertex arrays
+// refer to them.
+class GLObjectPool {
+public:
+    GLObjectPool(size_t maxIdle = 32);
+
+    // GL_TEXTURE_2D with level 0 allocated (no data, no mipmaps), left bound to the active unit
+    PooledTexture acquireTexture(GLint format, GLsizei width, GLsizei height);
+    // Buffer with at least 'size' bytes (rounded up to a power of two), left bound to
+    // GL_COPY_WRITE_BUFFER
+    PooledBuffer acquireBuffer(GLsizeiptr size, GLenum usage);
+    // Empty handles are ignored. The least recently released objects go beyond maxIdle.
+    void release(PooledTexture& texture);
+    void release(PooledBuffer& buffer);
+    // Deletes the idle objects (a context of the share group must be current)
+    void clear(void);
+
+    inline const GLPoolStats& stats(void) const { return mStats; }
+
+private:
+    struct Idle {
+        GLuint     name;
+        bool       texture;
+        GLint      format;   // texture: internal format; buffer: usage
+        GLsizei    width;
+        GLsizei    height;
+        GLsizeiptr bytes;    // buffer: capacity
+    };
+    size_t mMaxIdle;
+    vector<Idle> mIdle; // oldest first
+    GLPoolStats mStats;
+
+    void add(const Idle& idle);
+    void drop(size_t i, bool evicted);
+};
+
+// Bytes of a texture level of this internal format (estimate for the uncommon ones)
+GLsizeiptr gltTextureBytes(GLint format, GLsizei width, GLsizei height);
+
+#endif /* __GL_OBJECT_HPP_ */
@@ -0,0 +1,663 @@
+/*
+ * gl_trace.hpp
+ *
+ *      Author: maheriya
+ * Description: Thin interposition layer over the GL entry points used by the renderer.
+ *              Every glt* wrapper forwards to the matching gl* call and counts draws,
+ *              binds and uploaded bytes per frame. The same wrappers can be switched to
+ *              a no-op backend so that render paths can be exercised (and costed) without
+ *              any GL context.
+ *              Bind and use calls also pass through a small state cache (GLStateCache) that
+ *              drops calls which would not change the current binding.
+ */
+
+#ifndef __GL_TRACE_HPP_
+#define __GL_TRACE_HPP_
+#include <inttypes.h>
+#include <stddef.h>
+#include <GL/glew.h>
+
+// Set GL_TRACE to 0 to compile all wrappers down to plain GL calls
+#ifndef GL_TRACE
+#define GL_TRACE 1
+#endif
+
+enum GLTraceBackend {
+    GLT_BACKEND_GL = 0, // forward to the real GL entry points
+    GLT_BACKEND_NOOP    // count only; no GL context required
+};
+
+struct GLTraceCounters {
+    uint64_t drawCalls;    // glDraw*
+    uint64_t programBinds; // glUseProgram
+    uint64_t vaoBinds;     // glBindVertexArray
+    uint64_t textureBinds; // glBindTexture
+    uint64_t bufferBinds;  // glBindBuffer
+    uint64_t uploads;      // glBufferData, glBufferSubData, glTexImage2D, ...
+    uint64_t uploadBytes;  // bytes handed to the upload calls above
+    uint64_t readbackBytes; // bytes requested with glReadPixels
+    uint64_t redundantCalls; // bind/use calls that did not change state (skipped when cache is on)
+    uint64_t labelsPlaced; // label placement (CPU, see LabelPlacer)
+    uint64_t labelsHidden; // labels with no free position
+    uint64_t labelTests;   // label pairs tested for overlap
+    double   labelMs;      // time spent placing
+    uint64_t objectsCreated; // buffers, textures, vertex arrays, framebuffers and programs made
+};
+
+struct GLTraceStats {
+    uint64_t        frames;  // number of completed frames
+    GLTraceCounters current; // frame in progress
+    GLTraceCounters last;    // last completed frame
+    GLTraceCounters total;   // all completed frames since last reset
+};
+
+// GL objects alive (made and not yet deleted through the wrappers below); always kept, as
+// objects are made rarely. Nonzero at exit means something leaked.
+struct GLObjectCounts {
+    int64_t buffers;
+    int64_t textures;
+    int64_t vertexArrays;
+    int64_t framebuffers;
+    int64_t programs;
+};
+
+#define GLT_MAX_TEXTURE_UNITS 16
+#define GLT_STATE_UNKNOWN     0xFFFFFFFFu // binding not known; next bind is always issued
+
+// Shadow copy of the bindings the renderer changes in its hot path
+struct GLStateCache {
+    GLuint program;
+    GLuint vao;
+    GLuint arrayBuffer;
+    GLuint activeUnit; // 0-based texture unit
+    GLuint texture2D[GLT_MAX_TEXTURE_UNITS];
+};
+
+extern GLTraceStats   gltStats; // work done outside any window (startup, shader builds)
+extern GLTraceStats*  gltTrace; // where the wrappers count: the current window's (see DetectionWindow::makeCurrent)
+extern GLObjectCounts gltLive;
+extern GLTraceBackend gltBackend;
+extern GLStateCache*  gltState;
+extern bool           gltStateCacheEnabled;
+
+void   gltSetBackend(GLTraceBackend backend);
+void   gltResetStats(void); // of *gltTrace
+void   gltEndFrame(void);   // ends the frame of *gltTrace; call once per frame presented by it
+void   gltSetStateCache(bool enable);
+void   gltInvalidateState(void); // call after any GL code outside the wrappers changed bindings
+GLuint gltNoopGenName(void);
+GLsizeiptr gltImageBytes(GLenum format, GLenum type, GLsizei width, GLsizei height);
+
+// Pixel unpack layout. Outside of an upload the GL defaults hold (alignment 4, row length 0);
+// code that changes them restores them with gltUnpackDefaults().
+// gltUnpackRows() sets up an upload of 'width' pixels of 'pixelBytes' bytes per row, with rows
+// 'step' bytes apart. Tightly packed or aligned rows keep row length 0 and get the widest
+// alignment the step allows (the fast path); ROIs and pitched rows get a row length.
+// Returns false if the step cannot be expressed as row length and alignment; the caller must
+// then repack the rows.
+bool   gltUnpackRows(size_t step, GLsizei width, GLsizei pixelBytes);
+void   gltUnpackDefaults(void);
+
+#if GL_TRACE
+#define GLT_COUNT(field, n) (gltTrace->current.field += (n))
+inline bool gltIsNoop(void) { return gltBackend == GLT_BACKEND_NOOP; }
+#else
+#define GLT_COUNT(field, n) ((void)0)
+inline bool gltIsNoop(void) { return false; }
+#endif
+
+// For uploads that bypass the wrappers (e.g. cv::ogl::Texture2D)
+inline void gltCountUpload(GLsizeiptr bytes) {
+    GLT_COUNT(uploads, 1);
+    GLT_COUNT(uploadBytes, bytes);
+}
+
+// Label placement runs on the CPU but is traced with the frame it is drawn in
+inline void gltCountLabels(uint64_t placed, uint64_t hidden, uint64_t tests, double ms) {
+    GLT_COUNT(labelsPlaced, placed);
+    GLT_COUNT(labelsHidden, hidden);
+    GLT_COUNT(labelTests, tests);
+    GLT_COUNT(labelMs, ms);
+}
+
+// Updates the cached binding. Returns false if the call is redundant and may be skipped.
+inline bool gltStateChange(GLuint& cached, GLuint value) {
+    if (cached == value) {
+        GLT_COUNT(redundantCalls, 1);
+        if (gltStateCacheEnabled)
+            return false;
+    }
+    cached = value;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------
+// Binds
+//-------------------------------------------------------------------------------------
+inline void gltUseProgram(GLuint program) {
+    if (!gltStateChange(gltState->program, program)) return;
+    GLT_COUNT(programBinds, 1);
+    if (gltIsNoop()) return;
+    glUseProgram(program);
+}
+
+inline void gltBindVertexArray(GLuint vao) {
+    if (!gltStateChange(gltState->vao, vao)) return;
+    GLT_COUNT(vaoBinds, 1);
+    if (gltIsNoop()) return;
+    glBindVertexArray(vao);
+}
+
+inline void gltBindBuffer(GLenum target, GLuint buffer) {
+    if (target == GL_ARRAY_BUFFER && !gltStateChange(gltState->arrayBuffer, buffer)) return;
+    GLT_COUNT(bufferBinds, 1);
+    if (gltIsNoop()) return;
+    glBindBuffer(target, buffer);
+}
+
+inline void gltBindTexture(GLenum target, GLuint texture) {
+    GLuint unit = gltState->activeUnit;
+    if (target == GL_TEXTURE_2D && unit < GLT_MAX_TEXTURE_UNITS &&
+        !gltStateChange(gltState->texture2D[unit], texture)) return;
+    GLT_COUNT(textureBinds, 1);
+    if (gltIsNoop()) return;
+    glBindTexture(target, texture);
+}
+
+inline void gltActiveTexture(GLenum unit) {
+    if (!gltStateChange(gltState->activeUnit, unit - GL_TEXTURE0)) return;
+    if (gltIsNoop()) return;
+    glActiveTexture(unit);
+}
+
+//-------------------------------------------------------------------------------------
+// Draws
+//-------------------------------------------------------------------------------------
+inline void gltDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    GLT_COUNT(drawCalls, 1);
+    if (gltIsNoop()) return;
+    glDrawArrays(mode, first, count);
+}
+
+inline void gltDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    GLT_COUNT(drawCalls, 1);
+    if (gltIsNoop()) return;
+    glDrawArraysInstanced(mode, first, count, instances);
+}
+
+inline void gltClear(GLbitfield mask) {
+    if (gltIsNoop()) return;
+    glClear(mask);
+}
+
+//-------------------------------------------------------------------------------------
+// Uploads
+//-------------------------------------------------------------------------------------
+inline void gltBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    if (data != NULL)
+        gltCountUpload(size);
+    if (gltIsNoop()) return;
+    glBufferData(target, size, data, usage);
+}
+
+inline void gltBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    gltCountUpload(size);
+    if (gltIsNoop()) return;
+    glBufferSubData(target, offset, size, data);
+}
+
+inline void gltTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                          GLint border, GLenum format, GLenum type, const void* pixels) {
+    if (pixels != NULL)
+        gltCountUpload(gltImageBytes(format, type, width, height));
+    if (gltIsNoop()) return;
+    glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+// With a GL_PIXEL_UNPACK_BUFFER bound, 'pixels' is an offset into it (usually 0).
+// The bytes are still counted: they are what the texture unit has to take in.
+inline void gltTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                             GLenum format, GLenum type, const void* pixels) {
+    gltCountUpload(gltImageBytes(format, type, width, height));
+    if (gltIsNoop()) return;
+    glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+inline void gltTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                          GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels) {
+    if (pixels != NULL)
+        gltCountUpload(gltImageBytes(format, type, width, height) * depth);
+    if (gltIsNoop()) return;
+    glTexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+}
+
+inline void gltTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                             GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type,
+                             const void* pixels) {
+    gltCountUpload(gltImageBytes(format, type, width, height) * depth);
+    if (gltIsNoop()) return;
+    glTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+}
+
+//-------------------------------------------------------------------------------------
+// Object creation and deletion
+//-------------------------------------------------------------------------------------
+inline void gltCountCreated(int64_t& live, GLsizei n) {
+    live += n;
+    GLT_COUNT(objectsCreated, n);
+}
+
+// Deleting name 0 (or a name never made) is legal GL and does not count
+inline void gltCountDeleted(int64_t& live, GLsizei n, const GLuint* ids) {
+    for (GLsizei i = 0; i < n; i++)
+        if (ids[i] != 0 && ids[i] != (GLuint)-1) live--;
+}
+
+inline void gltGenBuffers(GLsizei n, GLuint* ids) {
+    gltCountCreated(gltLive.buffers, n);
+    if (gltIsNoop()) { for (GLsizei i = 0; i < n; i++) ids[i] = gltNoopGenName(); return; }
+    glGenBuffers(n, ids);
+}
+
+inline void gltGenVertexArrays(GLsizei n, GLuint* ids) {
+    gltCountCreated(gltLive.vertexArrays, n);
+    if (gltIsNoop()) { for (GLsizei i = 0; i < n; i++) ids[i] = gltNoopGenName(); return; }
+    glGenVertexArrays(n, ids);
+}
+
+inline void gltGenTextures(GLsizei n, GLuint* ids) {
+    gltCountCreated(gltLive.textures, n);
+    if (gltIsNoop()) { for (GLsizei i = 0; i < n; i++) ids[i] = gltNoopGenName(); return; }
+    glGenTextures(n, ids);
+}
+
+// Deleting a bound object reverts its binding to 0
+inline void gltDeleteBuffers(GLsizei n, const GLuint* ids) {
+    gltCountDeleted(gltLive.buffers, n, ids);
+    for (GLsizei i = 0; i < n; i++)
+        if (gltState->arrayBuffer == ids[i]) gltState->arrayBuffer = 0;
+    if (gltIsNoop()) return;
+    glDeleteBuffers(n, ids);
+}
+
+inline void gltDeleteVertexArrays(GLsizei n, const GLuint* ids) {
+    gltCountDeleted(gltLive.vertexArrays, n, ids);
+    for (GLsizei i = 0; i < n; i++)
+        if (gltState->vao == ids[i]) gltState->vao = 0;
+    if (gltIsNoop()) return;
+    glDeleteVertexArrays(n, ids);
+}
+
+inline void gltDeleteTextures(GLsizei n, const GLuint* ids) {
+    gltCountDeleted(gltLive.textures, n, ids);
+    for (GLsizei i = 0; i < n; i++)
+        for (int u = 0; u < GLT_MAX_TEXTURE_UNITS; u++)
+            if (gltState->texture2D[u] == ids[i]) gltState->texture2D[u] = 0;
+    if (gltIsNoop()) return;
+    glDeleteTextures(n, ids);
+}
+
+//-------------------------------------------------------------------------------------
+// Shaders and programs
+//-------------------------------------------------------------------------------------
+inline GLuint gltCreateShader(GLenum type) {
+    if (gltIsNoop()) return gltNoopGenName();
+    return glCreateShader(type);
+}
+
+inline void gltShaderSource(GLuint shader, GLsizei count, const GLchar* const* src, const GLint* length) {
+    if (gltIsNoop()) return;
+    glShaderSource(shader, count, src, length);
+}
+
+inline void gltCompileShader(GLuint shader) {
+    if (gltIsNoop()) return;
+    glCompileShader(shader);
+}
+
+// The no-op backend reports every compile and link as successful with an empty log
+inline void gltGetShaderiv(GLuint shader, GLenum pname, GLint* params) {
+    if (gltIsNoop()) { *params = (pname == GL_INFO_LOG_LENGTH) ? 0 : GL_TRUE; return; }
+    glGetShaderiv(shader, pname, params);
+}
+
+inline void gltGetShaderInfoLog(GLuint shader, GLsizei size, GLsizei* length, GLchar* log) {
+    if (gltIsNoop()) { if (length) *length = 0; if (size > 0) log[0] = '\0'; return; }
+    glGetShaderInfoLog(shader, size, length, log);
+}
+
+inline void gltDeleteShader(GLuint shader) {
+    if (gltIsNoop()) return;
+    glDeleteShader(shader);
+}
+
+inline GLuint gltCreateProgram(void) {
+    gltCountCreated(gltLive.programs, 1);
+    if (gltIsNoop()) return gltNoopGenName();
+    return glCreateProgram();
+}
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile; 0xFFFFFFFF lets the driver decide
+inline void gltMaxShaderCompilerThreads(GLuint count) {
+    if (gltIsNoop()) return;
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(count);
+    else if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(count);
+}
+
+inline void gltAttachShader(GLuint program, GLuint shader) {
+    if (gltIsNoop()) return;
+    glAttachShader(program, shader);
+}
+
+inline void gltDetachShader(GLuint program, GLuint shader) {
+    if (gltIsNoop()) return;
+    glDetachShader(program, shader);
+}
+
+inline void gltLinkProgram(GLuint program) {
+    if (gltIsNoop()) return;
+    glLinkProgram(program);
+}
+
+inline void gltGetProgramiv(GLuint program, GLenum pname, GLint* params) {
+    if (gltIsNoop()) { *params = (pname == GL_INFO_LOG_LENGTH) ? 0 : GL_TRUE; return; }
+    glGetProgramiv(program, pname, params);
+}
+
+inline void gltGetProgramInfoLog(GLuint program, GLsizei size, GLsizei* length, GLchar* log) {
+    if (gltIsNoop()) { if (length) *length = 0; if (size > 0) log[0] = '\0'; return; }
+    glGetProgramInfoLog(program, size, length, log);
+}
+
+inline void gltProgramParameteri(GLuint program, GLenum pname, GLint value) {
+    if (gltIsNoop()) return;
+    glProgramParameteri(program, pname, value);
+}
+
+inline void gltGetProgramBinary(GLuint program, GLsizei size, GLsizei* length, GLenum* format, void* binary) {
+    if (gltIsNoop()) { if (length) *length = 0; *format = 0; return; }
+    glGetProgramBinary(program, size, length, format, binary);
+}
+
+inline void gltProgramBinary(GLuint program, GLenum format, const void* binary, GLsizei length) {
+    if (gltIsNoop()) return;
+    glProgramBinary(program, format, binary, length);
+}
+
+inline void gltDeleteProgram(GLuint program) {
+    gltCountDeleted(gltLive.programs, 1, &program);
+    if (gltState->program == program) gltState->program = GLT_STATE_UNKNOWN;
+    if (gltIsNoop()) return;
+    glDeleteProgram(program);
+}
+
+//-------------------------------------------------------------------------------------
+// Uniforms
+//-------------------------------------------------------------------------------------
+inline GLint gltGetUniformLocation(GLuint program, const GLchar* name) {
+    if (gltIsNoop()) return 0;
+    return glGetUniformLocation(program, name);
+}
+
+inline void gltUniform1i(GLint location, GLint v0) {
+    if (gltIsNoop()) return;
+    glUniform1i(location, v0);
+}
+
+inline void gltUniform1f(GLint location, GLfloat v0) {
+    if (gltIsNoop()) return;
+    glUniform1f(location, v0);
+}
+
+inline void gltUniform1ui(GLint location, GLuint v0) {
+    if (gltIsNoop()) return;
+    glUniform1ui(location, v0);
+}
+
+inline void gltUniform2i(GLint location, GLint v0, GLint v1) {
+    if (gltIsNoop()) return;
+    glUniform2i(location, v0, v1);
+}
+
+inline void gltUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    if (gltIsNoop()) return;
+    glUniform3f(location, v0, v1, v2);
+}
+
+inline void gltUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (gltIsNoop()) return;
+    glUniform3fv(location, count, value);
+}
+
+inline void gltUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (gltIsNoop()) return;
+    glUniform4fv(location, count, value);
+}
+
+inline void gltUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    if (gltIsNoop()) return;
+    glUniformMatrix3fv(location, count, transpose, value);
+}
+
+inline void gltUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    if (gltIsNoop()) return;
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+//-------------------------------------------------------------------------------------
+// Vertex and texture state
+//-------------------------------------------------------------------------------------
+inline void gltEnableVertexAttribArray(GLuint index) {
+    if (gltIsNoop()) return;
+    glEnableVertexAttribArray(index);
+}
+
+inline void gltDisableVertexAttribArray(GLuint index) {
+    if (gltIsNoop()) return;
+    glDisableVertexAttribArray(index);
+}
+
+inline void gltVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                   GLsizei stride, const void* offset) {
+    if (gltIsNoop()) return;
+    glVertexAttribPointer(index, size, type, normalized, stride, offset);
+}
+
+inline void gltVertexAttribDivisor(GLuint index, GLuint divisor) {
+    if (gltIsNoop()) return;
+    glVertexAttribDivisor(index, divisor);
+}
+
+inline void gltTexParameteri(GLenum target, GLenum pname, GLint param) {
+    if (gltIsNoop()) return;
+    glTexParameteri(target, pname, param);
+}
+
+inline void gltPixelStorei(GLenum pname, GLint param) {
+    if (gltIsNoop()) return;
+    glPixelStorei(pname, param);
+}
+
+inline void gltGenerateMipmap(GLenum target) {
+    if (gltIsNoop()) return;
+    glGenerateMipmap(target);
+}
+
+//-------------------------------------------------------------------------------------
+// Queries
+//-------------------------------------------------------------------------------------
+inline void gltGenQueries(GLsizei n, GLuint* ids) {
+    if (gltIsNoop()) { for (GLsizei i = 0; i < n; i++) ids[i] = gltNoopGenName(); return; }
+    glGenQueries(n, ids);
+}
+
+inline void gltDeleteQueries(GLsizei n, const GLuint* ids) {
+    if (gltIsNoop()) return;
+    glDeleteQueries(n, ids);
+}
+
+inline void gltBeginQuery(GLenum target, GLuint id) {
+    if (gltIsNoop()) return;
+    glBeginQuery(target, id);
+}
+
+inline void gltEndQuery(GLenum target) {
+    if (gltIsNoop()) return;
+    glEndQuery(target);
+}
+
+// The no-op backend has every result available, and 0
+inline void gltGetQueryObjectiv(GLuint id, GLenum pname, GLint* params) {
+    if (gltIsNoop()) { *params = (pname == GL_QUERY_RESULT_AVAILABLE) ? GL_TRUE : 0; return; }
+    glGetQueryObjectiv(id, pname, params);
+}
+
+inline void gltGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params) {
+    if (gltIsNoop()) { *params = 0; return; }
+    glGetQueryObjectui64v(id, pname, params);
+}
+
+//-------------------------------------------------------------------------------------
+// Framebuffer objects
+//-------------------------------------------------------------------------------------
+inline void gltGenFramebuffers(GLsizei n, GLuint* ids) {
+    gltCountCreated(gltLive.framebuffers, n);
+    if (gltIsNoop()) { for (GLsizei i = 0; i < n; i++) ids[i] = gltNoopGenName(); return; }
+    glGenFramebuffers(n, ids);
+}
+
+inline void gltDeleteFramebuffers(GLsizei n, const GLuint* ids) {
+    gltCountDeleted(gltLive.framebuffers, n, ids);
+    if (gltIsNoop()) return;
+    glDeleteFramebuffers(n, ids);
+}
+
+inline void gltBindFramebuffer(GLenum target, GLuint framebuffer) {
+    if (gltIsNoop()) return;
+    glBindFramebuffer(target, framebuffer);
+}
+
+inline void gltFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+    if (gltIsNoop()) return;
+    glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+inline GLenum gltCheckFramebufferStatus(GLenum target) {
+    if (gltIsNoop()) return GL_FRAMEBUFFER_COMPLETE;
+    return glCheckFramebufferStatus(target);
+}
+
+inline void gltClearBufferfv(GLenum buffer, GLint drawbuffer, const GLfloat* value) {
+    if (gltIsNoop()) return;
+    glClearBufferfv(buffer, drawbuffer, value);
+}
+
+//-------------------------------------------------------------------------------------
+// Readback and sync
+//-------------------------------------------------------------------------------------
+// With a GL_PIXEL_PACK_BUFFER bound, 'pixels' is an offset into it and the call returns
+// without waiting for the GPU
+inline void gltReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type,
+                          void* pixels) {
+    GLT_COUNT(readbackBytes, gltImageBytes(format, type, width, height));
+    if (gltIsNoop()) return;
+    glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+inline void gltReadBuffer(GLenum mode) {
+    if (gltIsNoop()) return;
+    glReadBuffer(mode);
+}
+
+// The no-op backend has every fence signaled and maps nothing
+inline GLsync gltFenceSync(GLenum condition, GLbitfield flags) {
+    if (gltIsNoop()) return (GLsync)(uintptr_t)gltNoopGenName();
+    return glFenceSync(condition, flags);
+}
+
+inline GLenum gltClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    if (gltIsNoop()) return GL_ALREADY_SIGNALED;
+    return glClientWaitSync(sync, flags, timeout);
+}
+
+inline void gltDeleteSync(GLsync sync) {
+    if (gltIsNoop()) return;
+    glDeleteSync(sync);
+}
+
+inline void* gltMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    if (gltIsNoop()) return NULL;
+    return glMapBufferRange(target, offset, length, access);
+}
+
+inline GLboolean gltUnmapBuffer(GLenum target) {
+    if (gltIsNoop()) return GL_TRUE;
+    return glUnmapBuffer(target);
+}
+
+//-------------------------------------------------------------------------------------
+// Fixed function state
+//-------------------------------------------------------------------------------------
+inline void gltViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (gltIsNoop()) return;
+    glViewport(x, y, width, height);
+}
+
+inline void gltLineWidth(GLfloat width) {
+    if (gltIsNoop()) return;
+    glLineWidth(width);
+}
+
+inline void gltEnable(GLenum cap) {
+    if (gltIsNoop()) return;
+    glEnable(cap);
+}
+
+inline void gltDisable(GLenum cap) {
+    if (gltIsNoop()) return;
+    glDisable(cap);
+}
+
+inline void gltBlendFunc(GLenum sfactor, GLenum dfactor) {
+    if (gltIsNoop()) return;
+    glBlendFunc(sfactor, dfactor);
+}
+
+inline void gltBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha) {
+    if (gltIsNoop()) return;
+    glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+inline void gltBlendColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    if (gltIsNoop()) return;
+    glBlendColor(r, g, b, a);
+}
+
+inline void gltDepthFunc(GLenum func) {
+    if (gltIsNoop()) return;
+    glDepthFunc(func);
+}
+
+inline void gltClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    if (gltIsNoop()) return;
+    glClearColor(r, g, b, a);
+}
+
+inline const GLubyte* gltGetString(GLenum name) {
+    if (gltIsNoop()) return (const GLubyte*)"noop";
+    return glGetString(name);
+}
+
+inline void gltGetIntegerv(GLenum pname, GLint* data) {
+    if (gltIsNoop()) { *data = 0; return; }
+    glGetIntegerv(pname, data);
+}
+
+inline GLenum gltGetError(void) {
+    if (gltIsNoop()) return GL_NO_ERROR;
+    return glGetError();
+}
+
+#endif /* __GL_TRACE_HPP_ */
@@ -0,0 +1,122 @@
+/*
+ * iou_tracker.hpp
+ *
+ *      Author: maheriya
+ * Description: Multi-object tracker associating detections to tracks by box overlap (IoU).
+ *              Boxes are kept as structure-of-arrays so the IoU kernels run 8 (AVX) or 4 (SSE)
+ *              boxes per instruction; only pairs above the IoU threshold are kept. Matching is
+ *              greedy (best IoU first) or optimal (Hungarian) per connected group of candidates.
+ *              Detections are swept in x order so each track only tests its neighbours.
+ *              Each track keeps a ring buffer of its past box centers for drawing trails.
+ */
+
+#ifndef __IOU_TRACKER_HPP_
+#define __IOU_TRACKER_HPP_
+#include <inttypes.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "detection.hpp"
+
+using namespace std;
+
+#define TRACKER_GREEDY    0
+#define TRACKER_HUNGARIAN 1
+
+#define TRACK_TRAIL_LENGTH 32  // box centers kept per track
+#define TRACKER_MAX_GROUP  256 // larger candidate groups are matched greedily (Hungarian is O(n^3))
+
+// Boxes as separate coordinate arrays, padded with empty boxes to a multiple of 8
+struct BoxSoA {
+    vector<float> x1, y1, x2, y2, area;
+    size_t n;
+
+    BoxSoA(void) : n(0) { }
+    void resize(size_t count);
+    inline void set(size_t i, float xmin, float ymin, float xmax, float ymax) {
+        x1[i] = xmin; y1[i] = ymin; x2[i] = xmax; y2[i] = ymax;
+        area[i] = (xmax - xmin) * (ymax - ymin);
+    }
+    inline size_t padded(void) const { return x1.size(); }
+};
+
+// Pair of boxes (a[row], b[col]) overlapping by 'iou'
+struct IoUCandidate {
+    int   row;
+    int   col;
+    float iou;
+};
+
+// IoU of every box in a with every box in b: out[i * b.padded() + j]
+void iouMatrix(const BoxSoA& a, const BoxSoA& b, float* out);
+// Appends the pairs with IoU >= threshold (the matrix is never stored)
+void iouCandidates(const BoxSoA& a, const BoxSoA& b, float threshold, vector<IoUCandidate>& out);
+// Same, with b sorted by x1 and no wider than maxWidth: each box of a only tests the run of b
+// that can reach it (sweep), then runs the same kernels over that run
+void iouCandidatesSorted(const BoxSoA& a, const BoxSoA& b, float maxWidth, float threshold,
+                         vector<IoUCandidate>& out, vector<size_t>& scratch);
+
+struct TrackerStats {
+    double   iouMs;      // candidate extraction (IoU kernels), last update
+    double   assignMs;   // matching, last update
+    size_t   candidates; // pairs above the threshold, last update
+    size_t   groups;     // connected groups of candidates (Hungarian), last update
+    size_t   largestGroup;
+    uint64_t greedyFallbacks; // groups above TRACKER_MAX_GROUP matched greedily, total
+    uint64_t created;    // tracks started, total
+    uint64_t dropped;    // tracks ended, total
+};
+
+class IoUTracker {
+public:
+    IoUTracker(void);
+
+    inline void setAssignment(int method) { mMethod = method; }
+    inline void setThreshold(float iou) { mThreshold = iou; }
+    // Frames a track survives without a match
+    inline void setMaxAge(int frames) { mMaxAge = frames; }
+
+    // Matches the detections of one frame to the tracks and sets det.track on each (new IDs
+    // for unmatched detections). The detections can then go to DetectionWindow::addDetection().
+    void update(vector<Detection>& dets);
+    void clear(void);
+
+    inline size_t tracks(void) const { return mTracks.size(); }
+    // Past box centers of a track, oldest first; returns the number written (0: unknown track)
+    int trail(int track, glm::vec2* points, int maxPoints) const;
+    inline const TrackerStats& stats(void) const { return mStats; }
+
+private:
+    struct Track {
+        int   id;
+        int   age;  // frames since the last match
+        float xmin, ymin, xmax, ymax;
+        glm::vec2 trail[TRACK_TRAIL_LENGTH]; // ring of box centers
+        int   trailHead;
+        int   trailCount;
+    };
+
+    vector<Track> mTracks;
+    int   mNextId;
+    int   mMethod;
+    float mThreshold;
+    int   mMaxAge;
+    TrackerStats mStats;
+
+    // Scratch, kept across updates to avoid reallocation
+    BoxSoA mTrackBoxes;
+    BoxSoA mDetBoxes;
+    vector<int>    mDetOrder; // detections by xmin (mDetBoxes order)
+    vector<size_t> mRanges;
+    vector<IoUCandidate> mCandidates;
+    vector<int> mTrackMatch; // detection matched to track i, or -1
+    vector<int> mDetMatch;   // track matched to detection j, or -1
+    vector<int> mTrackLocal; // index of track i within the group being solved; -1 between groups
+    vector<int> mDetLocal;
+
+    void matchGreedy(vector<IoUCandidate>& cands);
+    void matchHungarian(void);
+    void solveGroup(const vector<int>& rows, const vector<int>& cols, const vector<IoUCandidate>& edges);
+    static void pushTrail(Track& tr);
+};
+
+#endif /* __IOU_TRACKER_HPP_ */
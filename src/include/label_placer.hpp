@@ -0,0 +1,92 @@
+/*
+ * label_placer.hpp
+ *
+ *      Author: maheriya
+ * Description: Places box labels so that they do not overlap. Each label tries a fixed list of
+ *              anchors around its box (above, inside, below, beside) in priority order: labels of
+ *              tracks that were shown last frame go first and try last frame's anchor first, then
+ *              the rest by score. Placed labels are linked into the cells of a uniform grid about
+ *              one label wide, so a candidate is only tested against the labels in the cells it
+ *              covers; labels with no free anchor are hidden. Coordinates are pixels, y down.
+ */
+
+#ifndef __LABEL_PLACER_HPP_
+#define __LABEL_PLACER_HPP_
+#include <inttypes.h>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+#define LABEL_ANCHORS  8   // candidate positions per label (see LabelPlacer::candidate)
+#define LABEL_GRID_MAX 128 // cells per side
+
+// One label to place: its box and text size in pixels
+struct LabelRequest {
+    glm::vec2 boxMin;
+    glm::vec2 boxMax;
+    glm::vec2 size;
+    float     score;
+    int       track; // 0: untracked (no placement carried over)
+};
+
+struct LabelPlacement {
+    glm::vec2 pos;     // top left of the label
+    int       anchor;  // -1: hidden
+};
+
+struct LabelStats {
+    size_t   labels;   // requests, last place()
+    size_t   placed;
+    size_t   hidden;   // no free anchor
+    size_t   kept;     // tracks placed at last frame's anchor
+    uint64_t tests;    // label pairs tested for overlap, last place()
+    double   placeMs;  // last place()
+    int      gridWidth;
+    int      gridHeight;
+};
+
+class LabelPlacer {
+public:
+    LabelPlacer(void);
+
+    // Placement area; labels are moved inside it
+    inline void setViewport(int width, int height) { mWidth = width; mHeight = height; }
+    // Pixels kept free around each label
+    inline void setMargin(float margin) { mMargin = margin; }
+
+    // out[i] is the placement of labels[i]. Returns the number of labels placed.
+    size_t place(const vector<LabelRequest>& labels, vector<LabelPlacement>& out);
+    // Forgets the anchors carried over between frames
+    void reset(void);
+
+    inline const LabelStats& stats(void) const { return mStats; }
+
+private:
+    int   mWidth;
+    int   mHeight;
+    float mMargin;
+    LabelStats mStats;
+
+    // Anchor each track was shown at last frame, and the one being built for this frame
+    unordered_map<int, int> mAnchors;
+    unordered_map<int, int> mNextAnchors;
+
+    // Grid of placed labels: intrusive lists, cell -> first entry, entry -> next entry
+    int   mGridW, mGridH;
+    float mCellW, mCellH;
+    vector<int>   mCellHead;
+    vector<int>   mNext;
+    vector<int>   mEntryLabel;
+    vector<glm::vec4> mRects;  // placed labels: x0, y0, x1, y1
+    vector<uint32_t>  mStamp;  // placed label: last query that tested it
+    uint32_t mQuery;
+    vector< pair<float, int> > mOrder; // scratch: (-priority, label)
+
+    glm::vec4 candidate(const LabelRequest& label, int anchor) const;
+    bool isFree(const glm::vec4& rect);
+    void insert(const glm::vec4& rect);
+};
+
+#endif /* __LABEL_PLACER_HPP_ */
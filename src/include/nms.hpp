@@ -0,0 +1,92 @@
+/*
+ * nms.hpp
+ *
+ *      Author: maheriya
+ * Description: Non-maximum suppression of raw detector boxes, in place on the Detection list.
+ *              Per class or class-agnostic; hard (drop overlaps above the IoU threshold) or soft
+ *              (decay their scores, linear or Gaussian). Candidates are binned on a uniform grid
+ *              about one average box in size, so each kept box is only tested against the boxes
+ *              in the cells it covers, 8 (AVX) or 4 (SSE) at a time.
+ */
+
+#ifndef __NMS_HPP_
+#define __NMS_HPP_
+#include <inttypes.h>
+#include <vector>
+#include "detection.hpp"
+
+using namespace std;
+
+#define NMS_HARD          0
+#define NMS_SOFT_LINEAR   1 // score *= 1 - IoU, above the IoU threshold
+#define NMS_SOFT_GAUSSIAN 2 // score *= exp(-IoU^2 / sigma), any overlap
+
+#define NMS_GRID_MAX    256 // cells per side
+#define NMS_LARGE_CELLS 16  // boxes covering more cells go to one list tested by everyone
+
+struct NMSStats {
+    double   sortMs;     // score filter and sort, last run
+    double   binMs;      // grid build, last run
+    double   suppressMs; // IoU tests and suppression, last run
+    size_t   input;      // boxes given, last run
+    size_t   candidates; // boxes above the score threshold, last run
+    size_t   kept;       // boxes returned, last run
+    uint64_t iouTests;   // box pairs tested, last run
+    int      gridWidth;
+    int      gridHeight;
+    size_t   largeBoxes; // boxes in the shared list, last run
+};
+
+class NMS {
+public:
+    NMS(void);
+
+    inline void setMethod(int method) { mMethod = method; }
+    inline void setClassAgnostic(bool agnostic) { mAgnostic = agnostic; }
+    inline void setIoUThreshold(float iou) { mIoUThreshold = iou; }
+    // Boxes below this score are dropped up front (and, with soft NMS, once decayed below it)
+    inline void setScoreThreshold(float score) { mScoreThreshold = score; }
+    inline void setSigma(float sigma) { mSigma = sigma; }
+    // 0: no limit
+    inline void setMaxDetections(int count) { mMaxDetections = count; }
+
+    // Removes the suppressed detections from 'dets' (soft NMS also lowers the scores of the
+    // kept ones). The survivors are left in decreasing score order. Returns their number.
+    size_t run(vector<Detection>& dets);
+
+    inline const NMSStats& stats(void) const { return mStats; }
+
+private:
+    int   mMethod;
+    bool  mAgnostic;
+    float mIoUThreshold;
+    float mScoreThreshold;
+    float mSigma;
+    int   mMaxDetections;
+    NMSStats mStats;
+
+    // Grid cells as runs of one structure-of-arrays (CSR): cell c holds entries
+    // [mCellStart[c], mCellStart[c + 1]); the last cell is the list of large boxes.
+    int   mGridW, mGridH;
+    float mOriginX, mOriginY, mCellW, mCellH;
+    vector<int>   mCellStart;
+    vector<int>   mFill;        // end of the entries added to each cell so far
+    vector<float> mX1, mY1, mX2, mY2, mArea, mClass;
+    vector<int>   mIndex;       // entry -> candidate
+    vector< pair<float, int> > mOrder; // scratch: (-score, detection)
+    vector<int>   mCandidates;  // candidate -> detection, by decreasing score
+    vector<float> mScores;      // candidate scores (decayed by soft NMS)
+    vector<char>  mState;       // candidate: pending, kept or removed
+    vector<int>   mVisit;       // candidate: last pick that decayed it (soft NMS)
+    vector<float> mBox;         // candidate: x1, y1, x2, y2
+    vector<float> mBoxClass;    // candidate: class (0 when class-agnostic)
+    vector<int>   mSpan;        // candidate: cells x0, y0, x1, y1 it covers; x0 < 0: large box
+
+    void buildGrid(const vector<Detection>& dets, bool fill);
+    void insert(int k);
+    bool overlapsKept(int k);
+    // Soft NMS: decays the still pending boxes overlapping candidate 'pick'
+    void suppress(int pick, int pickNo, vector< pair<float, int> >& heap);
+};
+
+#endif /* __NMS_HPP_ */
@@ -0,0 +1,87 @@
+/*
+ * overlay_layer.hpp
+ *
+ *      Author: maheriya
+ * Description: Static overlay elements configured per site: filled zone polygons with outlines,
+ *              counting lines and images (logos). Coordinates are those of boxes ([0..1], y down).
+ *              Polygons are triangulated (ear clipping, concave ones included) when added; line
+ *              widths are in pixels, so outlines and lines become triangles when the layer is built
+ *              for a target size. DetectionWindow renders the result into a cached texture only when
+ *              the layer or the window size changed (see DetectionWindow::overlay()).
+ */
+
+#ifndef __OVERLAY_LAYER_HPP_
+#define __OVERLAY_LAYER_HPP_
+#include <inttypes.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+struct OverlayVertex {
+    glm::vec2 pos;   // [0..1], y down
+    glm::vec2 uv;    // images only
+    glm::vec4 color; // RGBA, not premultiplied
+};
+
+// Run of triangles drawn with one image bound (or none)
+struct OverlayBatch {
+    int first;
+    int count;
+    int image;       // index into OverlayLayer::images(); -1: untextured
+};
+
+struct OverlayImage {
+    int       id;
+    cv::Mat   bgra;  // continuous, 8-bit BGRA
+    glm::vec2 pos;   // top left
+    glm::vec2 size;
+    float     opacity;
+};
+
+class OverlayLayer {
+public:
+    OverlayLayer(void);
+
+    // Each returns the element's ID (for remove), or -1 if it was rejected
+    int addPolygon(const vector<glm::vec2>& points, glm::vec4 fill, glm::vec4 outline=glm::vec4(0.0f),
+                   float outlineWidth=2.0f);
+    int addLine(glm::vec2 a, glm::vec2 b, glm::vec4 color, float width=3.0f);
+    // Gray, BGR or BGRA image shown in the rectangle pos .. pos + size
+    int addImage(const cv::Mat& img, glm::vec2 pos, glm::vec2 size, float opacity=1.0f);
+    bool remove(int id);
+    void clear(void);
+
+    inline bool empty(void) const { return mElements.empty(); }
+    // Changes with every add/remove/clear
+    inline uint64_t version(void) const { return mVersion; }
+    inline const vector<OverlayImage>& images(void) const { return mImages; }
+
+    // Triangles (GL_TRIANGLES) of all elements, in the order they were added, for a target of
+    // width x height pixels
+    void build(int width, int height, vector<OverlayVertex>& vertices, vector<OverlayBatch>& batches) const;
+
+private:
+    struct Element {
+        int       id;
+        int       type;
+        glm::vec4 fill;
+        glm::vec4 color;       // outline or line
+        float     width;       // pixels
+        vector<glm::vec2> points;    // polygon (closed) or line
+        vector<glm::vec2> triangles; // polygon fill
+        int       image;       // index into mImages
+    };
+
+    vector<Element>      mElements;
+    vector<OverlayImage> mImages;
+    int      mNextId;
+    uint64_t mVersion;
+};
+
+// Ear clipping of a simple polygon (either winding); appends 3 points per triangle.
+// Returns false if the polygon is degenerate or self-intersecting (what could be cut is kept).
+bool triangulatePolygon(const vector<glm::vec2>& polygon, vector<glm::vec2>& triangles);
+
+#endif /* __OVERLAY_LAYER_HPP_ */
@@ -0,0 +1,60 @@
+/*
+ * pick_index.hpp
+ *
+ *      Author: maheriya
+ * Description: Point queries over one frame's detection boxes (mouse hover and click).
+ *              Boxes are binned on a uniform grid about one average box in size, stored as runs
+ *              of one array per cell (CSR); a query only walks the cell under the point and the
+ *              short list of boxes too large to bin. Built once per frame, queried per event.
+ */
+
+#ifndef __PICK_INDEX_HPP_
+#define __PICK_INDEX_HPP_
+#include <inttypes.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "detection.hpp"
+
+using namespace std;
+
+#define PICK_GRID_MAX    64 // cells per side
+#define PICK_LARGE_CELLS 16 // boxes covering more cells go to one list tested by every query
+
+struct PickStats {
+    size_t   boxes;     // indexed, last build()
+    int      gridWidth;
+    int      gridHeight;
+    size_t   largeBoxes;
+    double   buildMs;   // last build()
+    uint64_t picks;     // pick() calls since the last build()
+    uint64_t tests;     // boxes tested by them
+};
+
+class PickIndex {
+public:
+    PickIndex(void);
+
+    // Indexes the boxes of 'dets' ([0..1] coordinates); 'flags' (optional, one per detection)
+    // leaves out the boxes without bit 'mask' set
+    void build(const vector<Detection>& dets, const uint8_t* flags=NULL, uint8_t mask=0);
+    void clear(void);
+    // Detection under point p ([0..1], y down): the smallest box containing it, the last one
+    // added on ties (drawn on top). -1 if there is none.
+    int pick(glm::vec2 p);
+
+    inline bool empty(void) const { return mStats.boxes == 0; }
+    inline const PickStats& stats(void) const { return mStats; }
+
+private:
+    int   mGridW, mGridH;
+    PickStats mStats;
+    // Cell c holds entries [mCellStart[c], mCellStart[c + 1]); the last cell is the list of
+    // large boxes
+    vector<int>       mCellStart;
+    vector<glm::vec4> mBox;   // entry: xmin, ymin, xmax, ymax
+    vector<int>       mIndex; // entry: detection
+    vector<int>       mFill;  // scratch: end of the entries added to each cell so far
+    vector<int>       mSpan;  // scratch, per detection: cells x0, y0, x1, y1; x0 < 0: large, -2: left out
+};
+
+#endif /* __PICK_INDEX_HPP_ */
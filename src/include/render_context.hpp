@@ -0,0 +1,127 @@
+/*
+ * render_context.hpp
+ *
+ *      Author: maheriya
+ * Description: Renderer-wide GL resources shared by all DetectionWindows. A hidden root
+ *              window owns the share group; every DetectionWindow creates its context
+ *              sharing with it. Shader programs and glyph textures are built once, here.
+ *              Per-window state (VAOs, dynamic VBOs, bind cache) stays in DetectionWindow; the
+ *              textures and buffers windows drop are recycled through the shared pool().
+ */
+
+#ifndef __RENDER_CONTEXT_HPP_
+#define __RENDER_CONTEXT_HPP_
+#include <inttypes.h>
+#include <map>
+#include <vector>
+#include <future>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include "gl_trace.hpp"
+#include "gl_object.hpp"
+
+using namespace std;
+
+struct Character {
+    GLuint     TextureID;  // ID handle of the glyph texture
+    glm::ivec2 Size;       // Size of glyph
+    glm::ivec2 Bearing;    // Offset from baseline to left/top of glyph
+    GLuint     Advance;    // Offset to advance to next glyph
+};
+
+// Rasterized glyph waiting for upload (see rasterizeGlyphs)
+struct GlyphBitmap {
+    GLchar        c;
+    glm::ivec2    Size;
+    glm::ivec2    Bearing;
+    GLuint        Advance;
+    vector<GLubyte> pixels; // Size.x * Size.y, tightly packed
+};
+
+// Wall-clock milliseconds per startup phase. The shared phases (glfw, glew, shaders, fonts)
+// are only paid by the window that creates the RenderContext; they stay 0 for the others.
+struct StartupTimings {
+    double glfwInit;    // glfwInit and the hidden root context
+    double glew;        // glewInit
+    double shaderIssue; // issuing compiles/links, or loading cached program binaries
+    double fontRaster;  // glyph rasterization on the worker thread (overlaps the above)
+    double fontWait;    // main thread blocked on the glyph rasterizer
+    double glyphUpload; // glyph texture uploads
+    double shaderWait;  // main thread blocked on compiles/links
+    double window;      // this window and its (shared) context
+    double buffers;     // per-window VAO/VBO setup
+    double total;       // whole of createWindow()
+    double firstFrame;  // createWindow() start to the first presented frame
+};
+
+class RenderContext {
+public:
+    // Returns the shared context, creating it on first use (fills the shared phases of
+    // 'timings' in that case). Returns NULL on failure. Every acquire() needs a release().
+    static RenderContext* acquire(StartupTimings* timings);
+    // The last release frees the shared objects and terminates GLFW
+    void release(void);
+
+    inline GLFWwindow* shareWindow(void) { return mRootWindow; }
+    inline int windows(void) { return mRefs; }
+
+    inline GLuint imageProgram(void) { return mImageShaderProgram; }
+    inline GLuint bboxProgram(void)  { return mBBoxShaderProgram; }
+    inline GLuint textProgram(void)  { return mTextShaderProgram; }
+    GLuint mosaicProgram(void); // built on first use
+    GLuint galleryProgram(void); // built on first use
+    GLuint heatSplatProgram(void); // built on first use
+    GLuint heatmapProgram(void);   // built on first use
+    GLuint overlayProgram(void);   // built on first use
+
+    inline GLObjectPool& pool(void) { return mPool; }
+
+    // Glyph for character c; an empty glyph for characters outside the loaded set
+    inline const Character& glyph(GLchar c) const {
+        map<GLchar, Character>::const_iterator it = mCharacters.find(c);
+        return (it != mCharacters.end()) ? it->second : mNoGlyph;
+    }
+
+private:
+    static RenderContext* sInstance;
+    int mRefs;
+
+    GLFWwindow*  mRootWindow;
+    GLStateCache mGLState;
+
+    GLProgram mImageShaderProgram;
+    GLProgram mBBoxShaderProgram;
+    GLProgram mTextShaderProgram;
+    GLProgram mMosaicShaderProgram;
+    GLProgram mGalleryShaderProgram;
+    GLProgram mHeatSplatShaderProgram;
+    GLProgram mHeatmapShaderProgram;
+    GLProgram mOverlayShaderProgram;
+    GLObjectPool mPool;
+
+    map<GLchar, Character> mCharacters;
+    Character mNoGlyph;
+    vector<GlyphBitmap> mGlyphBitmaps;
+    future<int> mFontJob;
+    double mFontRasterMs;
+
+    RenderContext(void);
+    int  init(StartupTimings* timings);
+    void destroy(void);
+    void makeCurrent(void);
+
+    int createImageShaders(GLProgram& program);
+    int createBBoxShaders(GLProgram& program);
+    int createTextShaders(GLProgram& program);
+    int createMosaicShaders(GLProgram& program);
+    int createGalleryShaders(GLProgram& program);
+    int createHeatSplatShaders(GLProgram& program);
+    int createHeatmapShaders(GLProgram& program);
+    int createOverlayShaders(GLProgram& program);
+
+    int rasterizeGlyphs(void);
+    int loadFonts(StartupTimings* timings);
+};
+
+#endif /* __RENDER_CONTEXT_HPP_ */
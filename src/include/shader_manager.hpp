@@ -0,0 +1,93 @@
+/*
+ * shader_manager.hpp
+ *
+ *      Author: maheriya
+ * Description: Builds GLSL programs from source and caches the linked binaries on disk
+ *              (glGetProgramBinary). Programs are keyed by a hash of their sources and the
+ *              driver identity, so a driver update simply misses the cache.
+ *              Several programs can be built as a batch: all compiles and links are issued
+ *              first and their status is only queried at the end, which lets drivers with
+ *              KHR_parallel_shader_compile build them concurrently.
+ */
+
+#ifndef __SHADER_MANAGER_HPP_
+#define __SHADER_MANAGER_HPP_
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "gl_object.hpp"
+
+using namespace std;
+
+#define SHADER_CACHE_MISS   0
+#define SHADER_CACHE_HIT    1
+#define SHADER_CACHE_REJECT 2
+
+struct ShaderCacheStats {
+    unsigned hits;      // programs restored from the binary cache
+    unsigned misses;    // no (readable) cache entry; compiled from source
+    unsigned rejects;   // cache entry refused by the driver; compiled from source
+    unsigned failures;  // compile or link errors
+    double   compileMs; // time spent compiling and linking from source
+    double   loadMs;    // time spent restoring cached binaries
+    bool     parallel;  // driver compiles on its own threads (KHR_parallel_shader_compile)
+};
+
+class ShaderManager {
+public:
+    ShaderManager(void);
+
+    // Directory for cached binaries. An empty string disables the cache.
+    void setCacheDir(const string& dir);
+    inline const string& cacheDir(void) const { return mCacheDir; }
+
+    // Builds into 'program' (deleting what it held); false on compile/link failure, with 'program'
+    // empty. 'name' is for messages only. Inside a batch the result is unchecked and 'program' must
+    // stay in place until endBatch(), which empties it if the program fails.
+    bool buildProgram(const char* name, const char* vs_source, const char* fs_source, GLProgram& program);
+    // Sources read from files; returns a linked program (owned by the caller), or 0. Not for batches.
+    GLuint loadProgram(const char* vertex_file_path, const char* fragment_file_path);
+
+    // Defer all status queries (which block on the compiler) until endBatch()
+    void beginBatch(void);
+    // Checks every program built since beginBatch(). Failed programs are deleted (their handles
+    // emptied); returns false if there was any.
+    bool endBatch(void);
+
+    inline const ShaderCacheStats& stats(void) const { return mStats; }
+    void printStats(void) const;
+
+private:
+    struct PendingProgram {
+        string   name;
+        GLProgram* program; // the caller's handle
+        GLuint   vs;
+        GLuint   fs;
+        uint64_t key;
+        bool     useCache;
+    };
+
+    string mCacheDir;
+    string mDriverId; // GL_VENDOR, GL_RENDERER, GL_VERSION (needs a current context)
+    bool   mBinarySupported;
+    bool   mDriverQueried;
+    bool   mBatching;
+    vector<PendingProgram> mPending;
+    ShaderCacheStats mStats;
+
+    void queryDriver(void);
+    uint64_t programKey(const char* vs_source, const char* fs_source);
+    string cachePath(uint64_t key);
+    int  loadBinary(const char* name, uint64_t key, GLuint program); // SHADER_CACHE_{MISS,HIT,REJECT}
+    void storeBinary(uint64_t key, GLuint program);
+    GLuint compileShader(GLenum type, const char* source);
+    bool checkCompiled(const char* name, GLenum type, GLuint shader);
+    bool checkLinked(const char* name, GLuint program, bool verbose);
+    bool finishProgram(PendingProgram& p);
+};
+
+// Process-wide shader manager
+ShaderManager& shaderManager(void);
+
+#endif /* __SHADER_MANAGER_HPP_ */
@@ -0,0 +1,182 @@
+/*
+ * shm_ring.hpp
+ *
+ *      Author: maheriya
+ * Description: Frame and detection ingest from another process through a POSIX shared memory ring.
+ *              The producer (an inference process) creates the ring: a header and a fixed number
+ *              of slots, each holding a frame's metadata, its detection boxes and its pixels (page
+ *              aligned, sized for the largest frame). Frame n goes to slot n % slots. A slot's
+ *              sequence number is odd while the producer writes it and 2n + 2 once frame n is
+ *              complete, so a reader detects a slot reused under it (seqlock) without ever making
+ *              the producer wait. Readers map the ring read-only and use the pixels in place;
+ *              DetectionWindow uploads them straight from the shared pages.
+ */
+
+#ifndef __SHM_RING_HPP_
+#define __SHM_RING_HPP_
+#include <inttypes.h>
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "detection.hpp"
+
+using namespace std;
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "shm_ring needs lock-free 64-bit atomics (they are shared between processes)"
+#endif
+
+#define SHM_MAGIC       "GLRSHM01"
+#define SHM_VERSION     1
+#define SHM_PAGE        4096 // pixels start on a page boundary
+#define SHM_LABEL_CHARS 32   // longer labels are cut
+
+// Pixel layouts. YUV frames are one 8-bit plane of width x height*3/2 rows.
+#define SHM_FORMAT_GRAY 1
+#define SHM_FORMAT_BGR  2
+#define SHM_FORMAT_BGRA 3
+#define SHM_FORMAT_NV12 4
+#define SHM_FORMAT_I420 5
+
+struct ShmRingHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;  // sizeof(ShmRingHeader)
+    uint32_t slotHeaderSize; // sizeof(ShmSlot)
+    uint32_t boxSize;     // sizeof(ShmBox)
+    uint32_t slots;
+    uint32_t maxBoxes;    // per frame
+    uint32_t width;       // largest frame (BGRA)
+    uint32_t height;
+    uint64_t slotSize;    // bytes per slot, whole pages
+    uint64_t pixelOffset; // from the start of a slot
+    uint64_t pixelBytes;  // capacity
+    int32_t  producer;    // process ID
+    atomic<uint32_t> closed;    // set when the producer closes the ring
+    atomic<uint64_t> published; // frames completed; the newest is published - 1
+};
+
+// Followed by maxBoxes ShmBox, then (at pixelOffset) the pixels
+struct ShmSlot {
+    atomic<uint64_t> sequence; // 2n + 1 while frame n is written, 2n + 2 once complete
+    uint64_t frameId;          // producer's own frame number
+    double   timestamp;        // producer's capture time, seconds
+    uint32_t format;           // SHM_FORMAT_*
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;             // bytes per row
+    uint32_t count;            // boxes
+    uint32_t reserved;
+};
+
+struct ShmBox {
+    float   xmin, ymin, xmax, ymax;
+    float   color[3];
+    float   score;
+    int32_t track;
+    int32_t classId;
+    char    label[SHM_LABEL_CHARS]; // NUL terminated
+};
+
+// Frame handed out by ShmRingReader::acquire(). 'data' points into the shared pages and is only
+// valid until the producer reuses the slot (see release()).
+struct ShmFrame {
+    const uint8_t* data;
+    int      format;    // SHM_FORMAT_*
+    int      width;
+    int      height;
+    size_t   step;
+    uint64_t frameId;
+    double   timestamp;
+    uint64_t sequence;  // position in the ring's stream (frame n)
+    uint32_t slot;
+    vector<Detection> dets; // copied out of the slot
+
+    // Header over the pixels (no copy): CV_8UC1/3/4, YUV as width x height*3/2 rows
+    cv::Mat mat(void) const;
+};
+
+struct ShmStats {
+    uint64_t frames;    // handed out by acquire()
+    uint64_t skipped;   // published but passed over because a newer one was ready
+    uint64_t stale;     // slots found reused by the producer before they could be read
+    uint64_t overruns;  // slots reused while in use (release() false): the frame may be torn
+    uint64_t idle;      // acquire() calls with no new frame
+    uint64_t reopens;   // producer restarts picked up (a new ring under the same name)
+};
+
+// Bytes a frame of this format occupies (tightly packed rows); 0 for an unknown format
+size_t shmFrameBytes(int format, int width, int height);
+
+class ShmRingWriter {
+public:
+    ShmRingWriter(void);
+    ~ShmRingWriter(void);
+
+    // Creates ring 'name' (replacing a stale one) with slots for width x height BGRA frames
+    bool create(const char* name, uint32_t slots, uint32_t width, uint32_t height, uint32_t maxBoxes=256);
+    // Marks the ring closed and removes its name; readers keep their mapping
+    void close(void);
+
+    // Pixels of the next slot, to render or decode straight into; NULL if the frame does not fit.
+    // Rows are 'step' bytes apart. Until endFrame(), readers see the slot as being written.
+    uint8_t* beginFrame(int format, int width, int height, size_t* step);
+    // Publishes the frame begun with its detections (at most maxBoxes)
+    bool endFrame(uint64_t frameId, double timestamp, const vector<Detection>& dets);
+    // beginFrame(), one copy of 'frame' (CV_8UC1/3/4, YUV as a CV_8UC1 of height*3/2 rows), endFrame()
+    bool write(const cv::Mat& frame, int format, uint64_t frameId, double timestamp, const vector<Detection>& dets);
+
+    inline uint64_t published(void) const { return mNext; }
+
+private:
+    string   mName;
+    int      mFd;
+    uint8_t* mData;
+    size_t   mSize;
+    ShmRingHeader* mHeader;
+    uint64_t mNext;    // frame being written / next to write
+    bool     mWriting; // between beginFrame() and endFrame()
+};
+
+class ShmRingReader {
+public:
+    ShmRingReader(void);
+    ~ShmRingReader(void);
+
+    // Maps ring 'name' read-only
+    bool open(const char* name);
+    void close(void);
+
+    // Newest complete frame not handed out yet, with its detections. Returns false if there is
+    // none; when the producer has closed the ring or died, switches to a new ring created under
+    // the same name (the old one stays mapped until there is one).
+    bool acquire(ShmFrame& frame);
+    // Ends the use of frame.data: false if the producer has reused the slot in the meantime
+    bool release(const ShmFrame& frame);
+
+    inline bool isOpen(void) const { return mHeader != NULL; }
+    inline int width(void) const { return mHeader ? (int)mHeader->width : 0; }
+    inline int height(void) const { return mHeader ? (int)mHeader->height : 0; }
+    // Frames the producer has published
+    inline uint64_t published(void) const { return mHeader ? mHeader->published.load(memory_order_relaxed) : 0; }
+    inline const ShmStats& stats(void) const { return mStats; }
+
+private:
+    string   mName;
+    int      mFd;
+    uint8_t* mData;
+    size_t   mSize;
+    const ShmRingHeader* mHeader;
+    uint64_t mNext; // first frame not handed out
+    dev_t    mDevice; // identity of the ring mapped
+    ino_t    mInode;
+    ShmStats mStats;
+
+    const ShmSlot* slot(uint32_t i) const;
+    bool map(const char* name);
+    bool replaced(const char* name) const;
+};
+
+#endif /* __SHM_RING_HPP_ */
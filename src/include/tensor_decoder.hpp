@@ -0,0 +1,120 @@
+/*
+ * tensor_decoder.hpp
+ *
+ *      Author: maheriya
+ * Description: Turns a detector's raw output tensor into Detection records in bulk.
+ *              Layouts: YOLO (raw logits per grid cell and anchor, rows or channels first,
+ *              with or without objectness), SSD (box offsets and class logits against priors),
+ *              and already decoded [N, 6] boxes. Scores are thresholded in logit space where
+ *              possible, so only the surviving anchors pay for sigmoid/exp, which then run on
+ *              whole arrays at a time. Class IDs map to a label table and palette colors.
+ */
+
+#ifndef __TENSOR_DECODER_HPP_
+#define __TENSOR_DECODER_HPP_
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include "detection.hpp"
+
+using namespace std;
+
+#define DECODE_YOLO  0 // [anchors, 4 + obj + classes]: tx, ty, tw, th, (obj), class logits
+#define DECODE_SSD   1 // loc [priors, 4]: dx, dy, dw, dh; conf [priors, classes]
+#define DECODE_BOXES 2 // [N, 6]: xmin, ymin, xmax, ymax, score, class (already decoded)
+
+#define YOLO_EXP_WH     0 // YOLOv3/v4: xy = sigmoid + cell, wh = anchor * exp(t)
+#define YOLO_SIGMOID_WH 1 // YOLOv5/v7: xy = 2 sigmoid - 0.5 + cell, wh = anchor * (2 sigmoid(t))^2
+
+#define SSD_SOFTMAX 0 // class logits, softmax over classes (class 0 is background)
+#define SSD_SIGMOID 1 // independent class logits
+#define SSD_PROBS   2 // already probabilities
+
+// One output scale of a YOLO head: grid of (input size / stride) cells, anchor sizes in pixels
+struct YoloLevel {
+    int stride;
+    vector<glm::vec2> anchors;
+};
+
+struct DecoderStats {
+    double decodeMs;   // last decode()
+    size_t anchors;    // rows examined, last decode()
+    size_t candidates; // rows past the first (logit) test, last decode()
+    size_t detections; // records appended, last decode()
+};
+
+class TensorDecoder {
+public:
+    TensorDecoder(void);
+
+    // Class names, indexed by class ID; colors come from the palette unless set with setColor.
+    // Unknown class IDs get "class <id>".
+    void setLabels(const vector<string>& labels);
+    void setColor(int classId, glm::vec3 color);
+    // Network input size in pixels: YOLO boxes and pixel [N, 6] boxes are divided by it
+    inline void setInputSize(int width, int height) { mInputWidth = width; mInputHeight = height; }
+    inline void setScoreThreshold(float score) { mScoreThreshold = score; }
+
+    // Returns false (and prints why) for an unusable configuration. Rows are ordered by level,
+    // anchor, grid row, grid column. channelsFirst: the tensor is [4 + obj + classes, anchors].
+    bool setYolo(const vector<YoloLevel>& levels, int classes, bool objectness=true,
+                 int whMode=YOLO_SIGMOID_WH, bool channelsFirst=false);
+    // priors: [count, 4] as cx, cy, w, h in [0..1]
+    bool setSSD(const float* priors, int count, int classes, int activation=SSD_SOFTMAX,
+                glm::vec2 variance=glm::vec2(0.1f, 0.2f));
+    // normalized: coordinates already in [0..1]; otherwise pixels of the input size
+    bool setBoxes(bool normalized);
+
+    // Appends the detections of one output tensor (YOLO: the tensor; [N, 6]: 'rows' boxes) to
+    // 'out', stamped with 'timestamp'. Returns the number appended.
+    size_t decode(const float* tensor, vector<Detection>& out, int rows=0, double timestamp=0.0);
+    // SSD: box offsets and class scores
+    size_t decode(const float* loc, const float* conf, vector<Detection>& out, double timestamp=0.0);
+
+    inline int anchors(void) const { return mAnchors; }
+    inline const DecoderStats& stats(void) const { return mStats; }
+    const string& label(int classId);
+    glm::vec3 color(int classId);
+
+private:
+    int   mLayout;
+    int   mClasses;
+    float mScoreThreshold;
+    int   mInputWidth;
+    int   mInputHeight;
+    DecoderStats mStats;
+
+    // Interned labels and colors, by class ID
+    vector<string>    mLabels;
+    vector<glm::vec3> mColors;
+
+    // YOLO: per anchor row, grid cell, stride and anchor size
+    bool  mObjectness;
+    int   mWHMode;
+    bool  mChannelsFirst;
+    int   mAnchors;
+    vector<float> mGridX, mGridY, mStride, mAnchorW, mAnchorH;
+
+    // SSD
+    int   mActivation;
+    glm::vec2 mVariance;
+    vector<float> mPriors;
+
+    // [N, 6]
+    bool  mNormalized;
+
+    // Scratch for the surviving rows, as arrays for the bulk sigmoid/exp
+    vector<int>   mRows;
+    vector<int>   mClassOf;
+    vector<float> mA, mB, mC, mD, mScore, mClassLogit;
+
+    void findYoloCandidates(const float* tensor, float logitThreshold);
+    void emit(vector<Detection>& out, int cls, float score, float xmin, float ymin,
+              float xmax, float ymax, double timestamp);
+};
+
+// Bulk activations (SIMD where available); in and out may be the same array
+void expArray(const float* in, float* out, size_t n);
+void sigmoidArray(const float* in, float* out, size_t n);
+
+#endif /* __TENSOR_DECODER_HPP_ */
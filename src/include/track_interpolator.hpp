@@ -0,0 +1,74 @@
+/*
+ * track_interpolator.hpp
+ *
+ *      Author: maheriya
+ * Description: Moves tracked boxes between detector results so overlays stay smooth at display
+ *              rate. Each track keeps its last few observations; a box is interpolated between
+ *              the two that bracket the display time, or extrapolated (for a bounded time) from
+ *              the last two.
+ */
+
+#ifndef __TRACK_INTERPOLATOR_HPP_
+#define __TRACK_INTERPOLATOR_HPP_
+#include <map>
+#include <utility>
+#include <vector>
+#include "detection.hpp"
+
+using namespace std;
+
+#define TRACK_HISTORY 8 // observations kept per track
+
+class TrackInterpolator {
+public:
+    TrackInterpolator(void);
+
+    // delay: boxes are shown as they were this long before the display time, so that there is
+    //        usually a newer observation to interpolate towards (one detector interval is enough)
+    // maxExtrapolation: how far past the newest observation a box keeps moving
+    // timeout: tracks without observations for this long are dropped
+    void setTiming(double delay, double maxExtrapolation, double timeout);
+
+    // Records an observation of det.track (> 0) at det.timestamp. Track IDs are per stream (the
+    // mosaic's tiles number their tracks independently). Out of order observations are ignored.
+    void observe(const Detection& det, int stream=0);
+    // Appends the box of every live track at display time t to 'out'
+    void resolve(double t, vector<Detection>& out);
+    void clear(void);
+    inline size_t tracks(void) const { return mTracks.size(); }
+
+private:
+    struct Track {
+        Detection obs[TRACK_HISTORY]; // ring, oldest at 'head'
+        int head;
+        int count;
+        inline const Detection& at(int i) const { return obs[(head + i) % TRACK_HISTORY]; }
+    };
+
+    map<pair<int, int>, Track> mTracks; // by (stream, track ID)
+    double mDelay;
+    double mMaxExtrapolation;
+    double mTimeout;
+};
+
+// Interpolation error on a recorded sequence (see evaluateInterpolation)
+struct InterpolationError {
+    size_t samples;       // (frame, track) pairs compared
+    size_t missed;        // ground truth boxes without an interpolated box
+    double meanIoU;       // interpolated box vs ground truth of the frame it is drawn over
+    double meanCenter;    // center distance, in frame widths/heights
+    double maxCenter;
+    double holdMeanIoU;   // same, showing the last detector result as it is (no interpolation)
+    double holdMeanCenter;
+    double alignedMeanIoU; // interpolated box vs ground truth at the time it stands for (the delay's lag left out)
+    double alignedMeanCenter;
+};
+
+// Replays a recorded sequence of tracked ground truth boxes (every display frame, sorted by
+// timestamp) as if the detector only ran on every 'stride'-th frame, and compares the boxes
+// interpolated at each frame, and the last results held as they are, with the ground truth of that
+// frame. The error includes the lag the delay adds; the aligned figures leave it out.
+InterpolationError evaluateInterpolation(const vector<Detection>& sequence, int stride,
+                                         double delay, double maxExtrapolation);
+
+#endif /* __TRACK_INTERPOLATOR_HPP_ */